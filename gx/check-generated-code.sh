@@ -0,0 +1,53 @@
+#!/bin/sh
+#
+# Checks that gx-gen produced the functions each of its features should
+# generate, so that a broken generator fails "make check" with a clear
+# message instead of only showing up as odd build failures later.
+#
+# NB: This is run from the build directory, which is where the generated
+# code is written.
+
+GEN_DIR=generated-code
+
+if ! test -f $GEN_DIR/gx-connection-xproto-gen.h; then
+  echo "$GEN_DIR/gx-connection-xproto-gen.h is missing; did gx-gen run?"
+  exit 1
+fi
+
+status=0
+
+# Each of these is an example of a function generated by a different
+# part of gx-gen:
+#  - sync, async, light and discard request functions
+#  - list getters, peek accessors, XID iterators and iterators for lists
+#    of variable sized items
+for symbol in \
+  gx_connection_get_input_focus \
+  gx_connection_get_input_focus_async \
+  gx_connection_get_input_focus_async_light \
+  gx_connection_get_input_focus_reply_light \
+  gx_connection_intern_atom_discard \
+  gx_window_query_tree_peek_children \
+  gx_window_query_tree_children_iter_init \
+  gx_connection_get_modifier_mapping_peek_keycodes \
+  gx_connection_list_extensions_names_iterator
+do
+  if ! grep -q "$symbol *(" $GEN_DIR/*-gen.h; then
+    echo "gx-gen didn't generate $symbol ()"
+    status=1
+  fi
+  if ! grep -q "^$symbol *(" $GEN_DIR/*-gen.c; then
+    echo "gx-gen didn't generate an implementation of $symbol ()"
+    status=1
+  fi
+done
+
+# The InternAtom and GetAtomName sync and *_reply () functions should
+# fill the connection's atom cache
+n_hooks=`grep -c "_gx_connection_cache_atom (" $GEN_DIR/gx-connection-xproto-gen.c`
+if test "$n_hooks" != 4; then
+  echo "gx-gen generated $n_hooks atom cache hooks instead of 4"
+  status=1
+fi
+
+exit $status
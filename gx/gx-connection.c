@@ -31,12 +31,15 @@
 #include <gx/gx-mask-value-item.h>
 #include <gx/gx-protocol-error.h>
 #include <gx/gx-event.h>
+#include <gx/gx-debug.h>
 
 #include <glib.h>
+#include <gio/gio.h>
 
 #include <xcb/xcbext.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 #define GX_CONNECTION_GET_PRIVATE(object) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((object), \
@@ -47,12 +50,23 @@ enum {
     EVENT_SIGNAL,
     REPLY_SIGNAL,
     ERROR_SIGNAL,
+    STATS_SIGNAL,
+    PROTOCOL_ERROR_SIGNAL,
     LAST_SIGNAL
 };
 
 enum {
     PROP_0,
     PROP_DISPLAY,
+    PROP_XCB_CONNECTION,
+    PROP_DISPATCH_BATCH_SIZE,
+    PROP_DISPATCH_TIME_BUDGET,
+    PROP_AUTO_FLUSH_REQUESTS,
+    PROP_AUTO_FLUSH_BYTES,
+    PROP_FLUSH_ON_IDLE,
+    PROP_STATS_INTERVAL,
+    PROP_MAX_UNCLAIMED_REPLIES,
+    PROP_UNCLAIMED_REPLY_TTL
 };
 
 typedef struct
@@ -82,12 +96,77 @@ typedef struct _XCBResponseData
   void		  *data;
 } XCBResponseData;
 
+/* Cookies that are still waiting for a reply are kept in a ring buffer that
+ * is directly indexed by the (wrapping) 32bit request sequence number.
+ *
+ * XCB hands out sequence numbers in increasing order and the server
+ * responds to requests in that same order, so when polling for replies we
+ * only ever need to look at the oldest outstanding sequence numbers, and
+ * registering/unregistering a cookie doesn't need to search anything.
+ *
+ * NB: all the sequence arithmetic is done with unsigned ints so it
+ * naturally handles the sequence number wrapping.
+ */
+typedef struct _GXCookieTable
+{
+  GXCookie    **slots;
+  unsigned int  size;	   /* always a power of two */
+  unsigned int  head;	   /* sequence of the oldest slot */
+  unsigned int  tail;	   /* one past the newest registered sequence */
+  unsigned int  n_cookies;
+} GXCookieTable;
+
+#define GX_COOKIE_TABLE_INITIAL_SIZE 64
+
+/* GXLightCookies are allocated in blocks of this many */
+#define GX_LIGHT_COOKIE_SLAB_SIZE 64
+
+/* Objects wrapping an XID (windows and pixmaps) are registered with their
+ * connection so events and replies can be mapped back to them.
+ *
+ * The XIDs we allocate ourselves via xcb_generate_id are always of the
+ * form resource_id_base | (n * inc), where inc is the lowest set bit of
+ * resource_id_mask, and n simply counts up from zero. We can therefore
+ * index those directly with n, using a two level table so that only the
+ * ranges actually in use need to be allocated. Anything else (e.g. root
+ * windows or windows belonging to other clients) goes in a hash table.
+ */
+#define GX_XID_PAGE_SHIFT 8
+#define GX_XID_PAGE_SIZE  (1 << GX_XID_PAGE_SHIFT)
+
+typedef struct _GXXIDPage
+{
+  GObject      *objects[GX_XID_PAGE_SIZE];
+  unsigned int  n_objects;
+} GXXIDPage;
+
+typedef struct _GXXIDRegistry
+{
+  guint32	base;
+  guint32	mask;
+  unsigned int	inc_shift;
+
+  GPtrArray    *pages;
+  GHashTable   *foreign;
+} GXXIDRegistry;
+
 struct _GXConnectionPrivate
 {
   xcb_connection_t  *xcb_connection;
 
   /** Indicates that connecting to the X server failed. */
   gboolean	 has_error;
+  /** The XCB_CONN_* code reported by xcb_connection_has_error () */
+  int		 connection_error;
+
+  /* The screen number given in the display name */
+  int		 preferred_screen_num;
+
+  /* The time (in seconds) spent blocked in xcb_connect () and the time
+   * spent setting up the connection afterwards, which includes creating
+   * the screen objects when they are first needed. */
+  gdouble	 connect_time;
+  gdouble	 setup_time;
 
   gchar		*display;
   GXScreen	*screen;
@@ -98,27 +177,105 @@ struct _GXConnectionPrivate
   /* While cookies are registered with a connection they are in
    * one of the the two following lists. */
 
-  /** The list of cookies for which no reply/error has yet been
-   * recieved
-   */
-  GQueue	*pending_reply_cookies;
+  /** The cookies for which no reply/error has yet been recieved,
+   * indexed by sequence number */
+  GXCookieTable	 pending_reply_cookies;
 
   /** The list of cookies for which a reply has been recieved
-   * but they are still registered and owned by the connection */
+   * but they are still registered and owned by the connection, in the
+   * order the replies arrived. Each cookie's link is kept in its
+   * GXCookieRegistration so it can be removed without searching. */
   GQueue	*zombie_reply_cookies;
 
+  /* Limits on the number of zombie cookies and on how long (in
+   * milliseconds) they may wait to be claimed before the oldest are
+   * reaped (0 means no limit). The TTL is checked by a timeout every
+   * unclaimed_reply_ttl milliseconds. (See reap_zombie_cookies ()) */
+  guint		 max_unclaimed_replies;
+  guint		 unclaimed_reply_ttl;
+  guint		 reaper_id;
+
   /* Events, replies and errors are queued up when retrieving them
    * from XCB so they may be dispatched one at a time from a custom
-   * GSource to ensure the mainloop remains interactive. */
+   * GSource to ensure the mainloop remains interactive. Errors for
+   * unchecked requests arrive from XCB as events and are queued with
+   * them. */
   GQueue	*events_queue;
   GQueue	*response_queue;
+
+  /* The maximum number of queued events, replies and errors delivered by
+   * a single dispatch of our GSource, and an optional time limit (in
+   * microseconds) after which a dispatch yields back to the mainloop
+   * even if the batch isn't complete. */
+  guint		 dispatch_batch_size;
+  guint		 dispatch_time_budget;
+
+  /* The number of requests, and an estimate of the number of bytes,
+   * queued with XCB since we last flushed. While batch_depth > 0
+   * requests are only flushed by gx_connection_end_batch (), otherwise
+   * we flush once either auto-flush threshold is reached (0 means no
+   * limit). With flush_on_idle set, any queued requests are also
+   * flushed before the mainloop blocks. */
+  guint		 batch_depth;
+  guint		 queued_requests;
+  gsize		 queued_bytes;
+  guint		 auto_flush_requests;
+  guint		 auto_flush_bytes;
+  gboolean	 flush_on_idle;
+
+  /* The maximum request length (in 4 byte units) once it's been
+   * retrieved from XCB, which takes BIG-REQUESTS into account */
+  guint32	 maximum_request_length;
+
+  /* The details of each event we may receive, indexed by event code,
+   * including those of any extensions. (See gx-event.c) */
+  GXEventDetails *event_details[GX_N_EVENT_CODES];
+  guint		 event_details_serial;
+
+  /* Counters, queue high-water marks and the request latency histogram
+   * (See gx_connection_get_stats ()) The current queue lengths are
+   * only filled in when a snapshot is taken. If stats_interval is set,
+   * a "stats" signal is emitted with a snapshot every stats_interval
+   * milliseconds. */
+  GXConnectionStats stats;
+  guint		 stats_interval;
+  guint		 stats_timeout_id;
+
+  /* Event handlers added with gx_connection_add_event_handler (), which
+   * are called directly instead of via the "event" signal */
+  GHookList	*event_hooks;
+
+  /* The GXWindow and GXPixmap objects created for this connection,
+   * indexed by XID */
+  GXXIDRegistry	 xid_registry;
+
+  /* The blocks of memory GXLightCookies are allocated from, and the
+   * list of light cookies available for reuse. */
+  GSList	*light_cookie_slabs;
+  GXLightCookie	*free_light_cookies;
+
+  /* Atoms never change for the lifetime of the server, so we cache them
+   * in both directions. The names are owned by atom_names.
+   *
+   * NB: The cache is only used by the gx_connection_lookup_atom* ()
+   * functions, but it is also filled by the replies to the generated
+   * InternAtom and GetAtomName functions.
+   * (See _gx_connection_cache_atom ()) */
+  GHashTable	*atoms;
+  GHashTable	*atom_names;
 #if 0
   GQueue	*replies_queue;
   GQueue	*errors_queue;
 #endif
 
-  GList		      *screens;
-  GXScreen	      *default_screen;
+  /* Pointers into the xcb_setup_t for each screen, and the
+   * corresponding screen objects which are only created when first
+   * requested. (See get_screen ()) */
+  const xcb_screen_t **xcb_screens;
+  GXScreen	     **screens;
+  guint		       n_screens;
+  /* A list of all the screens, created by gx_connection_get_screens () */
+  GList		      *screens_list;
 };
 
 
@@ -134,28 +291,288 @@ static void gx_connection_set_property (GObject *object,
 static void gx_connection_mydoable_interface_init (gpointer interface,
 						   gpointer data);
 */
-static void connect_to_display (GXConnection *self, const char *display);
+static void gx_connection_constructed (GObject *object);
+static xcb_connection_t *connect_to_display (const char *display,
+					     int *preferred_screen_num,
+					     gdouble *connect_time);
+static void setup_connection (GXConnection *self);
 void gx_connection_dispose (GObject *object);
 static void gx_connection_finalize (GObject *self);
 static void disconnect_from_display (GXConnection *self);
+static void set_stats_interval (GXConnection *self, guint interval);
+static void set_unclaimed_reply_ttl (GXConnection *self, guint ttl);
+static void reap_zombie_cookies (GXConnection *self);
+static void free_unclaimed_light_cookies (GXConnection *self);
 
 static guint gx_connection_signals[LAST_SIGNAL] = { 0 };
 
-
-static GQuark cookie_pending_quark;
-
 /* NB: This declares gx_connection_parent_class */
 G_DEFINE_TYPE (GXConnection, gx_connection, G_TYPE_OBJECT);
 
 
+static void
+cookie_table_init (GXCookieTable *table)
+{
+  table->size = GX_COOKIE_TABLE_INITIAL_SIZE;
+  table->slots = g_new0 (GXCookie *, table->size);
+  table->head = 0;
+  table->tail = 0;
+  table->n_cookies = 0;
+}
+
+static void
+cookie_table_destroy (GXCookieTable *table)
+{
+  g_free (table->slots);
+  table->slots = NULL;
+}
+
+/* Grows the table until a span of sequence numbers starting at
+ * new_head and ending at new_tail can be represented. */
+static void
+cookie_table_resize (GXCookieTable *table,
+		     unsigned int new_head,
+		     unsigned int new_tail)
+{
+  unsigned int span = new_tail - new_head;
+  unsigned int new_size = table->size;
+  GXCookie **new_slots;
+  unsigned int sequence;
+
+  if (span < table->size)
+    return;
+
+  while (new_size <= span)
+    new_size *= 2;
+
+  new_slots = g_new0 (GXCookie *, new_size);
+  for (sequence = table->head; sequence != table->tail; sequence++)
+    new_slots[sequence & (new_size - 1)] =
+      table->slots[sequence & (table->size - 1)];
+
+  g_free (table->slots);
+  table->slots = new_slots;
+  table->size = new_size;
+}
+
+static void
+cookie_table_insert (GXCookieTable *table, GXCookie *cookie)
+{
+  unsigned int sequence = gx_cookie_get_sequence (cookie);
+
+  if (table->n_cookies == 0)
+    {
+      table->head = sequence;
+      table->tail = sequence + 1;
+    }
+  else if ((int)(sequence - table->head) < 0)
+    {
+      /* Normally cookies are registered in sequence order but we don't
+       * rely on that. */
+      cookie_table_resize (table, sequence, table->tail);
+      table->head = sequence;
+    }
+  else if (sequence - table->head >= table->tail - table->head)
+    {
+      cookie_table_resize (table, table->head, sequence + 1);
+      table->tail = sequence + 1;
+    }
+
+  table->slots[sequence & (table->size - 1)] = cookie;
+  table->n_cookies++;
+}
+
+static GXCookie *
+cookie_table_lookup (GXCookieTable *table, unsigned int sequence)
+{
+  if (table->n_cookies == 0
+      || sequence - table->head >= table->tail - table->head)
+    return NULL;
+
+  return table->slots[sequence & (table->size - 1)];
+}
+
+/* Returns the cookie with the oldest sequence number, or NULL if the
+ * table is empty. */
+static GXCookie *
+cookie_table_peek_oldest (GXCookieTable *table)
+{
+  GXCookie *cookie;
+
+  if (table->n_cookies == 0)
+    return NULL;
+
+  /* Since the head is only advanced lazily we may have to skip over
+   * some unregistered slots, but each slot is only skipped once. */
+  while (!(cookie = table->slots[table->head & (table->size - 1)]))
+    table->head++;
+
+  return cookie;
+}
+
+static gboolean
+cookie_table_remove (GXCookieTable *table, GXCookie *cookie)
+{
+  unsigned int sequence = gx_cookie_get_sequence (cookie);
+
+  if (cookie_table_lookup (table, sequence) != cookie)
+    return FALSE;
+
+  table->slots[sequence & (table->size - 1)] = NULL;
+  table->n_cookies--;
+
+  if (table->n_cookies == 0)
+    table->head = table->tail;
+  else if (sequence == table->head)
+    cookie_table_peek_oldest (table);
+
+  return TRUE;
+}
+
+static void
+xid_registry_init (GXXIDRegistry *registry)
+{
+  /* NB: Until we know the resource ID range for the connection
+   * everything is treated as foreign. */
+  registry->base = 0;
+  registry->mask = 0;
+  registry->inc_shift = 0;
+  registry->pages = g_ptr_array_new ();
+  registry->foreign = g_hash_table_new (g_direct_hash, g_direct_equal);
+}
+
+static void
+xid_registry_set_range (GXXIDRegistry *registry,
+			guint32 base,
+			guint32 mask)
+{
+  registry->base = base;
+  registry->mask = mask;
+  registry->inc_shift = 0;
+  if (mask)
+    while (!(mask & (1 << registry->inc_shift)))
+      registry->inc_shift++;
+}
+
+static void
+xid_registry_destroy (GXXIDRegistry *registry)
+{
+  int i;
+
+  for (i = 0; i < registry->pages->len; i++)
+    {
+      GXXIDPage *page = g_ptr_array_index (registry->pages, i);
+      if (page)
+	g_slice_free (GXXIDPage, page);
+    }
+  g_ptr_array_free (registry->pages, TRUE);
+  registry->pages = NULL;
+
+  g_hash_table_unref (registry->foreign);
+  registry->foreign = NULL;
+}
+
+static gboolean
+xid_registry_is_own_xid (GXXIDRegistry *registry, guint32 xid)
+{
+  return registry->mask && (xid & ~registry->mask) == registry->base;
+}
+
+static void
+xid_registry_insert (GXXIDRegistry *registry, guint32 xid, GObject *object)
+{
+  unsigned int index;
+  unsigned int page_index;
+  GXXIDPage *page;
+
+  if (!xid_registry_is_own_xid (registry, xid))
+    {
+      g_hash_table_insert (registry->foreign, GUINT_TO_POINTER (xid), object);
+      return;
+    }
+
+  index = (xid & registry->mask) >> registry->inc_shift;
+  page_index = index >> GX_XID_PAGE_SHIFT;
+
+  if (page_index >= registry->pages->len)
+    g_ptr_array_set_size (registry->pages, page_index + 1);
+
+  page = g_ptr_array_index (registry->pages, page_index);
+  if (!page)
+    {
+      page = g_slice_new0 (GXXIDPage);
+      registry->pages->pdata[page_index] = page;
+    }
+
+  if (!page->objects[index & (GX_XID_PAGE_SIZE - 1)])
+    page->n_objects++;
+  page->objects[index & (GX_XID_PAGE_SIZE - 1)] = object;
+}
+
+static GObject *
+xid_registry_lookup (GXXIDRegistry *registry, guint32 xid)
+{
+  unsigned int index;
+  unsigned int page_index;
+  GXXIDPage *page;
+
+  if (!xid_registry_is_own_xid (registry, xid))
+    return g_hash_table_lookup (registry->foreign, GUINT_TO_POINTER (xid));
+
+  index = (xid & registry->mask) >> registry->inc_shift;
+  page_index = index >> GX_XID_PAGE_SHIFT;
+
+  if (page_index >= registry->pages->len)
+    return NULL;
+
+  page = g_ptr_array_index (registry->pages, page_index);
+  if (!page)
+    return NULL;
+
+  return page->objects[index & (GX_XID_PAGE_SIZE - 1)];
+}
+
+/* Only removes the entry if it still refers to the given object */
+static void
+xid_registry_remove (GXXIDRegistry *registry, guint32 xid, GObject *object)
+{
+  unsigned int index;
+  unsigned int page_index;
+  GXXIDPage *page;
+
+  if (xid_registry_lookup (registry, xid) != object)
+    return;
+
+  if (!xid_registry_is_own_xid (registry, xid))
+    {
+      g_hash_table_remove (registry->foreign, GUINT_TO_POINTER (xid));
+      return;
+    }
+
+  index = (xid & registry->mask) >> registry->inc_shift;
+  page_index = index >> GX_XID_PAGE_SHIFT;
+  page = g_ptr_array_index (registry->pages, page_index);
+
+  page->objects[index & (GX_XID_PAGE_SIZE - 1)] = NULL;
+
+  /* XCB never hands out the same XID twice (until the range is
+   * exhausted), so long running clients would otherwise accumulate
+   * empty pages. */
+  if (--page->n_objects == 0)
+    {
+      g_slice_free (GXXIDPage, page);
+      registry->pages->pdata[page_index] = NULL;
+    }
+}
+
+
 static void
 gx_connection_class_init (GXConnectionClass *klass)
 {
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GParamSpec *new_param;
 
-  cookie_pending_quark = g_quark_from_static_string ("pending");
-
+  gobject_class->constructed = gx_connection_constructed;
   gobject_class->finalize = gx_connection_finalize;
   gobject_class->dispose = gx_connection_dispose;
 
@@ -174,6 +591,135 @@ gx_connection_class_init (GXConnectionClass *klass)
 				   PROP_DISPLAY,
 				   new_param);
 
+  /* NB: The connection takes ownership of the given xcb_connection_t,
+   * which is how gx_connection_new_finish () hands over a connection
+   * established on a worker thread. */
+  new_param = g_param_spec_pointer ("xcb-connection", /* name */
+				    "XCB Connection", /* nick name */
+				    "An existing XCB connection to adopt "
+				    "instead of connecting to \"display\"",
+				    G_PARAM_READABLE
+				    | G_PARAM_WRITABLE
+				    | G_PARAM_CONSTRUCT_ONLY
+  );
+  g_object_class_install_property (gobject_class,
+				   PROP_XCB_CONNECTION,
+				   new_param);
+
+  new_param = g_param_spec_uint ("dispatch-batch-size", /* name */
+				 "Dispatch Batch Size", /* nick name */
+				 "The maximum number of events, replies and "
+				 "errors delivered per mainloop iteration",
+				 1, /* minimum */
+				 G_MAXUINT, /* maximum */
+				 1, /* default */
+				 G_PARAM_READABLE
+				 | G_PARAM_WRITABLE
+  );
+  g_object_class_install_property (gobject_class,
+				   PROP_DISPATCH_BATCH_SIZE,
+				   new_param);
+
+  new_param = g_param_spec_uint ("dispatch-time-budget", /* name */
+				 "Dispatch Time Budget", /* nick name */
+				 "The maximum time in microseconds spent "
+				 "delivering a batch before yielding to the "
+				 "mainloop (0 means no limit)",
+				 0, /* minimum */
+				 G_MAXUINT, /* maximum */
+				 0, /* default */
+				 G_PARAM_READABLE
+				 | G_PARAM_WRITABLE
+  );
+  g_object_class_install_property (gobject_class,
+				   PROP_DISPATCH_TIME_BUDGET,
+				   new_param);
+
+  new_param = g_param_spec_uint ("auto-flush-requests", /* name */
+				 "Auto Flush Requests", /* nick name */
+				 "Flush once this many requests have been "
+				 "queued outside of a batch (0 means no limit)",
+				 0, /* minimum */
+				 G_MAXUINT, /* maximum */
+				 0, /* default */
+				 G_PARAM_READABLE
+				 | G_PARAM_WRITABLE
+  );
+  g_object_class_install_property (gobject_class,
+				   PROP_AUTO_FLUSH_REQUESTS,
+				   new_param);
+
+  new_param = g_param_spec_uint ("auto-flush-bytes", /* name */
+				 "Auto Flush Bytes", /* nick name */
+				 "Flush once roughly this many bytes of "
+				 "requests have been queued outside of a "
+				 "batch (0 means no limit)",
+				 0, /* minimum */
+				 G_MAXUINT, /* maximum */
+				 0, /* default */
+				 G_PARAM_READABLE
+				 | G_PARAM_WRITABLE
+  );
+  g_object_class_install_property (gobject_class,
+				   PROP_AUTO_FLUSH_BYTES,
+				   new_param);
+
+  new_param = g_param_spec_boolean ("flush-on-idle", /* name */
+				    "Flush On Idle", /* nick name */
+				    "Flush queued requests before the "
+				    "mainloop goes idle",
+				    FALSE, /* default */
+				    G_PARAM_READABLE
+				    | G_PARAM_WRITABLE
+  );
+  g_object_class_install_property (gobject_class,
+				   PROP_FLUSH_ON_IDLE,
+				   new_param);
+
+  new_param = g_param_spec_uint ("stats-interval", /* name */
+				 "Stats Interval", /* nick name */
+				 "How often (in milliseconds) to emit the "
+				 "\"stats\" signal (0 means never)",
+				 0, /* minimum */
+				 G_MAXUINT, /* maximum */
+				 0, /* default */
+				 G_PARAM_READABLE
+				 | G_PARAM_WRITABLE
+  );
+  g_object_class_install_property (gobject_class,
+				   PROP_STATS_INTERVAL,
+				   new_param);
+
+  new_param = g_param_spec_uint ("max-unclaimed-replies", /* name */
+				 "Max Unclaimed Replies", /* nick name */
+				 "The maximum number of received replies "
+				 "kept waiting to be claimed before the "
+				 "oldest are freed (0 means no limit)",
+				 0, /* minimum */
+				 G_MAXUINT, /* maximum */
+				 0, /* default */
+				 G_PARAM_READABLE
+				 | G_PARAM_WRITABLE
+  );
+  g_object_class_install_property (gobject_class,
+				   PROP_MAX_UNCLAIMED_REPLIES,
+				   new_param);
+
+  new_param = g_param_spec_uint ("unclaimed-reply-ttl", /* name */
+				 "Unclaimed Reply TTL", /* nick name */
+				 "How long (in milliseconds) received "
+				 "replies are kept waiting to be claimed "
+				 "before being freed (0 means forever)",
+				 0, /* minimum */
+				 G_MAXUINT, /* maximum */
+				 0, /* default */
+				 G_PARAM_READABLE
+				 | G_PARAM_WRITABLE
+  );
+  g_object_class_install_property (gobject_class,
+				   PROP_UNCLAIMED_REPLY_TTL,
+				   new_param);
+
   klass->event = NULL;
   gx_connection_signals[EVENT_SIGNAL] =
     g_signal_new ("event", /* name */
@@ -187,6 +733,40 @@ gx_connection_class_init (GXConnectionClass *klass)
 		  1, /* number of parameters */
 		  G_TYPE_POINTER /* vararg, list of param types */
     );
+
+  /* NB: The GXConnectionStats snapshot passed to handlers is only
+   * valid for the duration of the emission */
+  gx_connection_signals[STATS_SIGNAL] =
+    g_signal_new ("stats", /* name */
+		  G_TYPE_FROM_CLASS (klass), /* interface GType */
+		  G_SIGNAL_RUN_LAST, /* signal flags */
+		  0, /* class offset */
+		  NULL, /* accumulator */
+		  NULL,	/* accumulator data */
+		  g_cclosure_marshal_VOID__POINTER, /* c marshaller */
+		  G_TYPE_NONE,	/* return type */
+		  1, /* number of parameters */
+		  G_TYPE_POINTER /* vararg, list of param types */
+    );
+
+  /* Emitted for errors caused by requests that weren't checked, and so
+   * have no cookie to report the error to. The GXGenericProtocolError
+   * passed to handlers is only valid for the duration of the emission.
+   * If nothing is connected the error is dropped, though it is still
+   * counted in the connection's stats and can be traced with
+   * GX_DEBUG=errors. */
+  gx_connection_signals[PROTOCOL_ERROR_SIGNAL] =
+    g_signal_new ("protocol-error", /* name */
+		  G_TYPE_FROM_CLASS (klass), /* interface GType */
+		  G_SIGNAL_RUN_LAST, /* signal flags */
+		  0, /* class offset */
+		  NULL, /* accumulator */
+		  NULL,	/* accumulator data */
+		  g_cclosure_marshal_VOID__POINTER, /* c marshaller */
+		  G_TYPE_NONE,	/* return type */
+		  1, /* number of parameters */
+		  G_TYPE_POINTER /* vararg, list of param types */
+    );
 #if 0
   klass->reply = NULL;
   gx_connection_signals[REPLY_SIGNAL] =
@@ -225,7 +805,7 @@ gx_connection_get_property (GObject *object,
 			    GValue *value,
 			    GParamSpec *pspec)
 {
-  /* GXConnection* self = GX_CONNECTION (object); */
+  GXConnection* self = GX_CONNECTION (object);
 
   switch (id) {
 #if 0 /* template code */
@@ -233,6 +813,36 @@ gx_connection_get_property (GObject *object,
       g_value_set_int(value, self->priv->property);
       break;
 #endif
+    case PROP_DISPLAY:
+      g_value_set_string (value, self->priv->display);
+      break;
+    case PROP_XCB_CONNECTION:
+      g_value_set_pointer (value, self->priv->xcb_connection);
+      break;
+    case PROP_DISPATCH_BATCH_SIZE:
+      g_value_set_uint (value, self->priv->dispatch_batch_size);
+      break;
+    case PROP_DISPATCH_TIME_BUDGET:
+      g_value_set_uint (value, self->priv->dispatch_time_budget);
+      break;
+    case PROP_AUTO_FLUSH_REQUESTS:
+      g_value_set_uint (value, self->priv->auto_flush_requests);
+      break;
+    case PROP_AUTO_FLUSH_BYTES:
+      g_value_set_uint (value, self->priv->auto_flush_bytes);
+      break;
+    case PROP_FLUSH_ON_IDLE:
+      g_value_set_boolean (value, self->priv->flush_on_idle);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint (value, self->priv->stats_interval);
+      break;
+    case PROP_MAX_UNCLAIMED_REPLIES:
+      g_value_set_uint (value, self->priv->max_unclaimed_replies);
+      break;
+    case PROP_UNCLAIMED_REPLY_TTL:
+      g_value_set_uint (value, self->priv->unclaimed_reply_ttl);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, id, pspec);
       break;
@@ -256,7 +866,34 @@ gx_connection_set_property (GObject *object,
 #endif
     case PROP_DISPLAY:
       self->priv->display = g_value_dup_string (value);
-      connect_to_display (self, self->priv->display);
+      break;
+    case PROP_XCB_CONNECTION:
+      self->priv->xcb_connection = g_value_get_pointer (value);
+      break;
+    case PROP_DISPATCH_BATCH_SIZE:
+      self->priv->dispatch_batch_size = g_value_get_uint (value);
+      break;
+    case PROP_DISPATCH_TIME_BUDGET:
+      self->priv->dispatch_time_budget = g_value_get_uint (value);
+      break;
+    case PROP_AUTO_FLUSH_REQUESTS:
+      self->priv->auto_flush_requests = g_value_get_uint (value);
+      break;
+    case PROP_AUTO_FLUSH_BYTES:
+      self->priv->auto_flush_bytes = g_value_get_uint (value);
+      break;
+    case PROP_FLUSH_ON_IDLE:
+      self->priv->flush_on_idle = g_value_get_boolean (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      set_stats_interval (self, g_value_get_uint (value));
+      break;
+    case PROP_MAX_UNCLAIMED_REPLIES:
+      self->priv->max_unclaimed_replies = g_value_get_uint (value);
+      reap_zombie_cookies (self);
+      break;
+    case PROP_UNCLAIMED_REPLY_TTL:
+      set_unclaimed_reply_ttl (self, g_value_get_uint (value));
       break;
 
     default:
@@ -272,12 +909,51 @@ gx_connection_init (GXConnection *self)
 
   self->priv->events_queue = g_queue_new ();
   self->priv->response_queue = g_queue_new ();
-  self->priv->pending_reply_cookies = g_queue_new ();
+  cookie_table_init (&self->priv->pending_reply_cookies);
+  xid_registry_init (&self->priv->xid_registry);
+
+  self->priv->dispatch_batch_size = 1;
+  self->priv->dispatch_time_budget = 0;
   self->priv->zombie_reply_cookies = g_queue_new ();
 
+  self->priv->atoms = g_hash_table_new (g_str_hash, g_str_equal);
+  self->priv->atom_names = g_hash_table_new_full (g_direct_hash,
+						  g_direct_equal,
+						  NULL,
+						  g_free);
+
   //self->priv->event_info = g_hash_table_new (g_int_hash, g_int_equal);
 }
 
+/* NB: connecting is deferred until all the construct properties have
+ * been set so we know whether an "xcb-connection" was passed in. */
+static void
+gx_connection_constructed (GObject *object)
+{
+  GXConnection *self = GX_CONNECTION (object);
+
+  if (!self->priv->xcb_connection)
+    self->priv->xcb_connection =
+      connect_to_display (self->priv->display,
+			  &self->priv->preferred_screen_num,
+			  &self->priv->connect_time);
+  else
+    {
+      const char *display = self->priv->display;
+
+      if (!display)
+	display = getenv ("DISPLAY");
+      if (!display || !xcb_parse_display (display, NULL, NULL,
+					  &self->priv->preferred_screen_num))
+	self->priv->preferred_screen_num = 0;
+    }
+
+  setup_connection (self);
+
+  if (G_OBJECT_CLASS (gx_connection_parent_class)->constructed)
+    G_OBJECT_CLASS (gx_connection_parent_class)->constructed (object);
+}
+
 GXConnection *
 gx_connection_new (const char *display)
 {
@@ -288,87 +964,241 @@ gx_connection_new (const char *display)
   return self;
 }
 
-void
-gx_connection_finalize (GObject *object)
+typedef struct
 {
-  GXConnection *self = GX_CONNECTION (object);
-
-  if (self->priv->xcb_connection)
-    disconnect_from_display (self);
-
-  g_queue_free (self->priv->events_queue);
-  g_queue_free (self->priv->response_queue);
-  g_queue_free (self->priv->pending_reply_cookies);
-  g_queue_free (self->priv->zombie_reply_cookies);
-
-  G_OBJECT_CLASS (gx_connection_parent_class)->finalize (object);
-}
+  char		   *display;
+  xcb_connection_t *xcb_connection;
+  int		    preferred_screen_num;
+  gdouble	    connect_time;
+} GXConnectionNewData;
 
 static void
-cookie_pending_finalized_notify (gpointer data,
-				 GObject *old_cookie)
+connection_new_data_free (GXConnectionNewData *data)
 {
-  GXConnection *self = data;
-
-  g_queue_remove (self->priv->pending_reply_cookies, old_cookie);
+  /* If the result was never collected via gx_connection_new_finish ()
+   * we still own the connection. NB: see the comment in
+   * setup_connection () about connections that failed. */
+  if (data->xcb_connection
+      && !xcb_connection_has_error (data->xcb_connection))
+    xcb_disconnect (data->xcb_connection);
+  g_free (data->display);
+  g_slice_free (GXConnectionNewData, data);
 }
 
+/* NB: This is run in a worker thread and so mustn't touch any state
+ * that is shared with the main thread. */
 static void
-response_queue_remove_cookie_references (GXConnection *self,
-					 const GXCookie *cookie)
+connection_new_thread (GSimpleAsyncResult *result,
+		       GObject *object,
+		       GCancellable *cancellable)
 {
-  GList *tmp;
+  GXConnectionNewData *data = g_simple_async_result_get_op_res_gpointer (result);
+  GError *error = NULL;
 
-  for (tmp = self->priv->response_queue->head;
-       tmp != NULL;
-       tmp = tmp->next)
+  data->xcb_connection = connect_to_display (data->display,
+					     &data->preferred_screen_num,
+					     &data->connect_time);
+
+  /* xcb_connect () can't be interrupted, so we can only check whether
+   * we were cancelled once it has returned. */
+  if (g_cancellable_set_error_if_cancelled (cancellable, &error))
     {
-      XCBResponseData *response = tmp->data;
-      if (response->cookie == cookie)
-	{
-	  g_queue_delete_link (self->priv->response_queue, tmp);
-	  break;
-	}
+      g_simple_async_result_set_from_error (result, error);
+      g_error_free (error);
     }
 }
 
-static void
-cookie_zombie_finalized_notify (gpointer data,
-				GObject *old_cookie)
+/**
+ * gx_connection_new_async:
+ * @display: The name of the display to connect to, or %NULL to use
+ *	     the DISPLAY environment variable
+ * @cancellable: An optional #GCancellable
+ * @callback: A #GAsyncReadyCallback to call once connected
+ * @user_data: The data to pass to @callback
+ *
+ * Asynchronously connects to @display. The blocking part of establishing
+ * the connection (xcb_connect () and the connection setup handshake) is
+ * done in a worker thread, so this can be used to open connections to
+ * several displays in parallel without stalling the mainloop. When
+ * finished @callback will be called from the thread default main context
+ * and you should then call gx_connection_new_finish () to get the new
+ * connection.
+ */
+void
+gx_connection_new_async (const char *display,
+			 GCancellable *cancellable,
+			 GAsyncReadyCallback callback,
+			 gpointer user_data)
 {
-  GXConnection *self = data;
-
-  response_queue_remove_cookie_references (self, GX_COOKIE (old_cookie));
-
-  g_queue_remove (self->priv->zombie_reply_cookies, old_cookie);
+  GSimpleAsyncResult *result;
+  GXConnectionNewData *data;
+
+  data = g_slice_new0 (GXConnectionNewData);
+  data->display = g_strdup (display);
+
+  result = g_simple_async_result_new (NULL, callback, user_data,
+				      gx_connection_new_async);
+  g_simple_async_result_set_op_res_gpointer (result, data,
+					     (GDestroyNotify)
+					     connection_new_data_free);
+  g_simple_async_result_run_in_thread (result,
+				       connection_new_thread,
+				       G_PRIORITY_DEFAULT,
+				       cancellable);
+  g_object_unref (result);
 }
 
-void
-gx_connection_dispose (GObject *object)
-{
-  GXConnection *self = GX_CONNECTION (object);
-  GList *copy_list;
-  GList *tmp;
+/**
+ * gx_connection_new_finish:
+ * @result: The #GAsyncResult passed to your #GAsyncReadyCallback
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Finishes an operation started with gx_connection_new_async ().
+ *
+ * Returns: A new connection object or %NULL if connecting failed, in
+ * which case @error will be set. See the #GXConnectionError codes.
+ */
+GXConnection *
+gx_connection_new_finish (GAsyncResult *result, GError **error)
+{
+  GSimpleAsyncResult *simple = G_SIMPLE_ASYNC_RESULT (result);
+  GXConnectionNewData *data;
+  GXConnection *self;
+
+  g_return_val_if_fail (g_simple_async_result_get_source_tag (simple)
+			== gx_connection_new_async, NULL);
+
+  if (g_simple_async_result_propagate_error (simple, error))
+    return NULL;
+
+  data = g_simple_async_result_get_op_res_gpointer (simple);
+
+  self = GX_CONNECTION (g_object_new (gx_connection_get_type (),
+				      "display", data->display,
+				      "xcb-connection", data->xcb_connection,
+				      NULL));
+  data->xcb_connection = NULL;
+  self->priv->connect_time = data->connect_time;
+
+  if (!gx_connection_check_error (self, error))
+    {
+      g_object_unref (self);
+      return NULL;
+    }
+
+  return self;
+}
+
+void
+gx_connection_finalize (GObject *object)
+{
+  GXConnection *self = GX_CONNECTION (object);
+  XCBResponseData *response;
+
+  if (self->priv->xcb_connection)
+    disconnect_from_display (self);
+
+  g_free (self->priv->display);
+  g_free (self->priv->xcb_screens);
+  g_free (self->priv->screens);
+  g_hash_table_destroy (self->priv->atoms);
+  g_hash_table_destroy (self->priv->atom_names);
+
+  g_queue_free (self->priv->events_queue);
+
+  /* NB: All the cookies were unregistered in dispose, so any responses
+   * still queued are no longer wanted */
+  while ((response = g_queue_pop_head (self->priv->response_queue)))
+    {
+      free (response->data);
+      g_slice_free (XCBResponseData, response);
+    }
+  g_queue_free (self->priv->response_queue);
+  cookie_table_destroy (&self->priv->pending_reply_cookies);
+  xid_registry_destroy (&self->priv->xid_registry);
+  g_slist_foreach (self->priv->light_cookie_slabs, (GFunc)g_free, NULL);
+  g_slist_free (self->priv->light_cookie_slabs);
+  g_queue_free (self->priv->zombie_reply_cookies);
+
+  G_OBJECT_CLASS (gx_connection_parent_class)->finalize (object);
+}
+
+static void
+cookie_pending_finalized_notify (gpointer data,
+				 GObject *old_cookie)
+{
+  GXConnection *self = data;
+
+  cookie_table_remove (&self->priv->pending_reply_cookies,
+		       GX_COOKIE (old_cookie));
+}
+
+static void
+zombie_cookies_remove (GXConnection *self, GXCookie *cookie)
+{
+  GXCookieRegistration *registration = _gx_cookie_get_registration (cookie);
+  XCBResponseData *response = registration->queued_response;
+
+  /* NB: Rather than searching the response queue we leave the response
+   * for dispatch_next () to free */
+  if (response)
+    {
+      response->cookie = NULL;
+      registration->queued_response = NULL;
+    }
+
+  g_queue_delete_link (self->priv->zombie_reply_cookies,
+		       registration->zombie_link);
+  registration->zombie_link = NULL;
+}
+
+static void
+cookie_zombie_finalized_notify (gpointer data,
+				GObject *old_cookie)
+{
+  GXConnection *self = data;
+
+  zombie_cookies_remove (self, GX_COOKIE (old_cookie));
+}
+
+void
+gx_connection_dispose (GObject *object)
+{
+  GXConnection *self = GX_CONNECTION (object);
+  GXCookie *cookie;
+  guint i;
 
   /* NB: There is a circular dependency between connection and
    * cookie objects.
    */
 
-  /* We copy the list so we can use gx_connection_unregister_cookie
-   * (which modifies the pending/zombie_reply_cookies lists).
-   *
-   * We use gx_connection_unregister_cookie so we only have one
+  /* NB: This may unregister the GXCookie objects of light cookies */
+  free_unclaimed_light_cookies (self);
+
+  /* We use gx_connection_unregister_cookie so we only have one
    * place to deal with unregistering/unrefing cookies from the
    * connection */
-  copy_list = g_list_copy (self->priv->pending_reply_cookies->head);
-  for (tmp = copy_list; tmp != NULL; tmp = tmp->next)
-    gx_connection_unregister_cookie (self, tmp->data);
-  g_list_free (copy_list);
+  while ((cookie =
+	  cookie_table_peek_oldest (&self->priv->pending_reply_cookies)))
+    gx_connection_unregister_cookie (self, cookie);
+
+  while ((cookie = g_queue_peek_head (self->priv->zombie_reply_cookies)))
+    gx_connection_unregister_cookie (self, cookie);
 
-  copy_list = g_list_copy (self->priv->zombie_reply_cookies->head);
-  for (tmp = copy_list; tmp != NULL; tmp = tmp->next)
-    gx_connection_unregister_cookie (self, tmp->data);
-  g_list_free (copy_list);
+  g_list_free (self->priv->screens_list);
+  self->priv->screens_list = NULL;
+  for (i = 0; i < self->priv->n_screens; i++)
+    if (self->priv->screens[i])
+      {
+	g_object_unref (self->priv->screens[i]);
+	self->priv->screens[i] = NULL;
+      }
+
+  _gx_event_hooks_free (self->priv->event_hooks);
+  self->priv->event_hooks = NULL;
+
+  set_stats_interval (self, 0);
+  set_unclaimed_reply_ttl (self, 0);
 
   G_OBJECT_CLASS (gx_connection_parent_class)->dispose (object);
 }
@@ -400,39 +1230,56 @@ check_for_any_reply_or_error (GXConnection *self,
 {
   xcb_connection_t *xcb_connection =
     gx_connection_get_xcb_connection (self);
-  GList *tmp;
+  GXCookieTable *pending = &self->priv->pending_reply_cookies;
+  GXCookie *cookie;
+  GXCookieRegistration *registration;
 
   g_return_val_if_fail (reply && *reply == NULL, NULL);
   g_return_val_if_fail (error && *error == NULL, NULL);
 
-  for (tmp = self->priv->pending_reply_cookies->head;
-       tmp != NULL;
-       tmp = tmp->next)
+  /* Replies and errors arrive in sequence order, so if the oldest
+   * outstanding request hasn't completed then none of the newer
+   * ones have either. */
+  while ((cookie = cookie_table_peek_oldest (pending)))
     {
-      GXCookie *cookie = tmp->data;
       unsigned int request = gx_cookie_get_sequence (cookie);
-      xcb_poll_for_reply (xcb_connection, request, reply, error);
-#if 0
-#error "FIXME: check xcb_poll_for_reply semantics. Does obtaining a reply/error pointer"
-#error "this way mean we can't then call xcb_blah_reply(xcb_cookie) to get the same pointer?"
-#error "I guess not. Can we perhaps push the reply/error back in to xcb if not?"
-#endif
-      if (*reply || *error)
+
+      if (!xcb_poll_for_reply (xcb_connection, request, reply, error))
+	return NULL;
+
+      _gx_connection_response_received (self,
+					_gx_cookie_get_issue_time (cookie),
+					*error != NULL);
+
+      cookie_table_remove (pending, cookie);
+      g_object_weak_unref (G_OBJECT (cookie),
+			   cookie_pending_finalized_notify,
+			   self);
+
+      /* NB: A checked request without a reply that completed
+       * successfully has nothing to deliver, so rather than keeping it
+       * as a zombie we unregister it straight away. (If the caller
+       * holds a reference, its _reply () function will still find
+       * there was no error.) */
+      if (!*reply && !*error)
 	{
-	  g_queue_remove (self->priv->pending_reply_cookies,
-			  cookie);
-	  g_object_weak_unref (G_OBJECT (cookie),
-			       cookie_pending_finalized_notify,
-			       self);
-
-	  g_queue_push_tail (self->priv->zombie_reply_cookies,
-			     cookie);
-	  g_object_weak_ref (G_OBJECT (cookie),
-			     cookie_zombie_finalized_notify,
-			     self);
-	  g_object_set_qdata (G_OBJECT (cookie), cookie_pending_quark, NULL);
-	  return cookie;
+	  g_object_unref (cookie);
+	  continue;
 	}
+
+      registration = _gx_cookie_get_registration (cookie);
+      g_queue_push_tail (self->priv->zombie_reply_cookies,
+			 cookie);
+      registration->zombie_link = self->priv->zombie_reply_cookies->tail;
+      registration->reply_time = _gx_connection_timestamp ();
+      g_object_weak_ref (G_OBJECT (cookie),
+			 cookie_zombie_finalized_notify,
+			 self);
+      self->priv->stats.zombie_cookies_high_water =
+	MAX (self->priv->stats.zombie_cookies_high_water,
+	     self->priv->zombie_reply_cookies->length);
+
+      return cookie;
     }
 
   return NULL;
@@ -455,8 +1302,6 @@ queue_xcb_next (GXConnection *self)
   xcb_generic_error_t *error = NULL;
   GXCookie *cookie = NULL;
 
-  g_printerr ("queue_xcb_next0\n");
-
   /* FIXME: This doesn't seem to be a very nice way to have to deal with
    * replies, but xcb does not currently have a xcb_poll_for_any_reply()
    * function and so you have to pass xcb a specific sequence number.
@@ -472,26 +1317,32 @@ queue_xcb_next (GXConnection *self)
 
       if (reply)
 	{
-	  g_printerr ("queue_xcb_next REPLY\n");
+	  GX_NOTE (COOKIES, "queued reply for sequence %u",
+		   gx_cookie_get_sequence (cookie));
 	  response_data->type = _GX_COOKIE_RESPONSE_TYPE_REPLY;
 	  response_data->data = reply;
 	}
       else
 	{
-	  g_printerr ("queue_xcb_next ERROR\n");
+	  GX_NOTE (ERRORS, "queued error %d for sequence %u",
+		   error->error_code,
+		   gx_cookie_get_sequence (cookie));
 	  response_data->type = _GX_COOKIE_RESPONSE_TYPE_ERROR;
 	  response_data->data = error;
 	}
 
       g_queue_push_tail (self->priv->response_queue, response_data);
+      _gx_cookie_get_registration (cookie)->queued_response = response_data;
+      self->priv->stats.response_queue_high_water =
+	MAX (self->priv->stats.response_queue_high_water,
+	     self->priv->response_queue->length);
 
       return TRUE;
     }
 
-  /* xcb_poll_for_event may also return errors, so we either need to be
-   * sure that they are always picked up by check_for_any_reply_or_error
-   * or we need a way to lookup the corresponding request from the
-   * associated sequence number.
+  /* NB: xcb_poll_for_event also returns the errors for any requests
+   * that weren't checked, with a response_type of 0. These are queued
+   * with the events so they are delivered in order.
    *
    * XXX: I have a feeling it would be better for events to be handled with
    * a higher priority, than replys.
@@ -499,9 +1350,25 @@ queue_xcb_next (GXConnection *self)
   event = xcb_poll_for_event (xcb_connection);
   if (event)
     {
-      g_assert (event->response_type != 0);
       g_queue_push_tail (self->priv->events_queue, event);
-      g_printerr ("queue_xcb_next EVENT\n");
+
+      if (event->response_type == 0)
+	{
+	  GX_NOTE (ERRORS, "queued unchecked error %d for sequence %u",
+		   ((xcb_generic_error_t *)event)->error_code,
+		   event->sequence);
+	  self->priv->stats.errors++;
+	}
+      else
+	{
+	  GX_NOTE (EVENTS, "queued event %d", event->response_type);
+	  self->priv->stats.events++;
+	  self->priv->stats.events_by_code[event->response_type
+					   & GX_EVENT_CODE_MASK]++;
+	}
+      self->priv->stats.events_queue_high_water =
+	MAX (self->priv->stats.events_queue_high_water,
+	     self->priv->events_queue->length);
       return TRUE;
     }
 
@@ -527,10 +1394,23 @@ xcb_event_prepare (GSource *source,
 		   gint    *timeout)
 {
   GXXCBFDSource *xcb_source = (GXXCBFDSource *)source;
+  GXConnectionPrivate *priv = xcb_source->connection->priv;
 
   /* We don't mind how long poll() will block */
   *timeout = -1;
 
+  /* NB: prepare is called each time the mainloop is about to poll, so
+   * this is our chance to push out anything queued since the last
+   * mainloop iteration before potentially going to sleep. */
+  if (priv->flush_on_idle
+      && priv->queued_requests
+      && priv->batch_depth == 0)
+    {
+      GX_NOTE (DISPATCH, "flushing %u requests on idle",
+	       priv->queued_requests);
+      gx_connection_flush (xcb_source->connection, FALSE);
+    }
+
   return is_anything_pending (xcb_source->connection)
 	 || (queue_xcb_next (xcb_source->connection)
 	     && is_anything_pending (xcb_source->connection));
@@ -552,40 +1432,81 @@ xcb_event_check (GSource *source)
 static void
 signal_event (GXConnection *connection, xcb_generic_event_t *xcb_event)
 {
+  GXConnectionPrivate *priv = connection->priv;
   GXGenericEvent *event;
-  guint32 window_xid;
-  static guint window_event_signal_id = 0;
-  GQuark event_detail;
+  GXEventDetails *details;
+  int code;
+  guint32 window_xid = 0;
+  GQuark event_detail = 0;
 
   event = gx_event_from_xcb_event (xcb_event);
-  event_detail = g_quark_from_string (gx_event_get_name (event));
-#warning "FIXME: avoid g_quark_from_string when emitting events!"
 
-  g_signal_emit (connection, gx_connection_signals[EVENT_SIGNAL],
-		 event_detail, event);
+  code = event->type & GX_EVENT_CODE_MASK;
+  details = priv->event_details[code];
+  if (G_UNLIKELY (!details))
+    {
+      /* We may not have seen any events yet, or an extension may have
+       * been registered since we last looked. */
+      _gx_event_details_update_table (priv->xcb_connection,
+				      priv->event_details,
+				      &priv->event_details_serial);
+      details = priv->event_details[code];
+    }
+
+  if (details)
+    {
+      event_detail = details->detail;
+      if (details->window_xid_offset)
+	window_xid =
+	  *(guint32 *)((guint8 *)event + details->window_xid_offset);
+    }
+
+  if (priv->event_hooks)
+    _gx_event_hooks_dispatch (priv->event_hooks, connection, event);
+
+  /* NB: Marshalling the signal is relatively expensive so we avoid it
+   * unless someone is listening */
+  if (GX_CONNECTION_GET_CLASS (connection)->event
+      || g_signal_has_handler_pending (connection,
+				       gx_connection_signals[EVENT_SIGNAL],
+				       event_detail,
+				       FALSE))
+    g_signal_emit (connection, gx_connection_signals[EVENT_SIGNAL],
+		   event_detail, event);
 
-  window_xid = gx_event_get_window_xid (event);
   if (window_xid)
     {
-      GXWindow *window = gx_window_find_from_xid (window_xid);
+      GXWindow *window = gx_window_find_from_xid (connection, window_xid);
       if (window)
 	{
-	  if (!window_event_signal_id)
-	    window_event_signal_id = g_signal_lookup ("event", GX_TYPE_WINDOW);
-	  g_signal_emit (window, window_event_signal_id,
-			 event_detail, event);
+	  _gx_window_dispatch_event (window, event, event_detail);
 	  g_object_unref (window);
 	}
     }
 }
 
+static void
+signal_protocol_error (GXConnection *connection, xcb_generic_error_t *error)
+{
+  if (g_signal_has_handler_pending (connection,
+				    gx_connection_signals[PROTOCOL_ERROR_SIGNAL],
+				    0,
+				    FALSE))
+    g_signal_emit (connection, gx_connection_signals[PROTOCOL_ERROR_SIGNAL],
+		   0, error);
+  else
+    GX_NOTE (ERRORS, "unhandled error %d for request %d.%d (sequence %u)",
+	     error->error_code, error->major_code, error->minor_code,
+	     error->sequence);
+
+  free (error);
+}
+
 static void
 signal_reply (GXConnection *connection, GXCookie *cookie)
 {
   static guint reply_signal = 0;
 
-  g_print ("reply\n");
-
   if (!reply_signal)
     reply_signal = g_signal_lookup ("reply", GX_TYPE_COOKIE);
 
@@ -598,8 +1519,6 @@ signal_error (GXConnection *connection, GXCookie *cookie)
 {
   static guint error_signal = 0;
 
-  g_print ("error\n");
-
   if (!error_signal)
     error_signal = g_signal_lookup ("error", GX_TYPE_COOKIE);
 
@@ -607,23 +1526,20 @@ signal_error (GXConnection *connection, GXCookie *cookie)
   g_signal_emit (connection, ERROR_SIGNAL, 0);
 }
 
+/* Delivers a single queued event, reply or error.
+ *
+ * Returns FALSE if there was nothing left to deliver. */
 static gboolean
-xcb_event_dispatch (GSource *source, GSourceFunc callback, gpointer data)
+dispatch_next (GXConnection *connection)
 {
-  GXXCBFDSource	*xcb_source = (GXXCBFDSource *)source;
-  GXConnection	*connection = xcb_source->connection;
-
-  g_printerr ("xcb_event_dispatch\n");
-
-  /* Queue up all data recieved from XCB. */
-  while (queue_xcb_next (connection))
-    ; /*  */
-
   if (g_queue_peek_head (connection->priv->events_queue))
     {
       xcb_generic_event_t *event =
 	g_queue_pop_head (connection->priv->events_queue);
-      signal_event (xcb_source->connection, event);
+      if (event->response_type == 0)
+	signal_protocol_error (connection, (xcb_generic_error_t *)event);
+      else
+	signal_event (connection, event);
       return TRUE;
     }
 
@@ -631,21 +1547,80 @@ xcb_event_dispatch (GSource *source, GSourceFunc callback, gpointer data)
     {
       XCBResponseData *response =
 	g_queue_pop_head (connection->priv->response_queue);
-      if (response->type == _GX_COOKIE_RESPONSE_TYPE_REPLY)
-	gx_cookie_set_reply (response->cookie, response->data);
-      else
+      GXCookie *cookie = response->cookie;
+      GXCookieRegistration *registration;
+
+      /* NB: The cookie may have been unregistered since the response
+       * was queued */
+      if (!cookie)
 	{
-	  /* FIXME - DEBUG */
-	  g_print ("calling gx_cookie_set_error\n");
-	  gx_cookie_set_error (response->cookie, response->data);
+	  free (response->data);
+	  g_slice_free (XCBResponseData, response);
+	  return TRUE;
 	}
+
+      registration = _gx_cookie_get_registration (cookie);
+      registration->queued_response = NULL;
+
+      g_object_ref (cookie);
+      if (response->type == _GX_COOKIE_RESPONSE_TYPE_REPLY)
+	gx_cookie_set_reply (cookie, response->data);
+      else
+	gx_cookie_set_error (cookie, response->data);
       g_slice_free (XCBResponseData, response);
+
+      /* A handler may have already claimed the reply */
+      if (registration->forget && registration->zombie_link)
+	gx_connection_unregister_cookie (connection, cookie);
+      g_object_unref (cookie);
+
       return TRUE;
     }
 
   return FALSE;
 }
 
+static gboolean
+xcb_event_dispatch (GSource *source, GSourceFunc callback, gpointer data)
+{
+  GXXCBFDSource	*xcb_source = (GXXCBFDSource *)source;
+  GXConnection	*connection = xcb_source->connection;
+  guint		 batch_size = connection->priv->dispatch_batch_size;
+  guint		 time_budget = connection->priv->dispatch_time_budget;
+  gint64	 start = 0;
+  guint		 i;
+
+  /* Queue up all data recieved from XCB. */
+  while (queue_xcb_next (connection))
+    ; /*  */
+
+  if (time_budget)
+    start = _gx_connection_timestamp ();
+
+  /* NB: we re-read the batch size each time around since a handler
+   * may change it. A batch size of 1 gives the traditional behaviour
+   * of delivering one item per mainloop iteration. */
+  for (i = 0; i < batch_size; i++)
+    {
+      if (!dispatch_next (connection))
+	break;
+
+      if (time_budget && _gx_connection_timestamp () - start >= time_budget)
+	break;
+
+      batch_size = connection->priv->dispatch_batch_size;
+    }
+
+  GX_NOTE (DISPATCH, "dispatched %u events/responses", i);
+
+  if (connection->priv->max_unclaimed_replies
+      && (connection->priv->zombie_reply_cookies->length
+	  > connection->priv->max_unclaimed_replies))
+    reap_zombie_cookies (connection);
+
+  return TRUE;
+}
+
 
 static GSourceFuncs xcb_source_funcs = {
     .prepare = xcb_event_prepare,
@@ -689,19 +1664,41 @@ remove_xcb_event_source (GXConnection *self)
   g_source_unref ((GSource *)self->priv->xcb_source);
 }
 
-static void
-connect_to_display (GXConnection *self, const char *display)
+/* NB: This may be called from a worker thread (see
+ * gx_connection_new_async ()) so it mustn't touch any GXConnection
+ * state. */
+static xcb_connection_t *
+connect_to_display (const char *display,
+		    int *preferred_screen_num,
+		    gdouble *connect_time)
 {
-  int preferred_screen_num;
-  xcb_connection_t  *xcb_connection;
+  xcb_connection_t *xcb_connection;
+  GTimer	   *timer;
 
   if (!display)
     display = getenv ("DISPLAY");
 
-  xcb_connection = xcb_connect (display, &preferred_screen_num);
-  self->priv->xcb_connection = xcb_connection;
+  timer = g_timer_new ();
+  xcb_connection = xcb_connect (display, preferred_screen_num);
+  *connect_time = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  GX_NOTE (CONNECTION, "Connecting to %s took %.3fms",
+	   display ? display : "(null)", *connect_time * 1000);
+
+  return xcb_connection;
+}
+
+static void
+setup_connection (GXConnection *self)
+{
+  xcb_connection_t *xcb_connection = self->priv->xcb_connection;
+  GTimer	   *timer;
+
+  timer = g_timer_new ();
 
-  if (xcb_connection_has_error (xcb_connection))
+  self->priv->connection_error = xcb_connection_has_error (xcb_connection);
+  if (self->priv->connection_error)
     {
       self->priv->has_error = TRUE;
       /* NB: In this error condition, the xcb_connection_t returned
@@ -711,68 +1708,67 @@ connect_to_display (GXConnection *self, const char *display)
     }
   else
     {
+      const xcb_setup_t	   *setup;
       xcb_screen_iterator_t iter;
-      int		    screen_index = 0;
+      guint		    i;
 
       self->priv->has_error = FALSE;
 
-      for (iter = xcb_setup_roots_iterator (xcb_get_setup (xcb_connection));
+      setup = xcb_get_setup (xcb_connection);
+      xid_registry_set_range (&self->priv->xid_registry,
+			      setup->resource_id_base,
+			      setup->resource_id_mask);
+
+      _gx_event_details_prefetch (xcb_connection);
+
+      /* NB: XCB enables the BIG-REQUESTS extension (if available) as
+       * part of determining the maximum request length. */
+      xcb_prefetch_maximum_request_length (xcb_connection);
+
+      /* NB: The screen objects are only created when first needed
+       * (See get_screen ()) */
+      self->priv->n_screens = xcb_setup_roots_length (setup);
+      self->priv->xcb_screens =
+	g_new (const xcb_screen_t *, self->priv->n_screens);
+      self->priv->screens = g_new0 (GXScreen *, self->priv->n_screens);
+      for (iter = xcb_setup_roots_iterator (setup), i = 0;
 	   iter.rem;
-	   xcb_screen_next (&iter))
-	{
-	  xcb_screen_t *screen = iter.data;
-	  GXWindow     *root;
-	  GXScreen     *gx_screen;
-
-	  /* TODO: It might be nicer if there were an "xcb-screen" property
-	   * we could use so we could move this code inside gx-screen.c:
-	   */
-
-	  /* NB: The "xid" + "wrap" properties can be used to create GXWindow
-	   * objects that wrap an existing window XID */
-	  root = GX_WINDOW (g_object_new (GX_TYPE_WINDOW,
-					  "connection", self,
-					  "xid", screen->root,
-					  "wrap", TRUE,
-					  NULL));
-
-	  gx_screen =
-	    GX_SCREEN (g_object_new (GX_TYPE_SCREEN,
-				     "root", root,
-				     "default-colormap",
-					screen->default_colormap,
-				     "white-pixel", screen->white_pixel,
-				     "black-pixel", screen->black_pixel,
-				     /* TODO: current_input_masks */
-				     "width", screen->width_in_pixels,
-				     "height", screen->height_in_pixels,
-				     "width-in-millimeters",
-					screen->width_in_millimeters,
-				     "height-in-millimeters",
-					screen->height_in_millimeters,
-				     "min-installed-maps",
-					screen->min_installed_maps,
-				     "max-installed-maps",
-					screen->max_installed_maps,
-				     "root-visual-id", screen->root_visual,
-				     "backing-stores", screen->backing_stores,
-				     "save-unders", screen->save_unders,
-				     "root-depth", screen->root_depth,
-				     /* TODO - list of allowed depths */
-				     NULL
-				     ));
-	  self->priv->screens =
-	    g_list_prepend (self->priv->screens, gx_screen);
-
-	  if (screen_index == preferred_screen_num)
-	    {
-	      self->priv->default_screen = gx_screen;
-	    }
-	  screen_index++;
-	}
+	   xcb_screen_next (&iter), i++)
+	self->priv->xcb_screens[i] = iter.data;
 
       add_xcb_event_source (self);
     }
+
+  self->priv->setup_time = g_timer_elapsed (timer, NULL);
+  g_timer_destroy (timer);
+
+  GX_NOTE (CONNECTION, "Connection setup took %.3fms",
+	   self->priv->setup_time * 1000);
+}
+
+static GXScreen *
+get_screen (GXConnection *self, guint number)
+{
+  if (number >= self->priv->n_screens)
+    return NULL;
+
+  if (!self->priv->screens[number])
+    {
+      GTimer  *timer = g_timer_new ();
+      gdouble  elapsed;
+
+      self->priv->screens[number] =
+	_gx_screen_new (self, self->priv->xcb_screens[number], number);
+
+      elapsed = g_timer_elapsed (timer, NULL);
+      g_timer_destroy (timer);
+      self->priv->setup_time += elapsed;
+
+      GX_NOTE (CONNECTION, "Creating screen %u took %.3fms",
+	       number, elapsed * 1000);
+    }
+
+  return self->priv->screens[number];
 }
 
 static void
@@ -794,124 +1790,1207 @@ gx_connection_flush (GXConnection *connection, gboolean flush_server)
      else
      */
   xcb_flush (connection->priv->xcb_connection);
-}
 
-gboolean
-gx_connection_has_error (GXConnection *self)
-{
-  return self->priv->has_error;
+  _gx_connection_requests_flushed (connection);
 }
 
 /**
- * gx_connection_register_cookie:
- * @self: a GX Connection
- * @cookie: a new GX Cookie
- *
- * This registers a new cookie with a connection so that a reply corresponding
- * to that cookie can trigger a signal to the user.
- *
- * Typically you wouldn't have to do this yourself since any cookies you get
- * back from auto generated GX APIs will already be registered with your
- * connection.
+ * gx_connection_add_event_handler:
+ * @self: A GXConnection
+ * @codes: The event codes the handler is interested in, or %NULL for
+ *	   all events
+ * @func: The function to call for each event
+ * @user_data: Data to pass to @func
+ * @notify: Function to free @user_data when the handler is removed,
+ *	    or %NULL
  *
- * This function takes a reference on the cookie, which means that developers
- * shouldn't normally need to worry about managing the ref count of cookies.
+ * Adds a handler that is called directly for each matching event,
+ * before the "event" signal is emitted. This avoids the overhead of
+ * GSignal marshalling for clients that handle a lot of events.
  *
- * The cookie will be unref'd when it is unregistered from the connection,
- * which automatically happens via the gx_*_reply() functions.
+ * Returns: An id for use with gx_connection_remove_event_handler ()
  */
-void
-gx_connection_register_cookie (GXConnection *self, GXCookie *cookie)
+guint
+gx_connection_add_event_handler (GXConnection *self,
+				 const GXEventCodeSet *codes,
+				 GXConnectionEventFunc func,
+				 gpointer user_data,
+				 GDestroyNotify notify)
 {
-  g_object_ref_sink (cookie);
+  g_return_val_if_fail (GX_IS_CONNECTION (self), 0);
+  g_return_val_if_fail (func != NULL, 0);
 
-  /* If developers manually unref a cookie, instead of calling
-   * gx_connection_unregister_cookie, then we will be notified, and all will
-   * be well.
-   *
-   * NB: We depend on the behaviour within gx_*_reply() functions.
-   * It's slightly slimpler than calling gx_connection_unregister_cookie
-   * because the weak pointer callbacks know which priv queue the
-   * cookie is currently in. */
+  return _gx_event_hooks_add (&self->priv->event_hooks, codes,
+			      (_GXEventHookFunc)func, user_data, notify);
+}
 
-  g_object_weak_ref (G_OBJECT (cookie),
-		     cookie_pending_finalized_notify,
-		     self);
-  g_queue_push_tail (self->priv->pending_reply_cookies,
-		     cookie);
-  g_object_set_qdata (G_OBJECT (cookie), cookie_pending_quark, "1");
+void
+gx_connection_remove_event_handler (GXConnection *self, guint id)
+{
+  g_return_if_fail (GX_IS_CONNECTION (self));
+
+  _gx_event_hooks_remove (self->priv->event_hooks, id);
 }
 
 /**
- * gx_connection_unregister_cookie:
- * @self: a GX Connection
- * @cookie: a new GX Cookie
+ * gx_connection_begin_batch:
+ * @self: A GXConnection
  *
- * After calling this function the GXConnection will no longer be able to
- * cause a signal based notification of a reply for the coresponding cookie.
+ * Starts a batch of requests (such as everything needed to draw a
+ * frame) that should be sent to the server together. Until the
+ * matching gx_connection_end_batch () GX won't flush the requests,
+ * either because of the auto-flush thresholds or when the mainloop
+ * goes idle. (XCB may still write out its buffer if it fills up.)
  *
- * As with gx_connection_register_cookie, developers shouldn't normally need
- * to use this directly since cookies are automatically unregistered via the
- * gx_*_reply() functions.
+ * Batches may be nested.
  */
 void
-gx_connection_unregister_cookie (GXConnection *self, GXCookie *cookie)
+gx_connection_begin_batch (GXConnection *self)
 {
-  g_queue_remove (self->priv->pending_reply_cookies, cookie);
-  g_queue_remove (self->priv->zombie_reply_cookies, cookie);
+  g_return_if_fail (GX_IS_CONNECTION (self));
 
-  response_queue_remove_cookie_references (self, cookie);
-
-  if (g_object_get_qdata (G_OBJECT (cookie), cookie_pending_quark))
-    g_object_weak_unref (G_OBJECT (cookie),
-			 cookie_pending_finalized_notify,
-			 self);
-  else
-    g_object_weak_unref (G_OBJECT (cookie),
-			 cookie_zombie_finalized_notify,
-			 self);
-  g_object_unref (cookie);
+  self->priv->batch_depth++;
 }
 
 /**
- * gx_connection_get_default_screen:
- * self: A connection object
+ * gx_connection_end_batch:
+ * @self: A GXConnection
  *
- * Returns a new reference to the default screen object.
+ * Ends a batch started with gx_connection_begin_batch (), flushing
+ * all the requests queued during the outermost batch.
  */
-GXScreen *
-gx_connection_get_default_screen (GXConnection *self)
+void
+gx_connection_end_batch (GXConnection *self)
 {
-  return g_object_ref (self->priv->default_screen);
+  g_return_if_fail (GX_IS_CONNECTION (self));
+  g_return_if_fail (self->priv->batch_depth > 0);
+
+  if (--self->priv->batch_depth == 0 && self->priv->queued_requests)
+    gx_connection_flush (self, FALSE);
 }
 
-/**
- * gx_connection_get_screens:
- * self: A connection object
- *
- * Returns a GList of all the screens available. Note you must unref
- * all the entries in the list when finished, and free the list.
- */
-GList *
-gx_connection_get_screens (GXConnection *self)
+/* Returns the number of requests queued since GX last flushed */
+guint
+gx_connection_get_queued_requests (GXConnection *self)
 {
-  g_list_foreach (self->priv->screens, (GFunc)g_object_ref, NULL);
-  return g_list_copy (self->priv->screens);
+  return self->priv->queued_requests;
 }
 
-/**
- * gx_connection_get_default_root:
- * self: A connection object
- *
- * Returns a new reference to the root window of the default screen
- */
-GXWindow *
-gx_connection_get_default_root (GXConnection *self)
+/* Returns an estimate of the number of bytes of requests queued since
+ * GX last flushed */
+gsize
+gx_connection_get_queued_bytes (GXConnection *self)
 {
-  GXScreen *screen = gx_connection_get_default_screen(self);
-  GXWindow *root = gx_screen_get_root (screen);
-  g_object_unref (screen);
-  return g_object_ref (root);
+  return self->priv->queued_bytes;
 }
 
+/* Called by the generated request functions after handing a request
+ * to XCB */
+void
+_gx_connection_request_queued (GXConnection *self, gsize bytes)
+{
+  GXConnectionPrivate *priv = self->priv;
+
+  priv->stats.requests++;
+  priv->queued_requests++;
+  priv->queued_bytes += bytes;
+
+  if (priv->batch_depth)
+    return;
 
+  if ((priv->auto_flush_requests
+       && priv->queued_requests >= priv->auto_flush_requests)
+      || (priv->auto_flush_bytes
+	  && priv->queued_bytes >= priv->auto_flush_bytes))
+    gx_connection_flush (self, FALSE);
+}
+
+/**
+ * gx_connection_get_maximum_request_length:
+ * @self: A GXConnection
+ *
+ * Returns the maximum length of a request, in units of 4 bytes, which
+ * will be much larger than the core protocol limit of 256KB if the
+ * server supports BIG-REQUESTS.
+ *
+ * Generated drawing requests (such as gx_drawable_poly_line () and
+ * gx_drawable_put_image ()) automatically split their data across
+ * several requests if needed to stay within this limit. Only the last
+ * of these requests is checked; errors for the others are delivered via
+ * the "protocol-error" signal.
+ *
+ * A request that can't be split small enough (an XYPixmap image, or
+ * an image with rows that are too long) isn't sent. The synchronous
+ * functions fail with a BadLength GX_PROTOCOL_ERROR and the _async ()
+ * functions return a %NULL cookie.
+ */
+guint32
+gx_connection_get_maximum_request_length (GXConnection *self)
+{
+  GXConnectionPrivate *priv = self->priv;
+
+  if (G_UNLIKELY (!priv->maximum_request_length))
+    priv->maximum_request_length =
+      xcb_get_maximum_request_length (priv->xcb_connection);
+
+  return priv->maximum_request_length;
+}
+
+/* Returns how many list items of item_size bytes fit in a single
+ * request, after a header of header_size bytes. (Used by generated
+ * code to split oversize requests.)
+ *
+ * NB: This may be 0 if a single item doesn't fit, which callers must
+ * check for. */
+guint32
+_gx_connection_get_max_request_items (GXConnection *self,
+				      gsize header_size,
+				      gsize item_size)
+{
+  /* NB: BIG-REQUESTS adds 4 bytes to the request header */
+  gsize max_bytes =
+    (gsize)gx_connection_get_maximum_request_length (self) * 4
+    - header_size - 4;
+
+  return max_bytes / item_size;
+}
+
+/* Used by generated code to report a request that was too large to
+ * send, as if the server had responded with BadLength */
+void
+_gx_connection_set_request_too_large_error (GError **error)
+{
+  xcb_generic_error_t xcb_error;
+
+  memset (&xcb_error, 0, sizeof (xcb_error));
+  xcb_error.error_code = XCB_LENGTH;
+
+  g_set_error (error,
+	       GX_PROTOCOL_ERROR,
+	       gx_protocol_error_from_xcb_error (&xcb_error),
+	       "Request too large to send");
+}
+
+/* Returns a newly allocated copy of a CoordModePrevious list of points
+ * with all the points made relative to the origin, so the list can be
+ * split across several requests. */
+xcb_point_t *
+_gx_points_to_absolute (const xcb_point_t *points, guint32 n_points)
+{
+  xcb_point_t *absolute_points = g_new (xcb_point_t, n_points);
+  guint32 i;
+
+  if (!n_points)
+    return absolute_points;
+
+  absolute_points[0] = points[0];
+  for (i = 1; i < n_points; i++)
+    {
+      absolute_points[i].x = absolute_points[i - 1].x + points[i].x;
+      absolute_points[i].y = absolute_points[i - 1].y + points[i].y;
+    }
+
+  return absolute_points;
+}
+
+/* Called whenever we know XCB has written out all queued requests,
+ * i.e. after xcb_flush () or after waiting for the reply to the newest
+ * request. (XCB only writes out its buffer while waiting for a reply if
+ * the request hasn't been sent yet.) */
+void
+_gx_connection_requests_flushed (GXConnection *self)
+{
+  if (self->priv->queued_requests)
+    {
+      self->priv->stats.flushes++;
+      self->priv->stats.bytes_flushed += self->priv->queued_bytes;
+    }
+
+  self->priv->queued_requests = 0;
+  self->priv->queued_bytes = 0;
+}
+
+/* Called before waiting for the reply to a request that may not be the
+ * newest one. We can't tell whether XCB will write out its buffer while
+ * waiting, so we flush first to keep the queued request counts honest,
+ * which also means any later requests are sent while we wait. Within a
+ * batch we leave it to XCB and gx_connection_end_batch (). */
+void
+_gx_connection_flush_for_reply (GXConnection *self)
+{
+  if (self->priv->queued_requests && self->priv->batch_depth == 0)
+    gx_connection_flush (self, FALSE);
+}
+
+gboolean
+gx_connection_has_error (GXConnection *self)
+{
+  return self->priv->has_error;
+}
+
+GQuark
+gx_connection_error_quark (void)
+{
+  return g_quark_from_static_string ("gx-connection-error-quark");
+}
+
+/**
+ * gx_connection_check_error:
+ * @self: A connection object
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Checks whether the connection is usable, and if not sets @error
+ * according to the XCB_CONN_* code that XCB reported.
+ *
+ * Returns: %FALSE if there was an error establishing the connection
+ */
+gboolean
+gx_connection_check_error (GXConnection *self, GError **error)
+{
+  const char *display = self->priv->display;
+
+  if (!self->priv->has_error)
+    return TRUE;
+
+  if (!display)
+    display = g_getenv ("DISPLAY");
+  if (!display)
+    display = "(null)";
+
+  switch (self->priv->connection_error)
+    {
+    case GX_CONNECTION_ERROR_EXT_NOTSUPPORTED:
+      g_set_error (error, GX_CONNECTION_ERROR, self->priv->connection_error,
+		   "An extension required by %s is not supported",
+		   display);
+      break;
+    case GX_CONNECTION_ERROR_MEM_INSUFFICIENT:
+      g_set_error (error, GX_CONNECTION_ERROR, self->priv->connection_error,
+		   "Insufficient memory to connect to %s", display);
+      break;
+    case GX_CONNECTION_ERROR_REQ_LEN_EXCEED:
+      g_set_error (error, GX_CONNECTION_ERROR, self->priv->connection_error,
+		   "Exceeded the maximum request length of %s", display);
+      break;
+    case GX_CONNECTION_ERROR_PARSE_ERR:
+      g_set_error (error, GX_CONNECTION_ERROR, self->priv->connection_error,
+		   "Failed to parse the display name \"%s\"", display);
+      break;
+    case GX_CONNECTION_ERROR_INVALID_SCREEN:
+      g_set_error (error, GX_CONNECTION_ERROR, self->priv->connection_error,
+		   "%s has no such screen", display);
+      break;
+    default:
+      g_set_error (error, GX_CONNECTION_ERROR, GX_CONNECTION_ERROR_FAILED,
+		   "Failed to connect to %s", display);
+      break;
+    }
+
+  return FALSE;
+}
+
+/**
+ * gx_connection_get_connect_time:
+ * @self: A connection object
+ *
+ * Returns: The time in seconds that was spent establishing the
+ * connection with xcb_connect ().
+ */
+gdouble
+gx_connection_get_connect_time (GXConnection *self)
+{
+  return self->priv->connect_time;
+}
+
+/**
+ * gx_connection_get_setup_time:
+ * @self: A connection object
+ *
+ * Returns: The time in seconds that was spent setting up the connection
+ * once connected, including the time spent creating screen objects so
+ * far. (These are only created when first needed.)
+ */
+gdouble
+gx_connection_get_setup_time (GXConnection *self)
+{
+  return self->priv->setup_time;
+}
+
+/* Returns the current time in microseconds, for timestamping requests
+ * and their replies. NB: This is read from a monotonic clock so
+ * latencies and timeouts aren't affected by changes to the wall clock,
+ * and it is only meaningful relative to other timestamps. */
+gint64
+_gx_connection_timestamp (void)
+{
+#if GLIB_CHECK_VERSION (2, 28, 0)
+  return g_get_monotonic_time ();
+#else
+  struct timespec now;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return (gint64)now.tv_sec * G_USEC_PER_SEC + now.tv_nsec / 1000;
+#endif
+}
+
+static guint
+latency_bucket (guint64 latency)
+{
+  guint shift;
+  guint bucket;
+
+  if (latency < GX_CONNECTION_LATENCY_SUB_BUCKETS)
+    return latency;
+
+  /* NB: This is well beyond the range of the histogram, and means
+   * g_bit_storage () will work even with a 32bit gulong */
+  if (latency > G_MAXINT32)
+    return GX_CONNECTION_N_LATENCY_BUCKETS - 1;
+
+  /* NB: the top bit selects the power of two range and the next 3 bits
+   * select the bucket within it */
+  shift = g_bit_storage ((gulong)latency) - 4;
+  bucket = GX_CONNECTION_LATENCY_SUB_BUCKETS * (shift + 1)
+	   + ((latency >> shift) & (GX_CONNECTION_LATENCY_SUB_BUCKETS - 1));
+
+  return MIN (bucket, GX_CONNECTION_N_LATENCY_BUCKETS - 1);
+}
+
+/* Called whenever a reply or error is read from XCB, with the time its
+ * cookie was created */
+void
+_gx_connection_response_received (GXConnection *self,
+				  gint64 issue_time,
+				  gboolean error)
+{
+  GXConnectionStats *stats = &self->priv->stats;
+  gint64 latency = _gx_connection_timestamp () - issue_time;
+
+  if (error)
+    stats->errors++;
+  else
+    stats->replies++;
+
+  /* NB: The clock is monotonic so this shouldn't happen, but a negative
+   * latency mustn't be used to pick a histogram bucket */
+  if (latency < 0)
+    latency = 0;
+
+  if (stats->latency_count == 0 || latency < stats->latency_min)
+    stats->latency_min = latency;
+  if (latency > stats->latency_max)
+    stats->latency_max = latency;
+  stats->latency_count++;
+  stats->latency_total += latency;
+  stats->latency_buckets[latency_bucket (latency)]++;
+}
+
+/**
+ * gx_connection_get_stats:
+ * @self: A connection object
+ * @stats: A #GXConnectionStats to fill in
+ *
+ * Takes a snapshot of the runtime statistics for the connection: the
+ * number of requests, replies, errors and events (by event code) since
+ * the connection was created or gx_connection_reset_stats () was last
+ * called, the current depths and high-water marks of the connection's
+ * internal queues and a histogram of the latency between issuing
+ * requests and receiving their replies.
+ *
+ * Set the "stats-interval" property to have the "stats" signal emitted
+ * with a snapshot periodically.
+ */
+void
+gx_connection_get_stats (GXConnection *self, GXConnectionStats *stats)
+{
+  GXConnectionPrivate *priv;
+
+  g_return_if_fail (GX_IS_CONNECTION (self));
+  g_return_if_fail (stats != NULL);
+
+  priv = self->priv;
+
+  *stats = priv->stats;
+  stats->pending_cookies = priv->pending_reply_cookies.n_cookies;
+  stats->zombie_cookies = priv->zombie_reply_cookies->length;
+  stats->events_queue_length = priv->events_queue->length;
+  stats->response_queue_length = priv->response_queue->length;
+}
+
+/**
+ * gx_connection_reset_stats:
+ * @self: A connection object
+ *
+ * Resets all the counters and the latency histogram reported by
+ * gx_connection_get_stats (). The high-water marks are reset to the
+ * current queue depths.
+ */
+void
+gx_connection_reset_stats (GXConnection *self)
+{
+  GXConnectionPrivate *priv;
+
+  g_return_if_fail (GX_IS_CONNECTION (self));
+
+  priv = self->priv;
+
+  memset (&priv->stats, 0, sizeof (GXConnectionStats));
+  priv->stats.pending_cookies_high_water =
+    priv->pending_reply_cookies.n_cookies;
+  priv->stats.zombie_cookies_high_water = priv->zombie_reply_cookies->length;
+  priv->stats.events_queue_high_water = priv->events_queue->length;
+  priv->stats.response_queue_high_water = priv->response_queue->length;
+}
+
+/**
+ * gx_connection_stats_get_latency_bucket_range:
+ * @bucket: A latency histogram bucket index
+ * @min: Return location for the smallest latency counted in @bucket
+ * @max: Return location for the largest latency counted in @bucket
+ *
+ * Gets the range of latencies (in microseconds) counted in the given
+ * bucket of #GXConnectionStats.latency_buckets.
+ */
+void
+gx_connection_stats_get_latency_bucket_range (guint bucket,
+					      guint64 *min,
+					      guint64 *max)
+{
+  guint shift;
+
+  g_return_if_fail (bucket < GX_CONNECTION_N_LATENCY_BUCKETS);
+
+  if (bucket < GX_CONNECTION_LATENCY_SUB_BUCKETS)
+    {
+      *min = *max = bucket;
+      return;
+    }
+
+  shift = bucket / GX_CONNECTION_LATENCY_SUB_BUCKETS - 1;
+  *min = (guint64)(GX_CONNECTION_LATENCY_SUB_BUCKETS
+		   + bucket % GX_CONNECTION_LATENCY_SUB_BUCKETS) << shift;
+  if (bucket == GX_CONNECTION_N_LATENCY_BUCKETS - 1)
+    *max = G_MAXUINT64;
+  else
+    *max = *min + ((guint64)1 << shift) - 1;
+}
+
+/**
+ * gx_connection_stats_get_latency_percentile:
+ * @stats: Statistics returned by gx_connection_get_stats ()
+ * @percentile: A percentile between 0 and 100
+ *
+ * Returns: An upper bound (within the precision of the histogram) on
+ * the request latency in microseconds for the given percentile of
+ * replies, or 0 if no replies have been received.
+ */
+guint64
+gx_connection_stats_get_latency_percentile (const GXConnectionStats *stats,
+					    gdouble percentile)
+{
+  guint64 target;
+  guint64 count = 0;
+  guint i;
+
+  g_return_val_if_fail (stats != NULL, 0);
+
+  if (!stats->latency_count)
+    return 0;
+
+  percentile = CLAMP (percentile, 0, 100);
+  target = MAX ((guint64)(stats->latency_count * percentile / 100 + 0.5), 1);
+
+  for (i = 0; i < GX_CONNECTION_N_LATENCY_BUCKETS; i++)
+    {
+      count += stats->latency_buckets[i];
+      if (count >= target)
+	{
+	  guint64 min, max;
+
+	  gx_connection_stats_get_latency_bucket_range (i, &min, &max);
+	  return CLAMP (max, stats->latency_min, stats->latency_max);
+	}
+    }
+
+  return stats->latency_max;
+}
+
+static gboolean
+stats_timeout_cb (gpointer data)
+{
+  GXConnection *self = data;
+  GXConnectionStats stats;
+
+  gx_connection_get_stats (self, &stats);
+  g_signal_emit (self, gx_connection_signals[STATS_SIGNAL], 0, &stats);
+
+  return TRUE;
+}
+
+static void
+set_stats_interval (GXConnection *self, guint interval)
+{
+  GXConnectionPrivate *priv = self->priv;
+
+  if (priv->stats_timeout_id)
+    {
+      g_source_remove (priv->stats_timeout_id);
+      priv->stats_timeout_id = 0;
+    }
+
+  priv->stats_interval = interval;
+  if (interval)
+    priv->stats_timeout_id = g_timeout_add (interval, stats_timeout_cb, self);
+}
+
+/**
+ * gx_connection_register_cookie:
+ * @self: a GX Connection
+ * @cookie: a new GX Cookie
+ *
+ * This registers a new cookie with a connection so that a reply corresponding
+ * to that cookie can trigger a signal to the user.
+ *
+ * Typically you wouldn't have to do this yourself since any cookies you get
+ * back from auto generated GX APIs will already be registered with your
+ * connection.
+ *
+ * This function takes a reference on the cookie, which means that developers
+ * shouldn't normally need to worry about managing the ref count of cookies.
+ *
+ * The cookie will be unref'd when it is unregistered from the connection,
+ * which automatically happens via the gx_*_reply() functions. Cookies for
+ * requests without a reply are also unregistered as soon as the request
+ * is known to have succeeded, so take a reference if you want to call
+ * their gx_*_reply() function after returning to the mainloop.
+ */
+void
+gx_connection_register_cookie (GXConnection *self, GXCookie *cookie)
+{
+  g_object_ref_sink (cookie);
+
+  /* If developers manually unref a cookie, instead of calling
+   * gx_connection_unregister_cookie, then we will be notified, and all will
+   * be well.
+   *
+   * NB: We depend on the behaviour within gx_*_reply() functions.
+   * It's slightly slimpler than calling gx_connection_unregister_cookie
+   * because the weak pointer callbacks know which priv queue the
+   * cookie is currently in. */
+
+  g_object_weak_ref (G_OBJECT (cookie),
+		     cookie_pending_finalized_notify,
+		     self);
+  cookie_table_insert (&self->priv->pending_reply_cookies, cookie);
+  self->priv->stats.pending_cookies_high_water =
+    MAX (self->priv->stats.pending_cookies_high_water,
+	 self->priv->pending_reply_cookies.n_cookies);
+}
+
+/**
+ * gx_connection_unregister_cookie:
+ * @self: a GX Connection
+ * @cookie: a new GX Cookie
+ *
+ * After calling this function the GXConnection will no longer be able to
+ * cause a signal based notification of a reply for the coresponding cookie.
+ *
+ * As with gx_connection_register_cookie, developers shouldn't normally need
+ * to use this directly since cookies are automatically unregistered via the
+ * gx_*_reply() functions.
+ */
+void
+gx_connection_unregister_cookie (GXConnection *self, GXCookie *cookie)
+{
+  if (cookie_table_remove (&self->priv->pending_reply_cookies, cookie))
+    g_object_weak_unref (G_OBJECT (cookie),
+			 cookie_pending_finalized_notify,
+			 self);
+  else if (_gx_cookie_get_registration (cookie)->zombie_link)
+    {
+      zombie_cookies_remove (self, cookie);
+      g_object_weak_unref (G_OBJECT (cookie),
+			   cookie_zombie_finalized_notify,
+			   self);
+    }
+  else
+    {
+      /* NB: The cookie has already been unregistered, e.g. because its
+       * reply was reaped before it was claimed */
+      return;
+    }
+  g_object_unref (cookie);
+}
+
+/* Called by gx_cookie_forget () */
+void
+_gx_connection_forget_cookie (GXConnection *self, GXCookie *cookie)
+{
+  GXCookieRegistration *registration = _gx_cookie_get_registration (cookie);
+
+  registration->forget = TRUE;
+
+  /* If the reply has already been delivered there's nothing left to
+   * wait for. Otherwise it's unregistered once delivered. */
+  if (registration->zombie_link && !registration->queued_response)
+    gx_connection_unregister_cookie (self, cookie);
+}
+
+/* Unregisters the oldest zombie cookies while there are more than
+ * max_unclaimed_replies of them, or while their replies have been
+ * waiting to be claimed for longer than unclaimed_reply_ttl. Unless
+ * someone else holds a reference the cookie and its reply are then
+ * freed. */
+static void
+reap_zombie_cookies (GXConnection *self)
+{
+  GXConnectionPrivate *priv = self->priv;
+  gint64 ttl = (gint64)priv->unclaimed_reply_ttl * 1000;
+  gint64 now = ttl ? _gx_connection_timestamp () : 0;
+  GXCookie *cookie;
+
+  while ((cookie = g_queue_peek_head (priv->zombie_reply_cookies)))
+    {
+      GXCookieRegistration *registration =
+	_gx_cookie_get_registration (cookie);
+
+      /* NB: Responses are delivered in the order they arrive, so if
+       * this one hasn't been delivered yet then none of the following
+       * ones have either. */
+      if (registration->queued_response)
+	break;
+
+      if (!(priv->max_unclaimed_replies
+	    && priv->zombie_reply_cookies->length
+	       > priv->max_unclaimed_replies)
+	  && !(ttl && now - registration->reply_time >= ttl))
+	break;
+
+      GX_NOTE (COOKIES, "reaping unclaimed reply for sequence %u",
+	       gx_cookie_get_sequence (cookie));
+      priv->stats.reaped_cookies++;
+      gx_connection_unregister_cookie (self, cookie);
+    }
+}
+
+static gboolean
+reaper_timeout_cb (gpointer data)
+{
+  reap_zombie_cookies (data);
+
+  return TRUE;
+}
+
+static void
+set_unclaimed_reply_ttl (GXConnection *self, guint ttl)
+{
+  GXConnectionPrivate *priv = self->priv;
+
+  if (priv->reaper_id)
+    {
+      g_source_remove (priv->reaper_id);
+      priv->reaper_id = 0;
+    }
+
+  priv->unclaimed_reply_ttl = ttl;
+  if (ttl)
+    {
+      priv->reaper_id = g_timeout_add (ttl, reaper_timeout_cb, self);
+      reap_zombie_cookies (self);
+    }
+}
+
+/**
+ * gx_connection_get_default_screen:
+ * self: A connection object
+ *
+ * Returns a new reference to the default screen object.
+ */
+GXScreen *
+gx_connection_get_default_screen (GXConnection *self)
+{
+  GXScreen *screen = get_screen (self, self->priv->preferred_screen_num);
+
+  g_return_val_if_fail (screen != NULL, NULL);
+
+  return g_object_ref (screen);
+}
+
+/**
+ * gx_connection_get_n_screens:
+ * self: A connection object
+ *
+ * Returns the number of screens available.
+ */
+guint
+gx_connection_get_n_screens (GXConnection *self)
+{
+  return self->priv->n_screens;
+}
+
+/**
+ * gx_connection_get_screen:
+ * self: A connection object
+ * number: A screen number
+ *
+ * Returns a new reference to the screen object for the given screen
+ * number, or %NULL if there is no such screen. Unlike
+ * gx_connection_get_screens () this only creates the one screen
+ * object.
+ */
+GXScreen *
+gx_connection_get_screen (GXConnection *self, guint number)
+{
+  GXScreen *screen = get_screen (self, number);
+
+  return screen ? g_object_ref (screen) : NULL;
+}
+
+/**
+ * gx_connection_get_screens:
+ * self: A connection object
+ *
+ * Returns a GList of all the screens available, in order of screen
+ * number. The list and the screens are owned by the connection and are
+ * only created on the first call, so the list must not be modified or
+ * freed and the screens must be referenced if you want to keep them.
+ */
+const GList *
+gx_connection_get_screens (GXConnection *self)
+{
+  guint i;
+
+  if (!self->priv->screens_list)
+    for (i = self->priv->n_screens; i > 0; i--)
+      self->priv->screens_list = g_list_prepend (self->priv->screens_list,
+						 get_screen (self, i - 1));
+
+  return self->priv->screens_list;
+}
+
+/**
+ * gx_connection_get_default_root:
+ * self: A connection object
+ *
+ * Returns a new reference to the root window of the default screen
+ */
+GXWindow *
+gx_connection_get_default_root (GXConnection *self)
+{
+  GXScreen *screen = gx_connection_get_default_screen(self);
+  GXWindow *root;
+
+  g_return_val_if_fail (screen != NULL, NULL);
+
+  root = gx_screen_get_root (screen);
+  g_object_unref (screen);
+  return root;
+}
+
+/* Takes ownership of name */
+static const char *
+atom_cache_insert (GXConnection *self, char *name, xcb_atom_t atom)
+{
+  const char *cached_name =
+    g_hash_table_lookup (self->priv->atom_names, GUINT_TO_POINTER (atom));
+
+  if (cached_name)
+    {
+      g_free (name);
+      return cached_name;
+    }
+
+  g_hash_table_insert (self->priv->atom_names, GUINT_TO_POINTER (atom), name);
+  g_hash_table_insert (self->priv->atoms, name, GUINT_TO_POINTER (atom));
+  return name;
+}
+
+/**
+ * gx_connection_lookup_atoms:
+ * @self: A connection object
+ * @names: An array of atom names
+ * @n_names: The number of names
+ * @only_if_exists: Whether to avoid creating atoms that don't exist yet
+ * @atoms: An array of @n_names atoms to fill in
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Looks up the atoms for all the given names. Any atoms that aren't
+ * already cached by the connection are interned with a pipelined batch
+ * of InternAtom requests, so this costs at most one round trip to the
+ * server however many names are given.
+ *
+ * If @only_if_exists is %TRUE, any atoms that don't exist will be
+ * XCB_ATOM_NONE.
+ *
+ * Returns: %FALSE if an error occurred, in which case any atoms that
+ * couldn't be looked up will be XCB_ATOM_NONE.
+ */
+gboolean
+gx_connection_lookup_atoms (GXConnection *self,
+			    const char * const *names,
+			    int n_names,
+			    gboolean only_if_exists,
+			    xcb_atom_t *atoms,
+			    GError **error)
+{
+  GXLightCookie **cookies;
+  gboolean ret = TRUE;
+  int i;
+
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (!gx_connection_check_error (self, error))
+    return FALSE;
+
+  cookies = g_new0 (GXLightCookie *, n_names);
+
+  for (i = 0; i < n_names; i++)
+    {
+      atoms[i] = GPOINTER_TO_UINT (g_hash_table_lookup (self->priv->atoms,
+							names[i]));
+      if (atoms[i] == XCB_ATOM_NONE)
+	cookies[i] = gx_connection_intern_atom_async_light (self,
+							     only_if_exists,
+							     strlen (names[i]),
+							     names[i]);
+    }
+
+  /* NB: We always claim every reply so the light cookies get freed,
+   * even once we've hit an error */
+  for (i = 0; i < n_names; i++)
+    {
+      GXConnectionInternAtomReply *reply;
+
+      if (!cookies[i])
+	continue;
+
+      reply = gx_connection_intern_atom_reply_light (cookies[i],
+						     ret ? error : NULL);
+      if (!reply)
+	{
+	  ret = FALSE;
+	  continue;
+	}
+
+      atoms[i] = reply->x11_reply->atom;
+      /* NB: we don't cache the absence of an atom since another client
+       * may create it later. */
+      if (atoms[i] != XCB_ATOM_NONE)
+	atom_cache_insert (self, g_strdup (names[i]), atoms[i]);
+
+      gx_connection_intern_atom_reply_free (reply);
+    }
+
+  g_free (cookies);
+
+  return ret;
+}
+
+/**
+ * gx_connection_lookup_atom:
+ * @self: A connection object
+ * @name: An atom name
+ * @only_if_exists: Whether to avoid creating the atom if it doesn't
+ *		    exist yet
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Looks up the atom for the given name, only making a round trip to
+ * the server if the atom isn't already cached. To look up several atoms
+ * at once use gx_connection_lookup_atoms ().
+ *
+ * Returns: The atom, or XCB_ATOM_NONE if it doesn't exist or an error
+ * occurred.
+ */
+xcb_atom_t
+gx_connection_lookup_atom (GXConnection *self,
+			   const char *name,
+			   gboolean only_if_exists,
+			   GError **error)
+{
+  xcb_atom_t atom;
+
+  gx_connection_lookup_atoms (self, &name, 1, only_if_exists, &atom, error);
+  return atom;
+}
+
+/**
+ * gx_connection_lookup_atom_name:
+ * @self: A connection object
+ * @atom: An atom
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Looks up the name of the given atom, only making a round trip to the
+ * server if the name isn't already cached.
+ *
+ * Returns: The name of the atom, owned by the connection, or %NULL if
+ * an error occurred.
+ */
+const char *
+gx_connection_lookup_atom_name (GXConnection *self,
+				xcb_atom_t atom,
+				GError **error)
+{
+  GXConnectionGetAtomNameReply *reply;
+  const char *name;
+  const char *cached_name;
+  int name_len;
+
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  cached_name =
+    g_hash_table_lookup (self->priv->atom_names, GUINT_TO_POINTER (atom));
+  if (cached_name)
+    return cached_name;
+
+  if (!gx_connection_check_error (self, error))
+    return NULL;
+
+  reply = gx_connection_get_atom_name (self, atom, error);
+  if (!reply)
+    return NULL;
+
+  name = gx_connection_get_atom_name_peek_name (reply, &name_len);
+  cached_name = atom_cache_insert (self, g_strndup (name, name_len), atom);
+
+  gx_connection_get_atom_name_reply_free (reply);
+
+  return cached_name;
+}
+
+/* The request argument of an InternAtom or GetAtomName request made via
+ * a GXCookie, needed to cache the reply. */
+typedef struct
+{
+  char	     *name;
+  xcb_atom_t  atom;
+} AtomRequest;
+
+static GQuark
+atom_request_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (!quark)
+    quark = g_quark_from_static_string ("gx-atom-request");
+  return quark;
+}
+
+static void
+atom_request_free (AtomRequest *atom_request)
+{
+  g_free (atom_request->name);
+  g_slice_free (AtomRequest, atom_request);
+}
+
+/* Used by the generated InternAtom and GetAtomName code to add the
+ * atom and name from a reply to the cache. A @name_len of -1 means
+ * @name is nul terminated. If @cookie is given then whichever of @name
+ * or @atom is missing (NULL or XCB_ATOM_NONE) is taken from the request
+ * arguments saved by _gx_connection_save_atom_request (). */
+void
+_gx_connection_cache_atom (GXConnection *self,
+			   GXCookie *cookie,
+			   const char *name,
+			   int name_len,
+			   xcb_atom_t atom)
+{
+  if (cookie)
+    {
+      AtomRequest *atom_request =
+	g_object_get_qdata (G_OBJECT (cookie), atom_request_quark ());
+
+      /* NB: GXCookies created for a GXLightCookie don't have the
+       * request arguments */
+      if (!atom_request)
+	return;
+
+      if (!name)
+	name = atom_request->name;
+      if (atom == XCB_ATOM_NONE)
+	atom = atom_request->atom;
+    }
+
+  /* NB: we don't cache the absence of an atom since another client
+   * may create it later. */
+  if (!name || atom == XCB_ATOM_NONE)
+    return;
+
+  if (name_len < 0)
+    name_len = strlen (name);
+
+  atom_cache_insert (self, g_strndup (name, name_len), atom);
+}
+
+/* Used by the generated gx_connection_intern_atom_async () and
+ * gx_connection_get_atom_name_async () functions to keep the request
+ * argument with the cookie until the reply arrives */
+void
+_gx_connection_save_atom_request (GXCookie *cookie,
+				  const char *name,
+				  int name_len,
+				  xcb_atom_t atom)
+{
+  AtomRequest *atom_request = g_slice_new (AtomRequest);
+
+  atom_request->name = name ? g_strndup (name, name_len) : NULL;
+  atom_request->atom = atom;
+  g_object_set_qdata_full (G_OBJECT (cookie), atom_request_quark (),
+			   atom_request,
+			   (GDestroyNotify) atom_request_free);
+}
+
+/* NB: This is used by the generated gx_*_async_light () functions so
+ * it needs to be as cheap as possible. */
+GXLightCookie *
+_gx_connection_new_light_cookie (GXConnection *self,
+				 GXCookieType type,
+				 unsigned int sequence)
+{
+  GXConnectionPrivate *priv = self->priv;
+  GXLightCookie *light_cookie;
+
+  if (G_UNLIKELY (!priv->free_light_cookies))
+    {
+      GXLightCookie *slab = g_new (GXLightCookie, GX_LIGHT_COOKIE_SLAB_SIZE);
+      int i;
+
+      for (i = 0; i < GX_LIGHT_COOKIE_SLAB_SIZE; i++)
+	{
+	  slab[i].connection = NULL;
+	  slab[i].next_free = &slab[i + 1];
+	}
+      slab[i - 1].next_free = NULL;
+
+      priv->light_cookie_slabs =
+	g_slist_prepend (priv->light_cookie_slabs, slab);
+      priv->free_light_cookies = slab;
+    }
+
+  light_cookie = priv->free_light_cookies;
+  priv->free_light_cookies = light_cookie->next_free;
+
+  light_cookie->connection = self;
+  light_cookie->type = type;
+  light_cookie->sequence = sequence;
+  light_cookie->issue_time = _gx_connection_timestamp ();
+  light_cookie->object = NULL;
+  light_cookie->next_free = NULL;
+
+  return light_cookie;
+}
+
+/* Returns a light cookie to the free list. Unless the reply has been
+ * claimed it's discarded, since XCB would otherwise keep it until the
+ * connection is closed.
+ *
+ * NB: Light cookies on the free list have no connection, which is how
+ * free_unclaimed_light_cookies () finds those still in use. */
+void
+_gx_connection_free_light_cookie (GXLightCookie *light_cookie,
+				  gboolean claimed)
+{
+  GXConnectionPrivate *priv = light_cookie->connection->priv;
+
+  if (light_cookie->object)
+    {
+      if (!claimed)
+	gx_cookie_forget (light_cookie->object);
+      g_object_unref (light_cookie->object);
+      light_cookie->object = NULL;
+    }
+  else if (!claimed)
+    xcb_discard_reply (priv->xcb_connection, light_cookie->sequence);
+
+  light_cookie->connection = NULL;
+  light_cookie->next_free = priv->free_light_cookies;
+  priv->free_light_cookies = light_cookie;
+}
+
+static void
+free_unclaimed_light_cookies (GXConnection *self)
+{
+  GSList *l;
+  int i;
+
+  for (l = self->priv->light_cookie_slabs; l; l = l->next)
+    {
+      GXLightCookie *slab = l->data;
+
+      for (i = 0; i < GX_LIGHT_COOKIE_SLAB_SIZE; i++)
+	if (slab[i].connection)
+	  _gx_connection_free_light_cookie (&slab[i], FALSE);
+    }
+}
+
+/* NB: The registry doesn't take a reference on the objects, so objects
+ * must unregister themselves when finalized. */
+void
+_gx_connection_register_xid_object (GXConnection *self,
+				    guint32 xid,
+				    GObject *object)
+{
+  xid_registry_insert (&self->priv->xid_registry, xid, object);
+}
+
+void
+_gx_connection_unregister_xid_object (GXConnection *self,
+				      guint32 xid,
+				      GObject *object)
+{
+  xid_registry_remove (&self->priv->xid_registry, xid, object);
+}
+
+/* Returns the object registered for the given xid (without taking a
+ * reference) or NULL */
+GObject *
+_gx_connection_lookup_xid_object (GXConnection *self, guint32 xid)
+{
+  return xid_registry_lookup (&self->priv->xid_registry, xid);
+}
+
+void
+_gx_xid_iter_init (GXXIDIter *iter,
+		   GXConnection *connection,
+		   GType type,
+		   const guint32 *xids,
+		   int n_xids)
+{
+  iter->connection = connection;
+  iter->type = type;
+  iter->xids = xids;
+  iter->remaining = n_xids;
+}
+
+/**
+ * gx_xid_iter_next:
+ * @iter: An initialized GXXIDIter
+ *
+ * Returns a new reference to the object for the next XID, wrapping the
+ * XID in a new object if one isn't already registered with the
+ * connection, or NULL once all the XIDs have been returned.
+ *
+ * NB: The iterator doesn't hold a reference on the connection, so the
+ * connection must outlive it.
+ */
+gpointer
+gx_xid_iter_next (GXXIDIter *iter)
+{
+  GObject *object;
+  guint32 xid;
+
+  if (iter->remaining <= 0)
+    return NULL;
+
+  xid = *iter->xids++;
+  iter->remaining--;
+
+  object = _gx_connection_lookup_xid_object (iter->connection, xid);
+  if (object && G_TYPE_CHECK_INSTANCE_TYPE (object, iter->type))
+    return g_object_ref (object);
+
+  return g_object_new (iter->type,
+		       "connection", iter->connection,
+		       "xid", xid,
+		       "wrap", TRUE,
+		       NULL);
+}
@@ -26,6 +26,7 @@
 
 #include <glib.h>
 #include <glib-object.h>
+#include <gio/gio.h>
 
 //#include <gx/gx-cookie.h>
 //#include <gx/gx-gcontext.h>
@@ -80,30 +81,240 @@ typedef struct _GXCookie GXCookie;
 #endif
 #endif
 
+#define GX_CONNECTION_ERROR gx_connection_error_quark ()
+
+/* NB: These match the XCB_CONN_* codes returned by
+ * xcb_connection_has_error () */
+typedef enum
+{
+  GX_CONNECTION_ERROR_FAILED = 1,
+  GX_CONNECTION_ERROR_EXT_NOTSUPPORTED = 2,
+  GX_CONNECTION_ERROR_MEM_INSUFFICIENT = 3,
+  GX_CONNECTION_ERROR_REQ_LEN_EXCEED = 4,
+  GX_CONNECTION_ERROR_PARSE_ERR = 5,
+  GX_CONNECTION_ERROR_INVALID_SCREEN = 6
+} GXConnectionError;
+
+GQuark gx_connection_error_quark (void);
+
 GType gx_connection_get_type(void);
 
 GXConnection *gx_connection_new (const char *display);
 
+void
+gx_connection_new_async (const char *display,
+			 GCancellable *cancellable,
+			 GAsyncReadyCallback callback,
+			 gpointer user_data);
+GXConnection *
+gx_connection_new_finish (GAsyncResult *result, GError **error);
+
 xcb_connection_t *
 gx_connection_get_xcb_connection (GXConnection *connection);
 
 void
 gx_connection_flush (GXConnection *connection, gboolean flush_server);
 
+typedef void (*GXConnectionEventFunc) (GXConnection *connection,
+				       GXGenericEvent *event,
+				       gpointer user_data);
+
+guint
+gx_connection_add_event_handler (GXConnection *self,
+				 const GXEventCodeSet *codes,
+				 GXConnectionEventFunc func,
+				 gpointer user_data,
+				 GDestroyNotify notify);
+
+void
+gx_connection_remove_event_handler (GXConnection *self, guint id);
+
+void
+gx_connection_begin_batch (GXConnection *self);
+void
+gx_connection_end_batch (GXConnection *self);
+
+guint
+gx_connection_get_queued_requests (GXConnection *self);
+gsize
+gx_connection_get_queued_bytes (GXConnection *self);
+
+guint32
+gx_connection_get_maximum_request_length (GXConnection *self);
+
+gboolean
+gx_connection_lookup_atoms (GXConnection *self,
+			    const char * const *names,
+			    int n_names,
+			    gboolean only_if_exists,
+			    xcb_atom_t *atoms,
+			    GError **error);
+xcb_atom_t
+gx_connection_lookup_atom (GXConnection *self,
+			   const char *name,
+			   gboolean only_if_exists,
+			   GError **error);
+const char *
+gx_connection_lookup_atom_name (GXConnection *self,
+				xcb_atom_t atom,
+				GError **error);
+void
+_gx_connection_cache_atom (GXConnection *self,
+			   GXCookie *cookie,
+			   const char *name,
+			   int name_len,
+			   xcb_atom_t atom);
+void
+_gx_connection_save_atom_request (GXCookie *cookie,
+				  const char *name,
+				  int name_len,
+				  xcb_atom_t atom);
+
+guint32
+_gx_connection_get_max_request_items (GXConnection *self,
+				      gsize header_size,
+				      gsize item_size);
+void
+_gx_connection_set_request_too_large_error (GError **error);
+
+xcb_point_t *
+_gx_points_to_absolute (const xcb_point_t *points, guint32 n_points);
+
+void
+_gx_connection_request_queued (GXConnection *self, gsize bytes);
+void
+_gx_connection_requests_flushed (GXConnection *self);
+void
+_gx_connection_flush_for_reply (GXConnection *self);
+
 gboolean
 gx_connection_has_error (GXConnection *self);
+gboolean
+gx_connection_check_error (GXConnection *self, GError **error);
+
+gdouble
+gx_connection_get_connect_time (GXConnection *self);
+gdouble
+gx_connection_get_setup_time (GXConnection *self);
+
+/* Request -> reply latencies (in microseconds) are recorded in a log
+ * linear histogram: values below GX_CONNECTION_LATENCY_SUB_BUCKETS get
+ * a bucket each and every power of two range above that is divided
+ * into GX_CONNECTION_LATENCY_SUB_BUCKETS buckets, which gives ~12%
+ * precision up to about 2 minutes. Longer latencies are counted in the
+ * last bucket. */
+#define GX_CONNECTION_LATENCY_SUB_BUCKETS 8
+#define GX_CONNECTION_N_LATENCY_BUCKETS \
+  (GX_CONNECTION_LATENCY_SUB_BUCKETS * 25)
+
+typedef struct {
+  guint64 requests;
+  /* Replies, including checked requests that completed successfully */
+  guint64 replies;
+  /* Including errors for unchecked requests (See the "protocol-error"
+   * signal) */
+  guint64 errors;
+  guint64 events;
+  guint64 events_by_code[GX_N_EVENT_CODES];
+  guint64 flushes;
+  /* NB: This is based on the same estimate of request sizes as
+   * gx_connection_get_queued_bytes () */
+  guint64 bytes_flushed;
+  /* Cookies unregistered because their replies weren't claimed in time
+   * (See the "max-unclaimed-replies" and "unclaimed-reply-ttl"
+   * properties) */
+  guint64 reaped_cookies;
+
+  /* The current lengths and high-water marks of the connection's
+   * internal queues */
+  guint	  pending_cookies;
+  guint	  pending_cookies_high_water;
+  guint	  zombie_cookies;
+  guint	  zombie_cookies_high_water;
+  guint	  events_queue_length;
+  guint	  events_queue_high_water;
+  guint	  response_queue_length;
+  guint	  response_queue_high_water;
+
+  /* The time from a cookie being created until its reply or error was
+   * read from XCB, in microseconds */
+  guint64 latency_count;
+  guint64 latency_min;
+  guint64 latency_max;
+  guint64 latency_total;
+  guint64 latency_buckets[GX_CONNECTION_N_LATENCY_BUCKETS];
+} GXConnectionStats;
+
+void
+gx_connection_get_stats (GXConnection *self, GXConnectionStats *stats);
+void
+gx_connection_reset_stats (GXConnection *self);
+
+guint64
+gx_connection_stats_get_latency_percentile (const GXConnectionStats *stats,
+					    gdouble percentile);
+void
+gx_connection_stats_get_latency_bucket_range (guint bucket,
+					      guint64 *min,
+					      guint64 *max);
+
+gint64
+_gx_connection_timestamp (void);
+void
+_gx_connection_response_received (GXConnection *self,
+				  gint64 issue_time,
+				  gboolean error);
 
 void
 gx_connection_register_cookie (GXConnection *self, GXCookie *cookie);
 void
 gx_connection_unregister_cookie (GXConnection *self, GXCookie *cookie);
+void
+_gx_connection_forget_cookie (GXConnection *self, GXCookie *cookie);
 
 GXScreen *gx_connection_get_default_screen (GXConnection *self);
 
-GList *gx_connection_get_screens (GXConnection *self);
+guint gx_connection_get_n_screens (GXConnection *self);
+
+GXScreen *gx_connection_get_screen (GXConnection *self, guint number);
+
+const GList *gx_connection_get_screens (GXConnection *self);
 
 GXWindow *gx_connection_get_default_root (GXConnection *self);
 
+void
+_gx_connection_register_xid_object (GXConnection *self,
+				    guint32 xid,
+				    GObject *object);
+void
+_gx_connection_unregister_xid_object (GXConnection *self,
+				      guint32 xid,
+				      GObject *object);
+GObject *
+_gx_connection_lookup_xid_object (GXConnection *self, guint32 xid);
+
+/* Iterates a list of XIDs borrowed from a reply (see the generated
+ * gx_*_<field>_iter_init () functions) and only looks up or wraps
+ * objects as they are requested. The reply and its connection must
+ * outlive the iterator. */
+typedef struct {
+  /*< private > */
+  GXConnection	*connection;
+  GType		 type;
+  const guint32	*xids;
+  int		 remaining;
+} GXXIDIter;
+
+void
+_gx_xid_iter_init (GXXIDIter *iter,
+		   GXConnection *connection,
+		   GType type,
+		   const guint32 *xids,
+		   int n_xids);
+
+gpointer
+gx_xid_iter_next (GXXIDIter *iter);
+
 G_END_DECLS
 
 #endif /* GX_CONNECTION_H */
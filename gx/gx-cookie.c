@@ -26,6 +26,8 @@
 
 #include <gx/gx-cookie.h>
 
+#include <stdlib.h>
+
 #define GX_COOKIE_GET_PRIVATE(object) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((object), GX_TYPE_COOKIE, GXCookiePrivate))
 
@@ -50,6 +52,10 @@ struct _GXCookiePrivate
   GXCookieType	 type;
   GXConnection	*connection;
   unsigned int	 sequence;
+  /* When the request was issued (See _gx_connection_timestamp ()) */
+  gint64	 issue_time;
+
+  GXCookieRegistration registration;
 
   xcb_generic_reply_t *reply;
   xcb_generic_error_t *error;
@@ -251,14 +257,12 @@ gx_cookie_set_property (GObject *object,
       break;
 #endif
     case PROP_CONNECTION:
-      self->priv->connection = g_value_get_object(value);
-      g_object_add_weak_pointer (G_OBJECT (self->priv->connection),
-				 (gpointer *)&self->priv->connection);
-#if 0
-      g_object_weak_ref (self->priv->connection,
-			 connection_finalized_notify,
-			 self);
-#endif
+      /* NB: This is also set (to NULL) when gx_cookie_new () creates a
+       * cookie without passing any construct properties */
+      self->priv->connection = g_value_get_object (value);
+      if (self->priv->connection)
+	g_object_add_weak_pointer (G_OBJECT (self->priv->connection),
+				   (gpointer *)&self->priv->connection);
       break;
     case PROP_TYPE:
       self->priv->type = g_value_get_int (value);
@@ -292,7 +296,7 @@ static void
 gx_cookie_init (GXCookie *self)
 {
   self->priv = GX_COOKIE_GET_PRIVATE (self);
-  /* populate your object here */
+  self->priv->issue_time = _gx_connection_timestamp ();
 }
 
 /* Instantiation wrapper */
@@ -301,20 +305,38 @@ gx_cookie_new (GXConnection *connection,
 	       GXCookieType type,
 	       unsigned int sequence)
 {
-  return GX_COOKIE (g_object_new (gx_cookie_get_type (),
-				  "connection", connection,
-				  "type", type,
-				  "sequence", sequence,
-				  NULL));
+  GXCookie *self;
+
+  /* NB: A cookie is created for every request so we don't pass the
+   * construct properties here, since looking them up by name and
+   * collecting the varargs into GValues is a significant part of the
+   * cost of g_object_new (). GObject still sets their defaults, but
+   * that's cheap. */
+  self = GX_COOKIE (g_object_new (gx_cookie_get_type (), NULL));
+
+  self->priv->connection = connection;
+  g_object_add_weak_pointer (G_OBJECT (connection),
+			     (gpointer *)&self->priv->connection);
+  self->priv->type = type;
+  self->priv->sequence = sequence;
+
+  return self;
 }
 
 /* Instance Destruction */
 void
 gx_cookie_finalize (GObject *object)
 {
-  /* GXCookie *self = GX_COOKIE(object); */
+  GXCookie *self = GX_COOKIE(object);
+
+  if (self->priv->connection)
+    g_object_remove_weak_pointer (G_OBJECT (self->priv->connection),
+				  (gpointer *)&self->priv->connection);
+
+  /* NB: The reply or error is only still set if it was never claimed */
+  free (self->priv->reply);
+  free (self->priv->error);
 
-  /* destruct your object here */
   G_OBJECT_CLASS (gx_cookie_parent_class)->finalize (object);
 }
 
@@ -382,6 +404,47 @@ gx_cookie_get_sequence (GXCookie *self)
   return self->priv->sequence;
 }
 
+gint64
+_gx_cookie_get_issue_time (GXCookie *self)
+{
+  return self->priv->issue_time;
+}
+
+void
+_gx_cookie_set_issue_time (GXCookie *self, gint64 issue_time)
+{
+  self->priv->issue_time = issue_time;
+}
+
+GXCookieRegistration *
+_gx_cookie_get_registration (GXCookie *self)
+{
+  return &self->priv->registration;
+}
+
+/**
+ * gx_cookie_forget:
+ * @self: a cookie
+ *
+ * Says that the reply for this cookie will never be claimed. The reply
+ * or error is still delivered to the cookie when it arrives, so the
+ * "reply" and "error" signals can still be used to find out when the
+ * request completed, but straight afterwards the connection drops its
+ * reference to the cookie and the reply is freed. If the reply has
+ * already arrived that happens immediately.
+ *
+ * Note: unless you hold your own reference, the cookie may be
+ * finalized as soon as this returns.
+ */
+void
+gx_cookie_forget (GXCookie *self)
+{
+  g_return_if_fail (GX_IS_COOKIE (self));
+
+  if (self->priv->connection)
+    _gx_connection_forget_cookie (self->priv->connection, self);
+}
+
 /**
  * gx_cookie_get_connection:
  * @self: a cookie
@@ -408,6 +471,9 @@ gx_cookie_get_connection (GXCookie *self)
  * when requesting the reply for the cookie. Normally you wouldn't use this
  * directly, since the connection object can asynchronously set the reply
  * data as soon as the data is available from the server.
+ *
+ * The cookie takes ownership of the reply, which must have been
+ * allocated with malloc (), and frees it if it's never claimed.
  */
 void
 gx_cookie_set_reply (GXCookie *self, xcb_generic_reply_t *reply)
@@ -429,6 +495,17 @@ gx_cookie_get_reply (GXCookie *self)
   return self->priv->reply;
 }
 
+/* Used by the generated gx_*_reply () functions to take ownership of
+ * any reply delivered to the cookie */
+xcb_generic_reply_t *
+_gx_cookie_steal_reply (GXCookie *self)
+{
+  xcb_generic_reply_t *reply = self->priv->reply;
+
+  self->priv->reply = NULL;
+  return reply;
+}
+
 /**
  * gx_cookie_set_error:
  * @self: a cookie
@@ -458,3 +535,129 @@ gx_cookie_get_error (GXCookie *self)
   return self->priv->error;
 }
 
+xcb_generic_error_t *
+_gx_cookie_steal_error (GXCookie *self)
+{
+  xcb_generic_error_t *error = self->priv->error;
+
+  self->priv->error = NULL;
+  return error;
+}
+
+/**
+ * _gx_reply_new:
+ * @connection: The connection the reply was recieved from
+ * @x11_reply: A reply returned by XCB
+ *
+ * This is used by the generated gx_*_reply () functions to create the
+ * GX*Reply structs that are handed to the user.
+ *
+ * Instead of allocating the struct separately, we extend the reply
+ * buffer returned by XCB and place the struct after the reply data so
+ * each reply only needs one allocation and stays contiguous in memory.
+ * The extra space typically fits in the slack of the original malloc ()
+ * chunk so the realloc () doesn't need to move anything.
+ *
+ * Returns: A pointer to the reply struct, or NULL if @x11_reply is NULL
+ */
+gpointer
+_gx_reply_new (GXConnection *connection, GXGenericReply *x11_reply)
+{
+  size_t offset;
+  guint8 *buffer;
+  GXReplyHeader *header;
+
+  if (!x11_reply)
+    return NULL;
+
+  offset = 32 + x11_reply->length * 4;
+  offset = (offset + sizeof (gpointer) - 1) & ~(sizeof (gpointer) - 1);
+
+  /* NB: the buffer was allocated by XCB using malloc () */
+  buffer = realloc (x11_reply, offset + sizeof (GXReplyHeader));
+  if (!buffer)
+    g_error ("Failed to allocate %lu bytes for reply",
+	     (unsigned long)(offset + sizeof (GXReplyHeader)));
+
+  header = (GXReplyHeader *)(buffer + offset);
+  header->connection = connection;
+  header->x11_reply = (GXGenericReply *)buffer;
+
+  return header;
+}
+
+/**
+ * _gx_reply_free:
+ * @reply: A reply struct returned by _gx_reply_new ()
+ *
+ * Frees the reply struct along with the x11 reply that it's embedded in.
+ */
+void
+_gx_reply_free (gpointer reply)
+{
+  GXReplyHeader *header = reply;
+
+  free (header->x11_reply);
+}
+
+/**
+ * gx_light_cookie_get_sequence:
+ * @light_cookie: a light cookie
+ *
+ * Returns the sequence number of the request corresponding to the
+ * light cookie.
+ */
+unsigned int
+gx_light_cookie_get_sequence (GXLightCookie *light_cookie)
+{
+  return light_cookie->sequence;
+}
+
+/**
+ * gx_light_cookie_get_cookie:
+ * @light_cookie: a light cookie
+ *
+ * Returns a GXCookie object corresponding to the light cookie, creating
+ * and registering it with the connection the first time this is called.
+ * This lets you connect to the cookie's signals for an asynchronous
+ * notification of the reply; it is still claimed via the corresponding
+ * gx_*_reply_light () function.
+ *
+ * Note: the cookie is owned by the light cookie until its reply is
+ * claimed, so it isn't ref'd before being returned.
+ */
+GXCookie *
+gx_light_cookie_get_cookie (GXLightCookie *light_cookie)
+{
+  if (!light_cookie->object)
+    {
+      light_cookie->object = gx_cookie_new (light_cookie->connection,
+					    light_cookie->type,
+					    light_cookie->sequence);
+      _gx_cookie_set_issue_time (light_cookie->object,
+				 light_cookie->issue_time);
+      gx_connection_register_cookie (light_cookie->connection,
+				     light_cookie->object);
+
+      /* NB: The connection may unregister the cookie before the reply
+       * is claimed (e.g. if it's reaped) so we keep our own reference */
+      g_object_ref (light_cookie->object);
+    }
+
+  return light_cookie->object;
+}
+
+/**
+ * gx_light_cookie_forget:
+ * @light_cookie: a light cookie
+ *
+ * Frees a light cookie whose reply will never be claimed. The reply (or
+ * error) is thrown away as soon as it arrives, instead of being kept by
+ * XCB until the connection is closed.
+ */
+void
+gx_light_cookie_forget (GXLightCookie *light_cookie)
+{
+  _gx_connection_free_light_cookie (light_cookie, FALSE);
+}
+
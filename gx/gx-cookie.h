@@ -76,6 +76,53 @@ GType gx_cookie_get_type(void);
 
 #include <gx/generated-code/gx-cookie-gen.h>
 
+/**
+ * GXLightCookie:
+ *
+ * A light weight alternative to a GXCookie object returned by the
+ * gx_*_async_light () functions, for code issuing lots of requests.
+ * They are allocated from a per-connection free list and must be
+ * claimed via the corresponding gx_*_reply_light () function, which
+ * frees them. If you decide you no longer want the reply, pass the
+ * cookie to gx_light_cookie_forget () instead.
+ *
+ * A GXCookie object (e.g. for connecting to the "reply" signal) is
+ * only created if you ask for one via gx_light_cookie_get_cookie ().
+ *
+ * If you never need the reply, use the gx_*_discard () functions
+ * instead, which don't need a cookie at all.
+ */
+typedef struct _GXLightCookie GXLightCookie;
+
+struct _GXLightCookie
+{
+  /*< private > */
+  GXConnection	*connection;
+  GXCookieType	 type;
+  unsigned int	 sequence;
+  gint64	 issue_time;
+  GXCookie	*object;
+
+  GXLightCookie *next_free;
+};
+
+/* The state a connection keeps for each cookie registered with it,
+ * which is stored in the cookie so it can be found without searching.
+ * (See gx_connection_register_cookie ()) */
+typedef struct _GXCookieRegistration
+{
+  /*< private > */
+  /* The cookie's link in the connection's list of cookies whose reply
+   * has been received but not yet claimed */
+  GList	   *zombie_link;
+  /* The reply or error queued for dispatch to the cookie, if any */
+  gpointer  queued_response;
+  /* When the reply or error was read from XCB */
+  gint64    reply_time;
+  /* Set by gx_cookie_forget () */
+  gboolean  forget;
+} GXCookieRegistration;
+
 GXCookie *gx_cookie_new (GXConnection *connection,
 			 GXCookieType type,
 			 unsigned int sequence);
@@ -86,6 +133,13 @@ GXCookieType gx_cookie_get_cookie_type (GXCookie *self);
 
 unsigned int gx_cookie_get_sequence (GXCookie *self);
 
+gint64 _gx_cookie_get_issue_time (GXCookie *self);
+void _gx_cookie_set_issue_time (GXCookie *self, gint64 issue_time);
+
+GXCookieRegistration *_gx_cookie_get_registration (GXCookie *self);
+
+void gx_cookie_forget (GXCookie *self);
+
 
 GXGenericReply *
 gx_cookie_get_reply (GXCookie *self);
@@ -100,6 +154,44 @@ gx_cookie_get_error (GXCookie *self);
 void
 gx_cookie_set_error (GXCookie *self, xcb_generic_error_t *error);
 
+xcb_generic_reply_t *
+_gx_cookie_steal_reply (GXCookie *self);
+
+xcb_generic_error_t *
+_gx_cookie_steal_error (GXCookie *self);
+
+
+GXLightCookie *
+_gx_connection_new_light_cookie (GXConnection *connection,
+				 GXCookieType type,
+				 unsigned int sequence);
+
+void
+_gx_connection_free_light_cookie (GXLightCookie *light_cookie,
+				  gboolean claimed);
+
+/* All the generated GX*Reply structs begin with this header */
+typedef struct _GXReplyHeader
+{
+  GXConnection	 *connection;
+  GXGenericReply *x11_reply;
+} GXReplyHeader;
+
+gpointer
+_gx_reply_new (GXConnection *connection, GXGenericReply *x11_reply);
+
+void
+_gx_reply_free (gpointer reply);
+
+unsigned int
+gx_light_cookie_get_sequence (GXLightCookie *light_cookie);
+
+GXCookie *
+gx_light_cookie_get_cookie (GXLightCookie *light_cookie);
+
+void
+gx_light_cookie_forget (GXLightCookie *light_cookie);
+
 G_END_DECLS
 
 #endif /* GX_COOKIE_H */
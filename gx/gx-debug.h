@@ -0,0 +1,39 @@
+#ifndef _GX_DEBUG_H_
+#define _GX_DEBUG_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* Categories for the GX_DEBUG environment variable, e.g.
+ *   GX_DEBUG=dispatch:cookies ./my-app
+ * These only have an effect if GX was configured with --enable-trace */
+typedef enum {
+  GX_DEBUG_DISPATCH	= 1 << 0,
+  GX_DEBUG_COOKIES	= 1 << 1,
+  GX_DEBUG_EVENTS	= 1 << 2,
+  GX_DEBUG_ERRORS	= 1 << 3,
+  GX_DEBUG_CONNECTION	= 1 << 4
+} GXDebugFlag;
+
+#ifdef GX_ENABLE_DEBUG
+
+#define GX_NOTE(type, ...)			G_STMT_START {	\
+  if (G_UNLIKELY (_gx_debug_flags & GX_DEBUG_##type))		\
+    g_message ("[" #type "] " G_STRLOC ": " __VA_ARGS__);	\
+							} G_STMT_END
+
+#else /* !GX_ENABLE_DEBUG */
+
+#define GX_NOTE(type, ...)		G_STMT_START { } G_STMT_END
+
+#endif /* GX_ENABLE_DEBUG */
+
+extern guint _gx_debug_flags;
+
+void
+_gx_debug_init (void);
+
+G_END_DECLS
+
+#endif /* _GX_DEBUG_H_ */
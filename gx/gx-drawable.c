@@ -27,10 +27,16 @@
 #include <gx/gx-connection.h>
 #include <gx/gx-gcontext.h>
 #include <gx/gx-protocol-error.h>
+#include <gx/gx-shm-image.h>
+#include <gx/gx-shm-image-private.h>
 
 #include <string.h>
 #include <stdlib.h>
 
+#ifdef GX_HAVE_SHM
+#include <xcb/shm.h>
+#endif
+
 #define GX_DRAWABLE_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), GX_TYPE_DRAWABLE, GXDrawablePrivate))
 
 #if 0
@@ -172,7 +178,10 @@ gx_drawable_set_property (GObject * object,
       break;
 #endif
     case PROP_CONNECTION:
+      /* NB: drawables may outlive their connection */
       self->priv->connection = g_value_get_object (value);
+      g_object_add_weak_pointer (G_OBJECT (self->priv->connection),
+				 (gpointer *)&self->priv->connection);
       break;
     case PROP_XID:
       self->xid = g_value_get_uint (value);
@@ -211,9 +220,12 @@ gx_drawable_new (void)
 void
 gx_drawable_finalize (GObject * object)
 {
-  /* GXDrawable *self = GX_DRAWABLE(object); */
+  GXDrawable *self = GX_DRAWABLE(object);
+
+  if (self->priv->connection)
+    g_object_remove_weak_pointer (G_OBJECT (self->priv->connection),
+				  (gpointer *)&self->priv->connection);
 
-  /* destruct your object here */
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -226,6 +238,220 @@ gx_drawable_get_xid (GXDrawable * self)
 GXConnection *
 gx_drawable_get_connection (GXDrawable *self)
 {
-  return g_object_ref (self->priv->connection);
+  /* This may return NULL if the connection has been destroyed */
+  return self->priv->connection ? g_object_ref (self->priv->connection) : NULL;
 }
 
+/**
+ * gx_drawable_put_shm_image:
+ * @self: The destination drawable
+ * @gcontext: The graphics context to draw with
+ * @image: The image to upload
+ * @dst_x: The destination x coordinate
+ * @dst_y: The destination y coordinate
+ *
+ * Draws the whole of @image into @self. Shared images are uploaded with
+ * a single MIT-SHM ShmPutImage request; otherwise the pixel data is sent
+ * via as many PutImage requests as necessary to stay within the
+ * maximum request length.
+ *
+ * gx_shm_image_wait () reports any error caused by the upload, or
+ * BadLength if the image's rows are too long to send at all. When the
+ * data is split across several PutImage requests only the last one is
+ * checked; errors for the others are delivered via the connection's
+ * "protocol-error" signal. NB: call gx_shm_image_wait () before
+ * modifying a shared image again.
+ */
+void
+gx_drawable_put_shm_image (GXDrawable *self,
+			   GXGContext *gcontext,
+			   GXShmImage *image,
+			   gint16 dst_x,
+			   gint16 dst_y)
+{
+  GXConnection *connection;
+  xcb_connection_t *xcb_connection;
+  guint16 width = gx_shm_image_get_width (image);
+  guint16 height = gx_shm_image_get_height (image);
+  guint8 depth = gx_shm_image_get_depth (image);
+  guint stride = gx_shm_image_get_stride (image);
+  guint8 *data = gx_shm_image_get_data (image);
+  xcb_void_cookie_t cookie;
+  guint rows_per_request;
+  guint y;
+
+  g_return_if_fail (GX_IS_DRAWABLE (self));
+  g_return_if_fail (GX_IS_SHM_IMAGE (image));
+
+  connection = gx_drawable_get_connection (self);
+  if (!connection)
+    return;
+  xcb_connection = gx_connection_get_xcb_connection (connection);
+
+#ifdef GX_HAVE_SHM
+  if (gx_shm_image_is_shared (image))
+    {
+      cookie =
+	xcb_shm_put_image_checked (xcb_connection,
+				   self->xid,
+				   gx_gcontext_get_xid (gcontext),
+				   width, height, /* total size */
+				   0, 0, width, height, /* source rectangle */
+				   dst_x, dst_y,
+				   depth,
+				   XCB_IMAGE_FORMAT_Z_PIXMAP,
+				   FALSE, /* send_event */
+				   _gx_shm_image_get_shmseg (image),
+				   0 /* offset */);
+      _gx_shm_image_set_put_cookie (image, cookie);
+      _gx_shm_image_set_busy (image, TRUE);
+      _gx_connection_request_queued (connection,
+				     sizeof (xcb_shm_put_image_request_t));
+      g_object_unref (connection);
+      return;
+    }
+#endif
+
+  rows_per_request =
+    _gx_connection_get_max_request_items (connection,
+					  sizeof (xcb_put_image_request_t),
+					  stride);
+  if (rows_per_request == 0)
+    {
+      _gx_shm_image_set_put_too_large (image);
+      g_object_unref (connection);
+      return;
+    }
+
+  for (y = 0; y < height; y += rows_per_request)
+    {
+      guint rows = MIN (rows_per_request, height - y);
+
+      if (y + rows < height)
+	xcb_put_image (xcb_connection,
+		       XCB_IMAGE_FORMAT_Z_PIXMAP,
+		       self->xid,
+		       gx_gcontext_get_xid (gcontext),
+		       width, rows,
+		       dst_x, dst_y + y,
+		       0, /* left_pad */
+		       depth,
+		       rows * stride,
+		       data + y * stride);
+      else
+	{
+	  cookie = xcb_put_image_checked (xcb_connection,
+					  XCB_IMAGE_FORMAT_Z_PIXMAP,
+					  self->xid,
+					  gx_gcontext_get_xid (gcontext),
+					  width, rows,
+					  dst_x, dst_y + y,
+					  0, /* left_pad */
+					  depth,
+					  rows * stride,
+					  data + y * stride);
+	  _gx_shm_image_set_put_cookie (image, cookie);
+	}
+      _gx_connection_request_queued (connection,
+				     sizeof (xcb_put_image_request_t)
+				     + rows * stride);
+    }
+
+  g_object_unref (connection);
+}
+
+/**
+ * gx_drawable_get_shm_image:
+ * @self: The source drawable
+ * @image: The image to read into
+ * @src_x: The source x coordinate
+ * @src_y: The source y coordinate
+ * @error: A GError return location
+ *
+ * Reads a rectangle the size of @image, starting at (@src_x, @src_y),
+ * from @self into @image. For shared images the server writes the
+ * pixels straight into the shared memory segment.
+ *
+ * Returns: FALSE if there was a protocol error
+ */
+gboolean
+gx_drawable_get_shm_image (GXDrawable *self,
+			   GXShmImage *image,
+			   gint16 src_x,
+			   gint16 src_y,
+			   GError **error)
+{
+  GXConnection *connection;
+  xcb_connection_t *xcb_connection;
+  xcb_generic_error_t *xcb_error = NULL;
+  guint16 width = gx_shm_image_get_width (image);
+  guint16 height = gx_shm_image_get_height (image);
+  gsize size = gx_shm_image_get_stride (image) * height;
+  xcb_get_image_reply_t *reply;
+
+  g_return_val_if_fail (GX_IS_DRAWABLE (self), FALSE);
+  g_return_val_if_fail (GX_IS_SHM_IMAGE (image), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  connection = gx_drawable_get_connection (self);
+  if (!connection)
+    return FALSE;
+  xcb_connection = gx_connection_get_xcb_connection (connection);
+
+#ifdef GX_HAVE_SHM
+  if (gx_shm_image_is_shared (image))
+    {
+      xcb_shm_get_image_reply_t *shm_reply =
+	xcb_shm_get_image_reply (xcb_connection,
+				 xcb_shm_get_image (xcb_connection,
+						    self->xid,
+						    src_x, src_y,
+						    width, height,
+						    ~0, /* plane_mask */
+						    XCB_IMAGE_FORMAT_Z_PIXMAP,
+						    _gx_shm_image_get_shmseg (image),
+						    0 /* offset */),
+				 &xcb_error);
+      free (shm_reply);
+
+      /* NB: The server has now also finished with any earlier puts */
+      _gx_shm_image_set_busy (image, FALSE);
+      _gx_connection_requests_flushed (connection);
+      goto done;
+    }
+#endif
+
+  reply = xcb_get_image_reply (xcb_connection,
+			       xcb_get_image (xcb_connection,
+					      XCB_IMAGE_FORMAT_Z_PIXMAP,
+					      self->xid,
+					      src_x, src_y,
+					      width, height,
+					      ~0 /* plane_mask */),
+			       &xcb_error);
+  _gx_connection_requests_flushed (connection);
+  if (reply)
+    {
+      memcpy (gx_shm_image_get_data (image),
+	      xcb_get_image_data (reply),
+	      MIN (xcb_get_image_data_length (reply), size));
+      free (reply);
+    }
+
+#ifdef GX_HAVE_SHM
+done:
+#endif
+  g_object_unref (connection);
+
+  if (xcb_error)
+    {
+      g_set_error (error,
+		   GX_PROTOCOL_ERROR,
+		   gx_protocol_error_from_xcb_error (xcb_error),
+		   "Protocol Error");
+      free (xcb_error);
+      return FALSE;
+    }
+
+  return TRUE;
+}
@@ -42,8 +42,8 @@ G_BEGIN_DECLS
 #define GX_DRAWABLE(obj)		  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GX_TYPE_DRAWABLE, GXDrawable))
 #define GX_TYPE_DRAWABLE		  (gx_drawable_get_type())
 #define GX_DRAWABLE_CLASS(klass)	  (G_TYPE_CHECK_CLASS_CAST ((klass), GX_TYPE_DRAWABLE, GXDrawableClass))
-#define GX_IS_DRAWABLE(obj)	  (G_TYPE_CHECK_INSTANCE_Type ((obj), GX_TYPE_DRAWABLE))
-#define GX_IS_DRAWABLE_CLASS(klass) (G_TYPE_CHECK_CLASS_Type ((klass), GX_TYPE_DRAWABLE))
+#define GX_IS_DRAWABLE(obj)	  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GX_TYPE_DRAWABLE))
+#define GX_IS_DRAWABLE_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GX_TYPE_DRAWABLE))
 #define GX_DRAWABLE_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GX_TYPE_DRAWABLE, GXDrawableClass))
 
 #ifndef GX_DRAWABLE_TYPEDEF
@@ -85,5 +85,19 @@ guint32 gx_drawable_get_xid (GXDrawable * self);
 
 GXConnection *gx_drawable_get_connection (GXDrawable *self);
 
+void
+gx_drawable_put_shm_image (GXDrawable *self,
+			   GXGContext *gcontext,
+			   GXShmImage *image,
+			   gint16 dst_x,
+			   gint16 dst_y);
+
+gboolean
+gx_drawable_get_shm_image (GXDrawable *self,
+			   GXShmImage *image,
+			   gint16 src_x,
+			   gint16 src_y,
+			   GError **error);
+
 G_END_DECLS
 #endif /* GX_DRAWABLE_H */
@@ -1,51 +1,136 @@
-
 #include <gx/gx-event.h>
 #include <gx/gx-connection.h>
 
 #include <glib.h>
 
-static GHashTable *event_details_hash = NULL;
+#include <string.h>
+
+typedef struct {
+    xcb_extension_t *extension;
+    GXEventDetails  *details;
+} GXEventExtension;
+
+/* The core protocol events, indexed by event code */
+static GXEventDetails *core_event_details[GX_N_EVENT_CODES];
+
+/* The registered extensions, whose event codes can only be resolved
+ * once we have a connection. */
+static GList *event_extensions = NULL;
+
+/* Bumped each time an extension is registered so connections know
+ * to update their event details tables. */
+static guint event_extensions_serial = 1;
 
 void
-gx_event_details_add_extension (GXEventDetails *extension_event_details)
+gx_event_details_add_extension (xcb_extension_t *extension,
+				GXEventDetails *extension_event_details)
 {
   GXEventDetails *details;
 
-  if (!event_details_hash)
-    event_details_hash = g_hash_table_new (g_int_hash, g_int_equal);
-
   for (details = extension_event_details;
-       details->description != NULL;
+       details->protocol_event_code != -1;
        details++)
     {
-      g_hash_table_insert (event_details_hash,
-			   &details->protocol_event_code,
-			   details);
+      /* Skip the gaps in the array */
+      if (!details->description)
+	continue;
+
+      details->detail = g_quark_from_static_string (details->description);
+
+      if (!extension)
+	core_event_details[details->protocol_event_code
+			   & GX_EVENT_CODE_MASK] = details;
+    }
+
+  if (extension)
+    {
+      GXEventExtension *event_extension = g_slice_new (GXEventExtension);
+      event_extension->extension = extension;
+      event_extension->details = extension_event_details;
+      event_extensions = g_list_prepend (event_extensions, event_extension);
+      event_extensions_serial++;
+    }
+}
+
+void
+_gx_event_details_free (void)
+{
+  GList *tmp;
+
+  for (tmp = event_extensions; tmp != NULL; tmp = tmp->next)
+    g_slice_free (GXEventExtension, tmp->data);
+  g_list_free (event_extensions);
+  event_extensions = NULL;
+
+  memset (core_event_details, 0, sizeof (core_event_details));
+}
+
+/* Starts the QueryExtension requests for all registered extensions
+ * without blocking, so that _gx_event_details_update_table () won't
+ * normally need to wait for a round trip. */
+void
+_gx_event_details_prefetch (xcb_connection_t *xcb_connection)
+{
+  GList *tmp;
+
+  for (tmp = event_extensions; tmp != NULL; tmp = tmp->next)
+    {
+      GXEventExtension *event_extension = tmp->data;
+      xcb_prefetch_extension_data (xcb_connection,
+				   event_extension->extension);
     }
 }
 
+/* Fills in a connection's table of event details, indexed by event
+ * code, if any extensions have been registered since the table was
+ * last updated. */
 void
-_gx_event_details_hash_free (void)
+_gx_event_details_update_table (xcb_connection_t *xcb_connection,
+				GXEventDetails **table,
+				guint *serial)
 {
-  if (event_details_hash)
+  GList *tmp;
+
+  if (*serial == event_extensions_serial)
+    return;
+
+  memcpy (table, core_event_details, sizeof (core_event_details));
+
+  for (tmp = event_extensions; tmp != NULL; tmp = tmp->next)
     {
-      g_hash_table_unref (event_details_hash);
-      event_details_hash = NULL;
+      GXEventExtension *event_extension = tmp->data;
+      const xcb_query_extension_reply_t *extension_data;
+      GXEventDetails *details;
+
+      extension_data =
+	xcb_get_extension_data (xcb_connection, event_extension->extension);
+      if (!extension_data || !extension_data->present)
+	continue;
+
+      for (details = event_extension->details;
+	   details->protocol_event_code != -1;
+	   details++)
+	{
+	  int code;
+
+	  if (!details->description)
+	    continue;
+
+	  code = extension_data->first_event + details->protocol_event_code;
+	  if (code < GX_N_EVENT_CODES)
+	    table[code] = details;
+	}
     }
+
+  *serial = event_extensions_serial;
 }
 
 const char *
 gx_event_get_name (GXGenericEvent *event)
 {
   GXEventDetails *details;
-  gint key;
-
-  if (!event_details_hash)
-    return "Unknown event";
 
-  key = event->type;
-  details = g_hash_table_lookup (event_details_hash,
-				 &key);
+  details = core_event_details[event->type & GX_EVENT_CODE_MASK];
   if (details)
     return details->description;
   else
@@ -57,14 +142,8 @@ gx_event_get_window_xid (GXGenericEvent *event)
 {
   GXEventDetails *details;
   guint8 *event_buf = (guint8 *)event;
-  gint key;
 
-  if (!event_details_hash)
-    event_details_hash = g_hash_table_new (g_int_hash, g_int_equal);
-
-  key = event->type;
-  details = g_hash_table_lookup (event_details_hash,
-				 &key);
+  details = core_event_details[event->type & GX_EVENT_CODE_MASK];
   if (!details)
     {
       g_warning ("gx_event_get_window_xid: failed to lookup event details\n");
@@ -82,8 +161,108 @@ gx_event_from_xcb_event (xcb_generic_event_t *event)
 {
   /* We don't want to be too strict in case the client is interacting
    * with funky new extensions with unknown event types... */
-  /* g_assert ( g_hash_table_lookup (event->response_type) ); */
+  /* g_assert ( core_event_details[event->response_type] ); */
 
   return (GXGenericEvent *)event;
 }
 
+void
+gx_event_code_set_clear (GXEventCodeSet *set)
+{
+  memset (set, 0, sizeof (GXEventCodeSet));
+}
+
+void
+gx_event_code_set_add (GXEventCodeSet *set, guint8 code)
+{
+  code &= GX_EVENT_CODE_MASK;
+  set->bits[code >> 5] |= 1U << (code & 31);
+}
+
+void
+gx_event_code_set_remove (GXEventCodeSet *set, guint8 code)
+{
+  code &= GX_EVENT_CODE_MASK;
+  set->bits[code >> 5] &= ~(1U << (code & 31));
+}
+
+/* Direct event handlers are kept in a GHookList so that handlers can
+ * safely be added or removed while events are being dispatched. */
+typedef struct {
+    GHook	    hook;
+    GXEventCodeSet  codes;
+} GXEventHook;
+
+guint
+_gx_event_hooks_add (GHookList **hooks,
+		     const GXEventCodeSet *codes,
+		     _GXEventHookFunc func,
+		     gpointer user_data,
+		     GDestroyNotify notify)
+{
+  GXEventHook *event_hook;
+
+  if (!*hooks)
+    {
+      *hooks = g_new (GHookList, 1);
+      g_hook_list_init (*hooks, sizeof (GXEventHook));
+    }
+
+  event_hook = (GXEventHook *)g_hook_alloc (*hooks);
+  event_hook->hook.func = func;
+  event_hook->hook.data = user_data;
+  event_hook->hook.destroy = notify;
+
+  /* NB: A NULL set of codes selects all events */
+  if (codes)
+    event_hook->codes = *codes;
+  else
+    memset (&event_hook->codes, 0xff, sizeof (GXEventCodeSet));
+
+  g_hook_append (*hooks, &event_hook->hook);
+
+  return event_hook->hook.hook_id;
+}
+
+void
+_gx_event_hooks_remove (GHookList *hooks, guint id)
+{
+  if (!hooks || !g_hook_destroy (hooks, id))
+    g_warning ("No event handler with id %u", id);
+}
+
+void
+_gx_event_hooks_dispatch (GHookList *hooks,
+			  gpointer instance,
+			  GXGenericEvent *event)
+{
+  int code = event->type & GX_EVENT_CODE_MASK;
+  GHook *hook;
+
+  for (hook = g_hook_first_valid (hooks, TRUE);
+       hook;
+       hook = g_hook_next_valid (hooks, hook, TRUE))
+    {
+      GXEventHook *event_hook = (GXEventHook *)hook;
+      gboolean was_in_call;
+
+      if (!GX_EVENT_CODE_SET_CONTAINS (&event_hook->codes, code))
+	continue;
+
+      was_in_call = G_HOOK_IN_CALL (hook);
+      hook->flags |= G_HOOK_FLAG_IN_CALL;
+      ((_GXEventHookFunc)hook->func) (instance, event, hook->data);
+      if (!was_in_call)
+	hook->flags &= ~G_HOOK_FLAG_IN_CALL;
+    }
+}
+
+void
+_gx_event_hooks_free (GHookList *hooks)
+{
+  if (!hooks)
+    return;
+
+  g_hook_list_clear (hooks);
+  g_free (hooks);
+}
@@ -13,19 +13,85 @@ typedef struct _GXGenericEvent {
     guint32 full_sequence;  /**< Full sequence */
 } GXGenericEvent;
 
+/* Event codes are 7 bits; the top bit of an event's type is set if it
+ * was generated via a SendEvent request. */
+#define GX_EVENT_CODE_MASK  0x7f
+#define GX_N_EVENT_CODES    128
+
+/* A set of event codes, used to select which events are delivered to
+ * a handler. (See gx_connection_add_event_handler ()) */
+typedef struct {
+    guint32	bits[GX_N_EVENT_CODES / 32];
+} GXEventCodeSet;
+
+#define GX_EVENT_CODE_SET_CONTAINS(set, code) \
+  (((set)->bits[((code) & GX_EVENT_CODE_MASK) >> 5] >> ((code) & 31)) & 1)
+
+void
+gx_event_code_set_clear (GXEventCodeSet *set);
+
+void
+gx_event_code_set_add (GXEventCodeSet *set, guint8 code);
+
+void
+gx_event_code_set_remove (GXEventCodeSet *set, guint8 code);
+
+/* Event handlers are called directly rather than via GSignal. The
+ * instance is the connection or window the handler was added to. */
+typedef void (*_GXEventHookFunc) (gpointer instance,
+				  GXGenericEvent *event,
+				  gpointer user_data);
+
+guint
+_gx_event_hooks_add (GHookList **hooks,
+		     const GXEventCodeSet *codes,
+		     _GXEventHookFunc func,
+		     gpointer user_data,
+		     GDestroyNotify notify);
+
+void
+_gx_event_hooks_remove (GHookList *hooks, guint id);
+
+void
+_gx_event_hooks_dispatch (GHookList *hooks,
+			  gpointer instance,
+			  GXGenericEvent *event);
+
+void
+_gx_event_hooks_free (GHookList *hooks);
+
 /* FIXME - Should this be made private to the extension libraries? */
 typedef struct {
     int		protocol_event_code;
     const char *description;
     size_t	window_xid_offset;
+
+    /* Set by gx_event_details_add_extension () */
+    GQuark	detail;
 } GXEventDetails;
 
 
+/* NB: gx-gen emits the details arrays indexed by event code (so there
+ * may be gaps with a NULL description) and terminated with an entry
+ * whose protocol_event_code is -1.
+ *
+ * For extensions the event codes are relative to the first_event
+ * reported by QueryExtension, which is resolved per connection. Pass
+ * a NULL extension for the core protocol events. */
+void
+gx_event_details_add_extension (xcb_extension_t *extension,
+				GXEventDetails *extension_event_details);
+
+void
+_gx_event_details_free (void);
+
 void
-gx_event_details_add_extension (GXEventDetails *extension_event_details);
+_gx_event_details_prefetch (xcb_connection_t *xcb_connection);
 
 void
-_gx_event_details_hash_free (void);
+_gx_event_details_update_table (xcb_connection_t *xcb_connection,
+				GXEventDetails **table,
+				guint *serial);
 
 const char *
 gx_event_get_name (GXGenericEvent *event);
@@ -1,5 +1,6 @@
 #include <gx/gx-main.h>
 #include <gx/gx-event.h>
+#include <gx/gx-debug.h>
 
 #include <glib.h>
 #include <glib-object.h>
@@ -8,6 +9,35 @@ extern GXEventDetails _gx_xproto_event_details[];
 
 static GMainLoop *loop;
 
+guint _gx_debug_flags = 0;
+
+#ifdef GX_ENABLE_DEBUG
+static const GDebugKey gx_debug_keys[] = {
+  { "dispatch", GX_DEBUG_DISPATCH },
+  { "cookies", GX_DEBUG_COOKIES },
+  { "events", GX_DEBUG_EVENTS },
+  { "errors", GX_DEBUG_ERRORS },
+  { "connection", GX_DEBUG_CONNECTION }
+};
+#endif
+
+/* Reads the GX_DEBUG environment variable to determine which categories
+ * of GX_NOTE () messages should be printed. */
+void
+_gx_debug_init (void)
+{
+#ifdef GX_ENABLE_DEBUG
+  const char *env_string;
+
+  env_string = g_getenv ("GX_DEBUG");
+  if (env_string != NULL)
+    _gx_debug_flags =
+      g_parse_debug_string (env_string,
+			    gx_debug_keys,
+			    G_N_ELEMENTS (gx_debug_keys));
+#endif
+}
+
 /**
  * gx_init:
  * @argc: Address of the argc parameter of your main() function. Changed
@@ -23,13 +53,19 @@ static GMainLoop *loop;
 void
 gx_init (int *argc, char ***argv)
 {
+  /* NB: gx_connection_new_async () connects in a worker thread */
+  if (!g_thread_supported ())
+    g_thread_init (NULL);
+
   g_type_init ();
 
+  _gx_debug_init ();
+
   /* TODO: parse standard arguments */
 
-  g_atexit (_gx_event_details_hash_free);
+  g_atexit (_gx_event_details_free);
 
-  gx_event_details_add_extension (_gx_xproto_event_details);
+  gx_event_details_add_extension (NULL, _gx_xproto_event_details);
 }
 
 void
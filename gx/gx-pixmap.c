@@ -95,8 +95,6 @@ static GXDrawableClass *parent_class = NULL;
 
 G_DEFINE_TYPE (GXPixmap, gx_pixmap, GX_TYPE_DRAWABLE);
 
-static GHashTable *xid_to_pixmap_map = NULL;
-
 static void
 gx_pixmap_class_init (GXPixmapClass * klass)	/* Class Initialization */
 {
@@ -112,12 +110,6 @@ gx_pixmap_class_init (GXPixmapClass * klass)	/* Class Initialization */
 
   gobject_class->constructor = gx_pixmap_constructor;
 
-  /* FIXME - mutex */
-  if (!xid_to_pixmap_map)
-    {
-      xid_to_pixmap_map = g_hash_table_new (g_direct_hash, g_direct_equal);
-    }
-
   new_param = g_param_spec_boolean("wrap", /* name */
 				   "Wrap",	/* nick name */
 				   "Simply wrap an already existing xid",
@@ -261,9 +253,9 @@ gx_pixmap_constructor (GType type,
   GObject *object;
   GXPixmap *self;
   GXDrawable *drawable;
-  GXConnection *connection;
+  GXConnection *connection = NULL;
   xcb_connection_t *xcb_connection;
-  guint32 xid;
+  guint32 xid = 0;
   gboolean is_wrapping_xid = FALSE;
   int i;
 
@@ -290,17 +282,14 @@ gx_pixmap_constructor (GType type,
 	  GObjectConstructParam *construct_param = &construct_params[i];
 	  GParamSpec *pspec = construct_param->pspec;
 	  if (strcmp (g_param_spec_get_name (pspec), "xid") == 0)
-	    {
-	      xid = g_value_get_uint (construct_param->value);
-	      break;
-	    }
+	    xid = g_value_get_uint (construct_param->value);
+	  else if (strcmp (g_param_spec_get_name (pspec), "connection") == 0)
+	    connection = g_value_get_object (construct_param->value);
 	}
 #warning "Test XID wrapping code!!!"
-      /* FIXME - mutex */
-      existing_pixmap = g_hash_table_lookup (xid_to_pixmap_map,
-					     GUINT_TO_POINTER (xid));
+      existing_pixmap = gx_pixmap_find_from_xid (connection, xid);
       if (existing_pixmap)
-	return g_object_ref (existing_pixmap);
+	return G_OBJECT (existing_pixmap);
     }
 
   object = G_OBJECT_CLASS (parent_class)->constructor (type,
@@ -331,11 +320,10 @@ gx_pixmap_constructor (GType type,
 	 self->priv->height_construct);
     }
 
+  _gx_connection_register_xid_object (connection, drawable->xid, object);
+
   g_object_unref (connection);
 
-  g_hash_table_insert (xid_to_pixmap_map,
-		       GUINT_TO_POINTER (drawable->xid),
-		       object);
   return object;
 }
 
@@ -359,9 +347,16 @@ gx_pixmap_new (GXConnection *connection,
 void
 gx_pixmap_finalize (GObject * object)
 {
-  /* GXPixmap *self = GX_PIXMAP(object); */
+  GXDrawable *drawable = GX_DRAWABLE (object);
+  GXConnection *connection = gx_drawable_get_connection (drawable);
+
+  /* NB: the connection may have already been destroyed */
+  if (connection)
+    {
+      _gx_connection_unregister_xid_object (connection, drawable->xid, object);
+      g_object_unref (connection);
+    }
 
-  /* destruct your object here */
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -371,3 +366,17 @@ gx_pixmap_get_connection (GXPixmap *self)
   return gx_drawable_get_connection (GX_DRAWABLE (self));
 }
 
+/* This does a lookup for an existing GXPixmap that corresponds to the
+ * passed xid on the given connection, and returns a new reference to it
+ * or NULL. */
+GXPixmap *
+gx_pixmap_find_from_xid (GXConnection *connection, guint32 xid)
+{
+  GObject *object;
+
+  g_return_val_if_fail (GX_IS_CONNECTION (connection), NULL);
+
+  object = _gx_connection_lookup_xid_object (connection, xid);
+  return GX_IS_PIXMAP (object) ? g_object_ref (object) : NULL;
+}
+
@@ -81,6 +81,9 @@ gx_pixmap_new (GXConnection *connection,
 
 GXConnection *gx_pixmap_get_connection (GXPixmap *self);
 
+GXPixmap *
+gx_pixmap_find_from_xid (GXConnection *connection, guint32 xid);
+
 G_END_DECLS
 
 #endif /* GX_PIXMAP_H */
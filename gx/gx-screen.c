@@ -26,8 +26,11 @@
 
 #include <gx/gx-screen.h>
 
+#include <gx/gx-connection.h>
 #include <gx/gx-window.h>
 
+#include <stdlib.h>
+
 /* Macros and defines */
 #define GX_SCREEN_GET_PRIVATE(object) \
   (G_TYPE_INSTANCE_GET_PRIVATE ((object), GX_TYPE_SCREEN, GXScreenPrivate))
@@ -63,36 +66,39 @@ enum
 struct _GXScreenPrivate
 {
   guint number;
+
+  /* NB: screens may outlive their connection */
+  GXConnection *connection;
+
+  /* This points into the connection's xcb_setup_t, which is only valid
+   * while the connection is alive. The fixed size part is also copied
+   * into screen so the simple getters don't depend on the connection,
+   * but the lists of depths and visuals are only read via xcb_screen. */
+  const xcb_screen_t *xcb_screen;
+  xcb_screen_t screen;
+
+  /* Only created once requested */
   GXWindow *root;
-  GXColormap default_colormap;
-  guint32 white_pixel;
-  guint32 black_pixel;
-  guint32 current_input_masks;
-  guint16 width_in_pixels;
-  guint16 height_in_pixels;
-  guint16 width_in_millimeters;
-  guint16 height_in_millimeters;
-  guint16 min_installed_maps;
-  guint16 max_installed_maps;
-  GXVisualID root_visual_id;
-  guint8 backing_stores;
-  gboolean save_unders;
-  guint8 root_depth;
-
-  /* TODO: */
-  GList *depths;
+
+  /* All the visuals of all depths sorted by visual ID, along with the
+   * answers to some common queries. These are created the first time
+   * any visual is looked up. (See ensure_visual_index ()) */
+  gboolean visuals_indexed;
+  GXVisualInfo *visuals;
+  guint n_visuals;
+  const GXVisualInfo *root_visual;
+  const GXVisualInfo *argb_visual;
+  const GXVisualInfo *true_color_visual;
 };
 
 
 static void gx_screen_get_property (GObject * object,
 				    guint id,
 				    GValue * value, GParamSpec * pspec);
-static void gx_screen_set_property (GObject * object,
-				    guint property_id,
-				    const GValue * value, GParamSpec * pspec);
 /* static void gx_screen_mydoable_interface_init(gpointer interface,
    gpointer data); */
 static void gx_screen_init (GXScreen * self);
+static void gx_screen_dispose (GObject * self);
 static void gx_screen_finalize (GObject * self);
 
 
@@ -106,10 +112,14 @@ gx_screen_class_init (GXScreenClass * klass)
   GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
   GParamSpec *new_param;
 
+  gobject_class->dispose = gx_screen_dispose;
   gobject_class->finalize = gx_screen_finalize;
 
   gobject_class->get_property = gx_screen_get_property;
-  gobject_class->set_property = gx_screen_set_property;
+
+  /* NB: The properties are all read only since screens are created by
+   * the connection directly from its xcb_setup_t, which avoids
+   * marshalling a GValue for each construct property. */
 
   /* set up properties */
 #if 0
@@ -147,8 +157,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT32, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_NUMBER, new_param);
 
@@ -156,8 +165,7 @@ gx_screen_class_init (GXScreenClass * klass)
 				   "Root Window", /* nick name */
 				   "The root window",
 				   GX_TYPE_WINDOW,
-				   G_PARAM_READWRITE
-				   | G_PARAM_CONSTRUCT_ONLY);
+				   G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_ROOT_WINDOW, new_param);
 
@@ -168,8 +176,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT32, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_DEFAULT_COLORMAP, new_param);
 
@@ -179,8 +186,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT32, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_BLACK, new_param);
 
@@ -190,8 +196,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT32, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_WHITE, new_param);
 
@@ -201,8 +206,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT16, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_WIDTH, new_param);
 
@@ -212,8 +216,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT16, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_HEIGHT, new_param);
 
@@ -223,8 +226,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT16, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_WIDTH_IN_MILLIMETERS, new_param);
 
@@ -234,8 +236,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT16, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_HEIGHT_IN_MILLIMETERS, new_param);
 
@@ -246,8 +247,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT16, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_MIN_INSTALLED_MAPS, new_param);
 
@@ -258,8 +258,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT16, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_MAX_INSTALLED_MAPS, new_param);
 
@@ -269,8 +268,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT32, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_ROOT_VISUALID, new_param);
 
@@ -278,8 +276,7 @@ gx_screen_class_init (GXScreenClass * klass)
 				    "Save Unders", /* nick name */
 				    "TRUE of the screen supports save unders",
 				    FALSE, /* default */
-				    G_PARAM_READWRITE
-				    | G_PARAM_CONSTRUCT_ONLY);
+				    G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_SAVE_UNDERS, new_param);
 
@@ -289,8 +286,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT8, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_ROOT_DEPTH, new_param);
 
@@ -300,8 +296,7 @@ gx_screen_class_init (GXScreenClass * klass)
 			         0, /* minimum */
 			         G_MAXUINT8, /* maximum */
 			         0, /* default */
-			         G_PARAM_READWRITE
-			         | G_PARAM_CONSTRUCT_ONLY);
+			         G_PARAM_READABLE);
   g_object_class_install_property (gobject_class,
 				   PROP_BACKING_STORES, new_param);
 
@@ -331,6 +326,7 @@ gx_screen_get_property (GObject * object,
 			guint id, GValue * value, GParamSpec * pspec)
 {
   GXScreen* self = GX_SCREEN(object);
+  xcb_screen_t *screen = &self->priv->screen;
 
   switch (id)
     {
@@ -338,46 +334,46 @@ gx_screen_get_property (GObject * object,
       g_value_set_uint (value, self->priv->number);
       break;
     case PROP_ROOT_WINDOW:
-      g_value_set_object (value, self->priv->root);
+      g_value_take_object (value, gx_screen_get_root (self));
       break;
     case PROP_DEFAULT_COLORMAP:
-      g_value_set_uint (value, self->priv->default_colormap);
+      g_value_set_uint (value, screen->default_colormap);
       break;
     case PROP_BLACK:
-      g_value_set_uint (value, self->priv->black_pixel);
+      g_value_set_uint (value, screen->black_pixel);
       break;
     case PROP_WHITE:
-      g_value_set_uint (value, self->priv->white_pixel);
+      g_value_set_uint (value, screen->white_pixel);
       break;
     case PROP_WIDTH:
-      g_value_set_uint (value, self->priv->width_in_pixels);
+      g_value_set_uint (value, screen->width_in_pixels);
       break;
     case PROP_HEIGHT:
-      g_value_set_uint (value, self->priv->height_in_pixels);
+      g_value_set_uint (value, screen->height_in_pixels);
       break;
     case PROP_MIN_INSTALLED_MAPS:
-      g_value_set_uint (value, self->priv->min_installed_maps);
+      g_value_set_uint (value, screen->min_installed_maps);
       break;
     case PROP_MAX_INSTALLED_MAPS:
-      g_value_set_uint (value, self->priv->max_installed_maps);
+      g_value_set_uint (value, screen->max_installed_maps);
       break;
     case PROP_WIDTH_IN_MILLIMETERS:
-      g_value_set_uint (value, self->priv->width_in_millimeters);
+      g_value_set_uint (value, screen->width_in_millimeters);
       break;
     case PROP_HEIGHT_IN_MILLIMETERS:
-      g_value_set_uint (value, self->priv->height_in_millimeters);
+      g_value_set_uint (value, screen->height_in_millimeters);
       break;
     case PROP_BACKING_STORES:
-      g_value_set_uint (value, self->priv->backing_stores);
+      g_value_set_uint (value, screen->backing_stores);
       break;
     case PROP_SAVE_UNDERS:
-      g_value_set_boolean (value, self->priv->save_unders);
+      g_value_set_boolean (value, screen->save_unders);
       break;
     case PROP_ROOT_DEPTH:
-      g_value_set_uint (value, self->priv->root_depth);
+      g_value_set_uint (value, screen->root_depth);
       break;
     case PROP_ROOT_VISUALID:
-      g_value_set_uint (value, self->priv->root_visual_id);
+      g_value_set_uint (value, screen->root_visual);
       break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, id, pspec);
@@ -385,67 +381,6 @@ gx_screen_get_property (GObject * object,
     }
 }
 
-static void
-gx_screen_set_property (GObject * object,
-			guint property_id,
-			const GValue * value, GParamSpec * pspec)
-{
-  GXScreen* self = GX_SCREEN(object);
-
-  switch (property_id)
-    {
-    case PROP_NUMBER:
-      self->priv->number = g_value_get_uint (value);
-      break;
-    case PROP_ROOT_WINDOW:
-      self->priv->root = g_value_get_object (value);
-      g_object_ref (self->priv->root);
-      break;
-    case PROP_DEFAULT_COLORMAP:
-      self->priv->default_colormap = g_value_get_uint (value);
-      break;
-    case PROP_BLACK:
-      self->priv->black_pixel = g_value_get_uint (value);
-      break;
-    case PROP_WHITE:
-      self->priv->white_pixel = g_value_get_uint (value);
-      break;
-    case PROP_WIDTH:
-      self->priv->width_in_pixels = g_value_get_uint (value);
-      break;
-    case PROP_HEIGHT:
-      self->priv->height_in_pixels = g_value_get_uint (value);
-      break;
-    case PROP_WIDTH_IN_MILLIMETERS:
-      self->priv->width_in_millimeters = g_value_get_uint (value);
-      break;
-    case PROP_HEIGHT_IN_MILLIMETERS:
-      self->priv->height_in_millimeters = g_value_get_uint (value);
-      break;
-    case PROP_MIN_INSTALLED_MAPS:
-      self->priv->min_installed_maps = g_value_get_uint (value);
-      break;
-    case PROP_MAX_INSTALLED_MAPS:
-      self->priv->max_installed_maps = g_value_get_uint (value);
-      break;
-    case PROP_BACKING_STORES:
-      self->priv->backing_stores = g_value_get_uint (value);
-      break;
-    case PROP_SAVE_UNDERS:
-      self->priv->save_unders = g_value_get_boolean (value);
-      break;
-    case PROP_ROOT_DEPTH:
-      self->priv->root_depth = g_value_get_uint (value);
-      break;
-    case PROP_ROOT_VISUALID:
-      self->priv->root_visual_id = g_value_get_uint (value);
-      break;
-    default:
-      g_warning ("gx_screen_set_property on unknown property");
-      return;
-    }
-}
-
 #if 0
 static void
 gx_screen_mydoable_interface_init (gpointer interface, gpointer data)
@@ -465,18 +400,57 @@ gx_screen_init (GXScreen * self)
   /* populate your object here */
 }
 
+/**
+ * _gx_screen_new:
+ * @connection: The connection the screen belongs to
+ * @xcb_screen: The screen's description in the connection setup data
+ * @number: The screen number
+ *
+ * Creates a screen object that reads its state directly from the
+ * xcb_setup_t of @connection. (See gx_connection_get_screen ())
+ */
 GXScreen *
-gx_screen_new (void)
+_gx_screen_new (GXConnection *connection,
+		const xcb_screen_t *xcb_screen,
+		guint number)
+{
+  GXScreen *self = GX_SCREEN (g_object_new (GX_TYPE_SCREEN, NULL));
+
+  self->priv->number = number;
+  self->priv->connection = connection;
+  g_object_add_weak_pointer (G_OBJECT (connection),
+			     (gpointer *)&self->priv->connection);
+  self->priv->xcb_screen = xcb_screen;
+  self->priv->screen = *xcb_screen;
+
+  return self;
+}
+
+static void
+gx_screen_dispose (GObject * object)
 {
-  return GX_SCREEN (g_object_new (gx_screen_get_type (), NULL));
+  GXScreen *self = GX_SCREEN(object);
+
+  if (self->priv->root)
+    {
+      g_object_unref (self->priv->root);
+      self->priv->root = NULL;
+    }
+
+  G_OBJECT_CLASS (gx_screen_parent_class)->dispose (object);
 }
 
 void
 gx_screen_finalize (GObject * object)
 {
-  /* GXScreen *self = GX_SCREEN(object); */
+  GXScreen *self = GX_SCREEN(object);
+
+  if (self->priv->connection)
+    g_object_remove_weak_pointer (G_OBJECT (self->priv->connection),
+				  (gpointer *)&self->priv->connection);
+
+  g_free (self->priv->visuals);
 
-  /* destruct your object here */
   G_OBJECT_CLASS (gx_screen_parent_class)->finalize (object);
 }
 
@@ -486,87 +460,419 @@ gx_screen_get_number (GXScreen *self)
   return self->priv->number;
 }
 
+/**
+ * gx_screen_get_root:
+ * @self: A screen object
+ *
+ * Returns a new reference to the screen's root window, or %NULL if the
+ * screen's connection has been destroyed before the root window was
+ * first requested.
+ */
 GXWindow *
 gx_screen_get_root (GXScreen *self)
 {
+  if (!self->priv->root)
+    {
+      GXConnection *connection = self->priv->connection;
+      guint32 xid = self->priv->screen.root;
+      GObject *root;
+
+      if (!connection)
+	return NULL;
+
+      /* NB: The "xid" + "wrap" properties can be used to create
+       * GXWindow objects that wrap an existing window XID */
+      root = _gx_connection_lookup_xid_object (connection, xid);
+      if (root && G_TYPE_CHECK_INSTANCE_TYPE (root, GX_TYPE_WINDOW))
+	g_object_ref (root);
+      else
+	root = g_object_new (GX_TYPE_WINDOW,
+			     "connection", connection,
+			     "xid", xid,
+			     "wrap", TRUE,
+			     NULL);
+      self->priv->root = GX_WINDOW (root);
+    }
+
   return g_object_ref (self->priv->root);
 }
 
-GXColormap *
+GXColormap
 gx_screen_get_default_colormap (GXScreen *self)
 {
-  return self->priv->default_colormap;
+  return self->priv->screen.default_colormap;
 }
 
 guint32
 gx_screen_get_black_pixel (GXScreen *self)
 {
-  return self->priv->black_pixel;
+  return self->priv->screen.black_pixel;
 }
 
 guint32
 gx_screen_get_white_pixel (GXScreen *self)
 {
-  return self->priv->white_pixel;
+  return self->priv->screen.white_pixel;
 }
 
 guint16
 gx_screen_get_width (GXScreen *self)
 {
-  return self->priv->width_in_pixels;
+  return self->priv->screen.width_in_pixels;
 }
 
 guint16
 gx_screen_get_height (GXScreen *self)
 {
-  return self->priv->height_in_pixels;
+  return self->priv->screen.height_in_pixels;
 }
 
 guint16
 gx_screen_get_width_in_millimeters (GXScreen *self)
 {
-  return self->priv->width_in_millimeters;
+  return self->priv->screen.width_in_millimeters;
 }
 
 guint16
 gx_screen_get_height_in_millimeters (GXScreen *self)
 {
-  return self->priv->height_in_millimeters;
+  return self->priv->screen.height_in_millimeters;
 }
 
 guint16
 gx_screen_get_minimum_installed_maps (GXScreen *self)
 {
-  return self->priv->min_installed_maps;
+  return self->priv->screen.min_installed_maps;
 }
 
 guint16
 gx_screen_get_maximum_installed_maps (GXScreen *self)
 {
-  return self->priv->max_installed_maps;
+  return self->priv->screen.max_installed_maps;
 }
 
 GXVisualID
 gx_screen_get_root_visual_id (GXScreen *self)
 {
-  return self->priv->root_visual_id;
+  return self->priv->screen.root_visual;
 }
 
 guint8
 gx_screen_get_backing_stores (GXScreen *self)
 {
-  return self->priv->backing_stores;
+  return self->priv->screen.backing_stores;
 }
 
 gboolean
 gx_screen_get_save_unders (GXScreen *self)
 {
-  return self->priv->save_unders;
+  return self->priv->screen.save_unders;
 }
 
 guint8
 gx_screen_get_root_depth (GXScreen *self)
 {
-  return self->priv->root_depth;
+  return self->priv->screen.root_depth;
 }
 
+guint8
+gx_screen_get_allowed_depths_len (GXScreen *self)
+{
+  return self->priv->screen.allowed_depths_len;
+}
+
+/**
+ * gx_screen_depth_iter_init:
+ * @self: A screen object
+ * @iter: An uninitialized #GXDepthIter
+ *
+ * Initializes @iter to iterate the depths supported by the screen,
+ * which are read directly from the connection setup data. If the
+ * screen's connection has been destroyed there are no depths.
+ */
+void
+gx_screen_depth_iter_init (GXScreen *self, GXDepthIter *iter)
+{
+  if (self->priv->connection)
+    iter->iter = xcb_screen_allowed_depths_iterator (self->priv->xcb_screen);
+  else
+    iter->iter.rem = 0;
+}
+
+/**
+ * gx_depth_iter_next:
+ * @iter: A #GXDepthIter
+ *
+ * Returns: The next depth, or %NULL once all have been seen. The depth
+ * is owned by the connection.
+ */
+const xcb_depth_t *
+gx_depth_iter_next (GXDepthIter *iter)
+{
+  const xcb_depth_t *depth;
+
+  if (!iter->iter.rem)
+    return NULL;
+
+  depth = iter->iter.data;
+  xcb_depth_next (&iter->iter);
+  return depth;
+}
+
+/**
+ * gx_screen_visual_iter_init:
+ * @self: A screen object
+ * @iter: An uninitialized #GXVisualIter
+ *
+ * Initializes @iter to iterate the visuals of every depth supported by
+ * the screen.
+ */
+void
+gx_screen_visual_iter_init (GXScreen *self, GXVisualIter *iter)
+{
+  gx_screen_depth_iter_init (self, &iter->depths);
+  iter->visuals.rem = 0;
+  iter->depth = 0;
+}
+
+/**
+ * gx_depth_visual_iter_init:
+ * @depth: A depth as returned by gx_depth_iter_next ()
+ * @iter: An uninitialized #GXVisualIter
+ *
+ * Initializes @iter to iterate only the visuals of @depth.
+ */
+void
+gx_depth_visual_iter_init (const xcb_depth_t *depth, GXVisualIter *iter)
+{
+  iter->depths.iter.rem = 0;
+  iter->visuals = xcb_depth_visuals_iterator (depth);
+  iter->depth = depth->depth;
+}
+
+/**
+ * gx_visual_iter_next:
+ * @iter: A #GXVisualIter
+ * @depth: Return location for the depth of the visual, or %NULL
+ *
+ * Returns: The next visual, or %NULL once all have been seen. The
+ * visual is owned by the connection.
+ */
+const xcb_visualtype_t *
+gx_visual_iter_next (GXVisualIter *iter, guint8 *depth)
+{
+  const xcb_visualtype_t *visual;
+
+  while (!iter->visuals.rem)
+    {
+      const xcb_depth_t *next_depth = gx_depth_iter_next (&iter->depths);
+
+      if (!next_depth)
+	return NULL;
+
+      iter->visuals = xcb_depth_visuals_iterator (next_depth);
+      iter->depth = next_depth->depth;
+    }
+
+  visual = iter->visuals.data;
+  if (depth)
+    *depth = iter->depth;
+  xcb_visualtype_next (&iter->visuals);
+  return visual;
+}
+
+static int
+compare_visual_infos (const void *a, const void *b)
+{
+  const GXVisualInfo *info_a = a;
+  const GXVisualInfo *info_b = b;
+
+  if (info_a->visual_id < info_b->visual_id)
+    return -1;
+  else if (info_a->visual_id > info_b->visual_id)
+    return 1;
+  else
+    return 0;
+}
+
+static gboolean
+is_argb_visual (const GXVisualInfo *info)
+{
+  return info->depth == 32
+    && info->visual_class == XCB_VISUAL_CLASS_TRUE_COLOR
+    && info->red_mask == 0xff0000
+    && info->green_mask == 0x00ff00
+    && info->blue_mask == 0x0000ff;
+}
+
+static void
+ensure_visual_index (GXScreen *self)
+{
+  GXScreenPrivate *priv = self->priv;
+  GXVisualIter iter;
+  const xcb_visualtype_t *visual;
+  guint8 depth;
+  guint i;
+
+  if (priv->visuals_indexed)
+    return;
+
+  /* NB: If the connection has been destroyed the index will simply be
+   * empty. */
+  priv->visuals_indexed = TRUE;
+
+  gx_screen_visual_iter_init (self, &iter);
+  while (gx_visual_iter_next (&iter, NULL))
+    priv->n_visuals++;
+
+  if (!priv->n_visuals)
+    return;
+
+  priv->visuals = g_new (GXVisualInfo, priv->n_visuals);
+
+  i = 0;
+  gx_screen_visual_iter_init (self, &iter);
+  while ((visual = gx_visual_iter_next (&iter, &depth)))
+    {
+      GXVisualInfo *info = &priv->visuals[i++];
+
+      info->visual_id = visual->visual_id;
+      info->red_mask = visual->red_mask;
+      info->green_mask = visual->green_mask;
+      info->blue_mask = visual->blue_mask;
+      info->colormap_entries = visual->colormap_entries;
+      info->depth = depth;
+      info->visual_class = visual->_class;
+      info->bits_per_rgb_value = visual->bits_per_rgb_value;
+    }
+
+  qsort (priv->visuals, priv->n_visuals, sizeof (GXVisualInfo),
+	 compare_visual_infos);
+
+  priv->root_visual =
+    gx_screen_lookup_visual (self, priv->screen.root_visual);
+
+  if (priv->root_visual
+      && priv->root_visual->visual_class == XCB_VISUAL_CLASS_TRUE_COLOR)
+    priv->true_color_visual = priv->root_visual;
+
+  for (i = 0; i < priv->n_visuals; i++)
+    {
+      const GXVisualInfo *info = &priv->visuals[i];
+
+      if (!priv->argb_visual && is_argb_visual (info))
+	priv->argb_visual = info;
+
+      if (!priv->true_color_visual
+	  && info->depth == priv->screen.root_depth
+	  && info->visual_class == XCB_VISUAL_CLASS_TRUE_COLOR)
+	priv->true_color_visual = info;
+    }
+}
+
+/**
+ * gx_screen_get_visuals:
+ * @self: A screen object
+ * @n_visuals: Return location for the number of visuals
+ *
+ * Returns: An array of all the visuals supported by the screen, sorted
+ * by visual ID. The array is owned by the screen.
+ */
+const GXVisualInfo *
+gx_screen_get_visuals (GXScreen *self, guint *n_visuals)
+{
+  ensure_visual_index (self);
+
+  *n_visuals = self->priv->n_visuals;
+  return self->priv->visuals;
+}
+
+/**
+ * gx_screen_lookup_visual:
+ * @self: A screen object
+ * @visual_id: A visual ID
+ *
+ * Returns: The description of the visual with the given ID, or %NULL
+ * if the screen has no such visual.
+ */
+const GXVisualInfo *
+gx_screen_lookup_visual (GXScreen *self, guint32 visual_id)
+{
+  GXVisualInfo key;
+
+  ensure_visual_index (self);
+
+  if (!self->priv->n_visuals)
+    return NULL;
+
+  key.visual_id = visual_id;
+  return bsearch (&key, self->priv->visuals, self->priv->n_visuals,
+		  sizeof (GXVisualInfo), compare_visual_infos);
+}
+
+/**
+ * gx_screen_find_visual:
+ * @self: A screen object
+ * @depth: The depth of the visual, or 0 for any depth
+ * @visual_class: The xcb_visual_class_t of the visual
+ *
+ * Returns: The visual with the lowest ID matching the given depth and
+ * class, or %NULL if there is none.
+ */
+const GXVisualInfo *
+gx_screen_find_visual (GXScreen *self, guint8 depth, guint8 visual_class)
+{
+  guint i;
+
+  ensure_visual_index (self);
+
+  for (i = 0; i < self->priv->n_visuals; i++)
+    {
+      const GXVisualInfo *info = &self->priv->visuals[i];
+
+      if ((depth == 0 || info->depth == depth)
+	  && info->visual_class == visual_class)
+	return info;
+    }
+
+  return NULL;
+}
+
+const GXVisualInfo *
+gx_screen_get_root_visual (GXScreen *self)
+{
+  ensure_visual_index (self);
+
+  return self->priv->root_visual;
+}
+
+/**
+ * gx_screen_get_argb_visual:
+ * @self: A screen object
+ *
+ * Returns: A 32bit TrueColor visual with 8 bits each for red, green
+ * and blue (leaving the top 8 bits for alpha) as typically used for
+ * translucent windows, or %NULL if the screen has no such visual.
+ */
+const GXVisualInfo *
+gx_screen_get_argb_visual (GXScreen *self)
+{
+  ensure_visual_index (self);
+
+  return self->priv->argb_visual;
+}
+
+/**
+ * gx_screen_get_true_color_visual:
+ * @self: A screen object
+ *
+ * Returns: A TrueColor visual with the same depth as the root window,
+ * preferring the root visual itself, or %NULL if there is none.
+ */
+const GXVisualInfo *
+gx_screen_get_true_color_visual (GXScreen *self)
+{
+  ensure_visual_index (self);
+
+  return self->priv->true_color_visual;
+}
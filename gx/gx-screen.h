@@ -29,8 +29,15 @@
 #include <glib.h>
 #include <glib-object.h>
 
+#include <xcb/xcb.h>
+
 G_BEGIN_DECLS
 
+#ifndef GX_CONNECTION_TYPEDEF
+typedef struct _GXConnection	    GXConnection;
+#define GX_CONNECTION_TYPEDEF
+#endif
+
 #ifndef GX_WINDOW_TYPEDEF
 typedef struct _GXWindow            GXWindow;
 #define GX_WINDOW_TYPEDEF
@@ -72,10 +79,39 @@ struct _GXScreenClass
 
 GType gx_screen_get_type(void);
 
-/* add additional methods here */
-GXScreen *gx_screen_new(void);
+/* Iterate the depths and visuals of a screen without copying them out
+ * of the connection setup data. The screen's connection must outlive
+ * the iterator. */
+typedef struct {
+  /*< private > */
+  xcb_depth_iterator_t	    iter;
+} GXDepthIter;
+
+typedef struct {
+  /*< private > */
+  GXDepthIter		    depths;
+  xcb_visualtype_iterator_t visuals;
+  guint8		    depth;
+} GXVisualIter;
+
+/* A compact copy of a visual's description, as found in the screen's
+ * visual index. (See gx_screen_lookup_visual ()) */
+typedef struct {
+  guint32 visual_id;
+  guint32 red_mask;
+  guint32 green_mask;
+  guint32 blue_mask;
+  guint16 colormap_entries;
+  guint8  depth;
+  guint8  visual_class; /* xcb_visual_class_t */
+  guint8  bits_per_rgb_value;
+} GXVisualInfo;
+
+GXScreen *
+_gx_screen_new (GXConnection *connection,
+		const xcb_screen_t *xcb_screen,
+		guint number);
 
-GXWindow *gx_screen_get_root (GXScreen *self);
 guint gx_screen_get_number (GXScreen *self);
 GXWindow *gx_screen_get_root (GXScreen *self);
 guint32 gx_screen_get_black_pixel (GXScreen *self);
@@ -92,6 +128,26 @@ gboolean gx_screen_get_save_unders (GXScreen *self);
 guint8 gx_screen_get_root_depth (GXScreen *self);
 guint8 gx_screen_get_allowed_depths_len (GXScreen *self);
 
+void gx_screen_depth_iter_init (GXScreen *self, GXDepthIter *iter);
+const xcb_depth_t *gx_depth_iter_next (GXDepthIter *iter);
+
+void gx_screen_visual_iter_init (GXScreen *self, GXVisualIter *iter);
+void gx_depth_visual_iter_init (const xcb_depth_t *depth,
+				GXVisualIter *iter);
+const xcb_visualtype_t *gx_visual_iter_next (GXVisualIter *iter,
+					     guint8 *depth);
+
+const GXVisualInfo *gx_screen_get_visuals (GXScreen *self,
+					   guint *n_visuals);
+const GXVisualInfo *gx_screen_lookup_visual (GXScreen *self,
+					     guint32 visual_id);
+const GXVisualInfo *gx_screen_find_visual (GXScreen *self,
+					   guint8 depth,
+					   guint8 visual_class);
+const GXVisualInfo *gx_screen_get_root_visual (GXScreen *self);
+const GXVisualInfo *gx_screen_get_argb_visual (GXScreen *self);
+const GXVisualInfo *gx_screen_get_true_color_visual (GXScreen *self);
+
 
 G_END_DECLS
 
@@ -0,0 +1,55 @@
+/*
+ * vim: tabstop=8 shiftwidth=2 noexpandtab softtabstop=2 cinoptions=>2,{2,:0,t0,(0,W4
+ *
+ * <copyright_assignments>
+ * Copyright (C) 2008  Robert Bragg
+ * </copyright_assignments>
+ *
+ * <license>
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301, USA.
+ * </license>
+ *
+ */
+
+#ifndef GX_SHM_IMAGE_PRIVATE_H
+#define GX_SHM_IMAGE_PRIVATE_H
+
+#include <gx/gx-shm-image.h>
+
+#include <glib.h>
+#include <xcb/xcb.h>
+
+G_BEGIN_DECLS
+
+/* NB: These are used by gx-drawable.c to upload and download images
+ * and aren't installed */
+
+guint32
+_gx_shm_image_get_shmseg (GXShmImage *self);
+
+void
+_gx_shm_image_set_busy (GXShmImage *self, gboolean busy);
+
+void
+_gx_shm_image_set_put_cookie (GXShmImage *self, xcb_void_cookie_t cookie);
+
+void
+_gx_shm_image_set_put_too_large (GXShmImage *self);
+
+G_END_DECLS
+
+#endif /* GX_SHM_IMAGE_PRIVATE_H */
+
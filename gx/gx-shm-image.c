@@ -0,0 +1,559 @@
+/*
+ * vim: tabstop=8 shiftwidth=2 noexpandtab softtabstop=2 cinoptions=>2,{2,:0,t0,(0,W4
+ *
+ * <copyright_assignments>
+ * Copyright (C) 2008  Robert Bragg
+ * </copyright_assignments>
+ *
+ * <license>
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301, USA.
+ * </license>
+ *
+ */
+
+#include <gx/gx-shm-image.h>
+#include <gx/gx-shm-image-private.h>
+#include <gx/gx-connection.h>
+#include <gx/gx-protocol-error.h>
+#include <gx/gx-debug.h>
+
+#include <glib.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef GX_HAVE_SHM
+#include <xcb/shm.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#endif
+
+#define GX_SHM_IMAGE_GET_PRIVATE(object) \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((object), GX_TYPE_SHM_IMAGE, GXShmImagePrivate))
+
+/* Creating a shared memory segment needs a round trip (so we know the
+ * server has attached it before we mark it for removal) so segments
+ * released by images are kept in a per connection pool for reuse. This
+ * is the maximum number of unused segments we hang on to. */
+#define GX_SHM_POOL_MAX_FREE 4
+
+typedef struct _GXShmSegment
+{
+  guint32	 shmseg;
+  int		 shmid;
+  guint8	*data;
+  gsize		 size;
+
+  /* Set while the server may still be reading from the segment */
+  gboolean	 busy;
+} GXShmSegment;
+
+typedef struct _GXShmPool
+{
+  xcb_connection_t *xcb_connection;
+  gboolean	    available;
+  GList		   *free_segments;
+  guint		    n_free_segments;
+} GXShmPool;
+
+struct _GXShmImagePrivate
+{
+  GXConnection	*connection;
+
+  guint16	 width;
+  guint16	 height;
+  guint8	 depth;
+  guint		 stride;
+
+  guint8	*data;
+
+  /* NULL if the image isn't shared with the server */
+  GXShmSegment	*segment;
+
+  /* The checked request for the last gx_drawable_put_shm_image (), if
+   * gx_shm_image_wait () hasn't checked it yet */
+  xcb_void_cookie_t put_cookie;
+  gboolean	 put_pending;
+  /* Set if the last upload wasn't sent because its rows were too long
+   * for a PutImage request */
+  gboolean	 put_too_large;
+};
+
+static void gx_shm_image_finalize (GObject *self);
+
+/* NB: This declares gx_shm_image_parent_class */
+G_DEFINE_TYPE (GXShmImage, gx_shm_image, G_TYPE_OBJECT);
+
+
+static void
+gx_shm_image_class_init (GXShmImageClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->finalize = gx_shm_image_finalize;
+
+  g_type_class_add_private (klass, sizeof (GXShmImagePrivate));
+}
+
+static void
+gx_shm_image_init (GXShmImage *self)
+{
+  self->priv = GX_SHM_IMAGE_GET_PRIVATE (self);
+}
+
+/* Waits until the server has processed all the requests sent so far */
+static void
+sync_with_server (xcb_connection_t *xcb_connection)
+{
+  free (xcb_get_input_focus_reply (xcb_connection,
+				   xcb_get_input_focus (xcb_connection),
+				   NULL));
+}
+
+#ifdef GX_HAVE_SHM
+static GXShmSegment *
+shm_segment_new (GXShmPool *pool, gsize size)
+{
+  GXShmSegment *segment = g_slice_new0 (GXShmSegment);
+  xcb_void_cookie_t cookie;
+  xcb_generic_error_t *error;
+
+  segment->shmid = shmget (IPC_PRIVATE, size, IPC_CREAT | 0600);
+  if (segment->shmid < 0)
+    goto error;
+
+  segment->data = shmat (segment->shmid, NULL, 0);
+  if (segment->data == (void *)-1)
+    {
+      shmctl (segment->shmid, IPC_RMID, NULL);
+      goto error;
+    }
+
+  segment->shmseg = xcb_generate_id (pool->xcb_connection);
+  cookie = xcb_shm_attach_checked (pool->xcb_connection,
+				   segment->shmseg,
+				   segment->shmid,
+				   FALSE);
+  error = xcb_request_check (pool->xcb_connection, cookie);
+
+  /* Once the server has attached the segment we can mark it for
+   * removal so it gets cleaned up if either of us crashes. */
+  shmctl (segment->shmid, IPC_RMID, NULL);
+
+  if (error)
+    {
+      /* E.g. the server is on another machine */
+      GX_NOTE (ERRORS, "failed to attach shm segment; disabling MIT-SHM");
+      free (error);
+      shmdt (segment->data);
+      pool->available = FALSE;
+      goto error;
+    }
+
+  segment->size = size;
+  return segment;
+
+error:
+  g_slice_free (GXShmSegment, segment);
+  return NULL;
+}
+
+static void
+shm_segment_free (GXShmPool *pool, GXShmSegment *segment, gboolean detach)
+{
+  if (detach)
+    xcb_shm_detach (pool->xcb_connection, segment->shmseg);
+  shmdt (segment->data);
+  g_slice_free (GXShmSegment, segment);
+}
+
+static void
+shm_pool_free (gpointer data)
+{
+  GXShmPool *pool = data;
+  GList *tmp;
+
+  /* NB: This is called as the connection is finalized, after we have
+   * disconnected, and the server detaches everything for us. */
+  for (tmp = pool->free_segments; tmp != NULL; tmp = tmp->next)
+    shm_segment_free (pool, tmp->data, FALSE);
+  g_list_free (pool->free_segments);
+
+  g_slice_free (GXShmPool, pool);
+}
+
+static GXShmPool *
+get_shm_pool (GXConnection *connection)
+{
+  static GQuark pool_quark = 0;
+  GXShmPool *pool;
+  const xcb_query_extension_reply_t *extension;
+
+  if (!pool_quark)
+    pool_quark = g_quark_from_static_string ("gx-shm-pool");
+
+  pool = g_object_get_qdata (G_OBJECT (connection), pool_quark);
+  if (pool)
+    return pool;
+
+  pool = g_slice_new0 (GXShmPool);
+  pool->xcb_connection = gx_connection_get_xcb_connection (connection);
+
+  extension = xcb_get_extension_data (pool->xcb_connection, &xcb_shm_id);
+  if (extension && extension->present)
+    {
+      xcb_shm_query_version_reply_t *version =
+	xcb_shm_query_version_reply (pool->xcb_connection,
+				     xcb_shm_query_version (pool->xcb_connection),
+				     NULL);
+      pool->available = version != NULL;
+      free (version);
+    }
+
+  g_object_set_qdata_full (G_OBJECT (connection), pool_quark,
+			   pool, shm_pool_free);
+  return pool;
+}
+
+static GXShmSegment *
+shm_pool_acquire (GXShmPool *pool, gsize size)
+{
+  GList *tmp;
+
+  /* NB: we don't reuse segments more than twice the size we need so
+   * small images don't pin down large segments */
+  for (tmp = pool->free_segments; tmp != NULL; tmp = tmp->next)
+    {
+      GXShmSegment *segment = tmp->data;
+
+      if (segment->size >= size && segment->size / 2 <= size)
+	{
+	  pool->free_segments =
+	    g_list_delete_link (pool->free_segments, tmp);
+	  pool->n_free_segments--;
+
+	  if (segment->busy)
+	    {
+	      sync_with_server (pool->xcb_connection);
+	      segment->busy = FALSE;
+	    }
+	  return segment;
+	}
+    }
+
+  return shm_segment_new (pool, size);
+}
+
+static void
+shm_pool_release (GXShmPool *pool, GXShmSegment *segment)
+{
+  if (pool->n_free_segments >= GX_SHM_POOL_MAX_FREE)
+    {
+      shm_segment_free (pool, segment, TRUE);
+      return;
+    }
+
+  pool->free_segments = g_list_prepend (pool->free_segments, segment);
+  pool->n_free_segments++;
+}
+#endif /* GX_HAVE_SHM */
+
+static gboolean
+lookup_pixmap_format (xcb_connection_t *xcb_connection,
+		      guint8 depth,
+		      guint8 *bits_per_pixel,
+		      guint8 *scanline_pad)
+{
+  xcb_format_iterator_t iter;
+
+  for (iter = xcb_setup_pixmap_formats_iterator (
+					xcb_get_setup (xcb_connection));
+       iter.rem;
+       xcb_format_next (&iter))
+    {
+      if (iter.data->depth == depth)
+	{
+	  *bits_per_pixel = iter.data->bits_per_pixel;
+	  *scanline_pad = iter.data->scanline_pad;
+	  return TRUE;
+	}
+    }
+
+  return FALSE;
+}
+
+static GXShmImage *
+shm_image_new (GXConnection *connection,
+	       guint16 width,
+	       guint16 height,
+	       guint8 depth,
+	       gboolean shared)
+{
+  GXShmImage *self;
+  GXShmImagePrivate *priv;
+  guint8 bits_per_pixel;
+  guint8 scanline_pad;
+  gsize size;
+
+  g_return_val_if_fail (GX_IS_CONNECTION (connection), NULL);
+
+  if (!lookup_pixmap_format (gx_connection_get_xcb_connection (connection),
+			     depth, &bits_per_pixel, &scanline_pad))
+    {
+      g_warning ("The X server doesn't support images of depth %d", depth);
+      return NULL;
+    }
+
+  self = g_object_new (GX_TYPE_SHM_IMAGE, NULL);
+  priv = self->priv;
+
+  priv->connection = g_object_ref (connection);
+  priv->width = width;
+  priv->height = height;
+  priv->depth = depth;
+  priv->stride = ((width * bits_per_pixel + scanline_pad - 1)
+		  / scanline_pad) * scanline_pad / 8;
+
+  size = priv->stride * height;
+
+#ifdef GX_HAVE_SHM
+  if (shared)
+    {
+      GXShmPool *pool = get_shm_pool (connection);
+      if (pool->available)
+	priv->segment = shm_pool_acquire (pool, size);
+    }
+
+  if (priv->segment)
+    priv->data = priv->segment->data;
+  else
+#endif
+    priv->data = g_malloc (size);
+
+  return self;
+}
+
+/**
+ * gx_shm_image_new:
+ * @connection: The connection the image will be used with
+ * @width: The width of the image in pixels
+ * @height: The height of the image in pixels
+ * @depth: The depth of the image
+ *
+ * Creates a ZPixmap format image whose data is shared with the X server
+ * via the MIT-SHM extension, so it can be uploaded or downloaded without
+ * copying the pixels through the socket. If MIT-SHM isn't available the
+ * image is simply allocated in local memory, and transferred using
+ * PutImage/GetImage requests instead.
+ *
+ * Returns: A new GXShmImage
+ */
+GXShmImage *
+gx_shm_image_new (GXConnection *connection,
+		  guint16 width,
+		  guint16 height,
+		  guint8 depth)
+{
+  return shm_image_new (connection, width, height, depth, TRUE);
+}
+
+/**
+ * gx_shm_image_new_unshared:
+ *
+ * Like gx_shm_image_new () but the image will never use shared memory,
+ * which can be useful for comparison.
+ */
+GXShmImage *
+gx_shm_image_new_unshared (GXConnection *connection,
+			   guint16 width,
+			   guint16 height,
+			   guint8 depth)
+{
+  return shm_image_new (connection, width, height, depth, FALSE);
+}
+
+static void
+gx_shm_image_finalize (GObject *object)
+{
+  GXShmImage *self = GX_SHM_IMAGE (object);
+  GXShmImagePrivate *priv = self->priv;
+
+  if (priv->put_pending)
+    xcb_discard_reply (gx_connection_get_xcb_connection (priv->connection),
+		       priv->put_cookie.sequence);
+
+#ifdef GX_HAVE_SHM
+  if (priv->segment)
+    shm_pool_release (get_shm_pool (priv->connection), priv->segment);
+  else
+#endif
+    g_free (priv->data);
+
+  g_object_unref (priv->connection);
+
+  G_OBJECT_CLASS (gx_shm_image_parent_class)->finalize (object);
+}
+
+gboolean
+gx_shm_image_is_shared (GXShmImage *self)
+{
+  return self->priv->segment != NULL;
+}
+
+/**
+ * gx_shm_image_get_data:
+ * @self: A GXShmImage
+ *
+ * Returns the pixel data for the image, with rows of
+ * gx_shm_image_get_stride () bytes.
+ *
+ * NB: For shared images the X server reads the data asynchronously, so
+ * after gx_drawable_put_shm_image () call gx_shm_image_wait () before
+ * modifying the data.
+ */
+guint8 *
+gx_shm_image_get_data (GXShmImage *self)
+{
+  return self->priv->data;
+}
+
+guint
+gx_shm_image_get_stride (GXShmImage *self)
+{
+  return self->priv->stride;
+}
+
+guint16
+gx_shm_image_get_width (GXShmImage *self)
+{
+  return self->priv->width;
+}
+
+guint16
+gx_shm_image_get_height (GXShmImage *self)
+{
+  return self->priv->height;
+}
+
+guint8
+gx_shm_image_get_depth (GXShmImage *self)
+{
+  return self->priv->depth;
+}
+
+/**
+ * gx_shm_image_wait:
+ * @self: A GXShmImage
+ * @error: A GError return location
+ *
+ * Blocks until the X server has finished with the last
+ * gx_drawable_put_shm_image () of this image, so that it's safe to
+ * modify a shared image again, and reports any error caused by the
+ * upload. (Such as BadDrawable or BadMatch, or BadLength if the image
+ * was too large to send at all.)
+ *
+ * Returns: FALSE if the last upload failed
+ */
+gboolean
+gx_shm_image_wait (GXShmImage *self, GError **error)
+{
+  GXShmImagePrivate *priv = self->priv;
+  xcb_connection_t *xcb_connection =
+    gx_connection_get_xcb_connection (priv->connection);
+  xcb_generic_error_t *xcb_error = NULL;
+
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  /* NB: Once the server has processed the put request it has also
+   * finished reading the data */
+  if (priv->put_pending)
+    {
+      _gx_connection_flush_for_reply (priv->connection);
+      xcb_error = xcb_request_check (xcb_connection, priv->put_cookie);
+      priv->put_pending = FALSE;
+    }
+  else if (priv->segment && priv->segment->busy)
+    sync_with_server (xcb_connection);
+
+  if (priv->segment)
+    priv->segment->busy = FALSE;
+
+  if (priv->put_too_large)
+    {
+      priv->put_too_large = FALSE;
+      _gx_connection_set_request_too_large_error (error);
+      return FALSE;
+    }
+
+  if (xcb_error)
+    {
+      g_set_error (error,
+		   GX_PROTOCOL_ERROR,
+		   gx_protocol_error_from_xcb_error (xcb_error),
+		   "Protocol Error");
+      free (xcb_error);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Returns the MIT-SHM segment for the image, or 0 if it isn't shared */
+guint32
+_gx_shm_image_get_shmseg (GXShmImage *self)
+{
+  return self->priv->segment ? self->priv->segment->shmseg : 0;
+}
+
+void
+_gx_shm_image_set_busy (GXShmImage *self, gboolean busy)
+{
+  if (self->priv->segment)
+    self->priv->segment->busy = busy;
+}
+
+/* Remembers the checked request for the last upload of the image, so
+ * gx_shm_image_wait () can report any error it caused. If the previous
+ * upload was never waited for, XCB is told to drop its error. */
+void
+_gx_shm_image_set_put_cookie (GXShmImage *self, xcb_void_cookie_t cookie)
+{
+  GXShmImagePrivate *priv = self->priv;
+
+  if (priv->put_pending)
+    xcb_discard_reply (gx_connection_get_xcb_connection (priv->connection),
+		       priv->put_cookie.sequence);
+
+  priv->put_cookie = cookie;
+  priv->put_pending = TRUE;
+  priv->put_too_large = FALSE;
+}
+
+/* Records that the last upload couldn't be sent, so gx_shm_image_wait ()
+ * reports BadLength */
+void
+_gx_shm_image_set_put_too_large (GXShmImage *self)
+{
+  GXShmImagePrivate *priv = self->priv;
+
+  if (priv->put_pending)
+    xcb_discard_reply (gx_connection_get_xcb_connection (priv->connection),
+		       priv->put_cookie.sequence);
+
+  priv->put_pending = FALSE;
+  priv->put_too_large = TRUE;
+}
+
@@ -0,0 +1,98 @@
+/*
+ * vim: tabstop=8 shiftwidth=2 noexpandtab softtabstop=2 cinoptions=>2,{2,:0,t0,(0,W4
+ *
+ * <copyright_assignments>
+ * Copyright (C) 2008  Robert Bragg
+ * </copyright_assignments>
+ *
+ * <license>
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301, USA.
+ * </license>
+ *
+ */
+
+#ifndef GX_SHM_IMAGE_H
+#define GX_SHM_IMAGE_H
+
+#include <gx/gx-types.h>
+
+#include <glib.h>
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+#define GX_SHM_IMAGE(obj)		  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GX_TYPE_SHM_IMAGE, GXShmImage))
+#define GX_TYPE_SHM_IMAGE		  (gx_shm_image_get_type())
+#define GX_SHM_IMAGE_CLASS(klass)	  (G_TYPE_CHECK_CLASS_CAST ((klass), GX_TYPE_SHM_IMAGE, GXShmImageClass))
+#define GX_IS_SHM_IMAGE(obj)		  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GX_TYPE_SHM_IMAGE))
+#define GX_IS_SHM_IMAGE_CLASS(klass)	  (G_TYPE_CHECK_CLASS_TYPE ((klass), GX_TYPE_SHM_IMAGE))
+#define GX_SHM_IMAGE_GET_CLASS(obj)	  (G_TYPE_INSTANCE_GET_CLASS ((obj), GX_TYPE_SHM_IMAGE, GXShmImageClass))
+
+typedef struct _GXShmImageClass GXShmImageClass;
+typedef struct _GXShmImagePrivate GXShmImagePrivate;
+
+struct _GXShmImage
+{
+  GObject parent;
+
+  /*< private > */
+  GXShmImagePrivate *priv;
+};
+
+struct _GXShmImageClass
+{
+  GObjectClass parent_class;
+};
+
+GType gx_shm_image_get_type (void);
+
+GXShmImage *
+gx_shm_image_new (GXConnection *connection,
+		  guint16 width,
+		  guint16 height,
+		  guint8 depth);
+
+GXShmImage *
+gx_shm_image_new_unshared (GXConnection *connection,
+			   guint16 width,
+			   guint16 height,
+			   guint8 depth);
+
+gboolean
+gx_shm_image_is_shared (GXShmImage *self);
+
+guint8 *
+gx_shm_image_get_data (GXShmImage *self);
+
+guint
+gx_shm_image_get_stride (GXShmImage *self);
+
+guint16
+gx_shm_image_get_width (GXShmImage *self);
+
+guint16
+gx_shm_image_get_height (GXShmImage *self);
+
+guint8
+gx_shm_image_get_depth (GXShmImage *self);
+
+gboolean
+gx_shm_image_wait (GXShmImage *self, GError **error);
+
+G_END_DECLS
+
+#endif /* GX_SHM_IMAGE_H */
+
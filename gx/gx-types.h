@@ -43,5 +43,10 @@ typedef struct _GXGContext	GXGContext;
 #define GX_GCONTEXT_TYPEDEF
 #endif
 
+#ifndef GX_SHM_IMAGE_TYPEDEF
+typedef struct _GXShmImage	GXShmImage;
+#define GX_SHM_IMAGE_TYPEDEF
+#endif
+
 #endif /* _GX_TYPES_H_ */
 
@@ -29,6 +29,7 @@
 #include <gx/gx-protocol-error.h>
 
 #include <string.h>
+#include <stdlib.h>
 
 /* Macros and defines */
 #define GX_WINDOW_GET_PRIVATE(object)(G_TYPE_INSTANCE_GET_PRIVATE ((object), GX_TYPE_WINDOW, GXWindowPrivate))
@@ -81,6 +82,17 @@ struct _GXWindowPrivate
   GXMaskValueItem *attribute_items_construct;
 
   gint8 depth_construct;
+
+  /* NB: Despite the comment above, clients such as window managers
+   * can opt in to having the state of a window mirrored. This is
+   * populated by querying the server and then kept up to date from
+   * the window's events. (See gx_window_enable_state_mirrors ()) */
+  GXWindowState *state;
+  guint32 state_sequence;
+  guint state_event_handler;
+
+  /* Event handlers added with gx_window_add_event_handler () */
+  GHookList *event_hooks;
 };
 
 
@@ -106,8 +118,6 @@ static void gx_window_finalize (GObject * self);
 static GXDrawableClass *parent_class = NULL;
 static guint gx_window_signals[LAST_SIGNAL] = { 0 };
 
-static GHashTable *xid_to_windows_map = NULL;
-
 /* NB: We have to hand code gx_window_get_type because we have to
  * have to name the class as _GXWindowClass so that it does not
  * conflict with the auto-generated typedef enum {} GXWindowClass;
@@ -172,12 +182,6 @@ gx_window_class_init (_GXWindowClass * klass)	/* Class Initialization */
 
   gobject_class->constructor = gx_window_constructor;
 
-  /* FIXME - mutex */
-  if (!xid_to_windows_map)
-    {
-      xid_to_windows_map = g_hash_table_new (g_direct_hash, g_direct_equal);
-    }
-
   new_param = g_param_spec_boolean("wrap", /* name */
 				   "Wrap",	/* nick name */
 				   "Simply wrap an already existing xid",
@@ -395,9 +399,9 @@ gx_window_constructor (GType type,
   GObject *object;
   GXWindow *self;
   GXDrawable *drawable;
-  GXConnection *connection;
+  GXConnection *connection = NULL;
   xcb_connection_t *xcb_connection;
-  guint32 xid;
+  guint32 xid = 0;
   gboolean is_wrapping_xid = FALSE;
   int i;
 
@@ -424,13 +428,12 @@ gx_window_constructor (GType type,
 	  GObjectConstructParam *construct_param = &construct_params[i];
 	  GParamSpec *pspec = construct_param->pspec;
 	  if (strcmp (g_param_spec_get_name (pspec), "xid") == 0)
-	    {
-	      xid = g_value_get_uint (construct_param->value);
-	      break;
-	    }
+	    xid = g_value_get_uint (construct_param->value);
+	  else if (strcmp (g_param_spec_get_name (pspec), "connection") == 0)
+	    connection = g_value_get_object (construct_param->value);
 	}
 #warning "Test XID wrapping code!!!"
-      existing_window = gx_window_find_from_xid (xid);
+      existing_window = gx_window_find_from_xid (connection, xid);
       if (existing_window)
 	return G_OBJECT (existing_window);
     }
@@ -487,11 +490,10 @@ gx_window_constructor (GType type,
 	 value_list);
     }
 
+  _gx_connection_register_xid_object (connection, drawable->xid, object);
+
   g_object_unref (connection);
 
-  g_hash_table_insert (xid_to_windows_map,
-		       GUINT_TO_POINTER (drawable->xid),
-		       object);
   return object;
 }
 
@@ -562,9 +564,20 @@ gx_window_new_raw (GXConnection *connection,
 void
 gx_window_finalize (GObject * object)
 {
-  /* GXWindow *self = GX_WINDOW(object); */
+  GXWindow *self = GX_WINDOW (object);
+  GXDrawable *drawable = GX_DRAWABLE (object);
+  GXConnection *connection = gx_drawable_get_connection (drawable);
+
+  g_slice_free (GXWindowState, self->priv->state);
+  _gx_event_hooks_free (self->priv->event_hooks);
+
+  /* NB: the connection may have already been destroyed */
+  if (connection)
+    {
+      _gx_connection_unregister_xid_object (connection, drawable->xid, object);
+      g_object_unref (connection);
+    }
 
-  /* destruct your object here */
   G_OBJECT_CLASS (parent_class)->finalize (object);
 }
 
@@ -574,14 +587,1378 @@ gx_window_get_connection (GXWindow *self)
   return gx_drawable_get_connection (GX_DRAWABLE (self));
 }
 
-/* Currently only for internal use, this does a lookup for an existing
- * GXWindow that corresponds to the passed xid. */
+/* This does a lookup for an existing GXWindow that corresponds to the
+ * passed xid on the given connection, and returns a new reference to it
+ * or NULL. */
 GXWindow *
-gx_window_find_from_xid (guint32 xid)
+gx_window_find_from_xid (GXConnection *connection, guint32 xid)
+{
+  GObject *object;
+
+  g_return_val_if_fail (GX_IS_CONNECTION (connection), NULL);
+
+  object = _gx_connection_lookup_xid_object (connection, xid);
+  return GX_IS_WINDOW (object) ? g_object_ref (object) : NULL;
+}
+
+/**
+ * gx_window_add_event_handler:
+ * @self: A window
+ * @codes: The event codes the handler is interested in, or %NULL for
+ *	   all events
+ * @func: The function to call for each event
+ * @user_data: Data to pass to @func
+ * @notify: Function to free @user_data when the handler is removed,
+ *	    or %NULL
+ *
+ * Adds a handler that is called directly for each matching event
+ * delivered to this window, before the window's "event" signal is
+ * emitted. (See gx_connection_add_event_handler ())
+ *
+ * Returns: An id for use with gx_window_remove_event_handler ()
+ */
+guint
+gx_window_add_event_handler (GXWindow *self,
+			     const GXEventCodeSet *codes,
+			     GXWindowEventFunc func,
+			     gpointer user_data,
+			     GDestroyNotify notify)
+{
+  g_return_val_if_fail (GX_IS_WINDOW (self), 0);
+  g_return_val_if_fail (func != NULL, 0);
+
+  return _gx_event_hooks_add (&self->priv->event_hooks, codes,
+			      (_GXEventHookFunc)func, user_data, notify);
+}
+
+void
+gx_window_remove_event_handler (GXWindow *self, guint id)
+{
+  g_return_if_fail (GX_IS_WINDOW (self));
+
+  _gx_event_hooks_remove (self->priv->event_hooks, id);
+}
+
+/* Called by the connection for each event that refers to this window */
+void
+_gx_window_dispatch_event (GXWindow *self,
+			   GXGenericEvent *event,
+			   GQuark detail)
+{
+  if (self->priv->event_hooks)
+    _gx_event_hooks_dispatch (self->priv->event_hooks, self, event);
+
+  if (GX_WINDOW_GET_CLASS (self)->event
+      || g_signal_has_handler_pending (self,
+				       gx_window_signals[EVENT_SIGNAL],
+				       detail,
+				       FALSE))
+    g_signal_emit (self, gx_window_signals[EVENT_SIGNAL], detail, event);
+}
+
+
+/* When streaming a property we read it in chunks of this many 32bit
+ * units (i.e. 256KB) and keep up to this many GetProperty requests in
+ * flight. */
+#define GX_XPROPERTY_CHUNK_LENGTH (64 * 1024)
+#define GX_XPROPERTY_MAX_PENDING  4
+
+typedef gboolean (*XPropertyWriteFunc) (const guint8 *data,
+					gsize len,
+					gpointer user_data,
+					GError **error);
+
+static gboolean
+set_error_from_xcb_error (GError **error, xcb_generic_error_t *xcb_error)
+{
+  g_set_error (error,
+	       GX_PROTOCOL_ERROR,
+	       gx_protocol_error_from_xcb_error (xcb_error),
+	       "Protocol Error");
+  free (xcb_error);
+  return FALSE;
+}
+
+/* Reads up to max_bytes of a property, passing each chunk to write_func
+ * as it arrives. The first reply tells us the size of the property so
+ * we can then pipeline the requests for the remaining chunks.
+ *
+ * NB: the server only honours delete for the request that reads the
+ * end of the property, so it can be passed to all of them. */
+static gboolean
+read_xproperty (GXWindow *self,
+		xcb_atom_t property,
+		xcb_atom_t type,
+		gboolean delete,
+		gsize max_bytes,
+		XPropertyWriteFunc write_func,
+		gpointer user_data,
+		xcb_atom_t *actual_type,
+		guint8 *format,
+		gsize *total_bytes,
+		GError **error)
+{
+  GXConnection *connection;
+  xcb_connection_t *xcb_connection;
+  xcb_window_t window = gx_drawable_get_xid (GX_DRAWABLE (self));
+  xcb_get_property_cookie_t cookies[GX_XPROPERTY_MAX_PENDING];
+  xcb_get_property_reply_t *reply;
+  xcb_generic_error_t *xcb_error = NULL;
+  const gsize chunk_bytes = GX_XPROPERTY_CHUNK_LENGTH * 4;
+  gsize remaining;
+  guint32 n_chunks;
+  guint32 issued = 0;
+  guint32 received = 0;
+  gboolean ret = TRUE;
+
+  connection = gx_window_get_connection (self);
+  if (!connection)
+    return FALSE;
+  xcb_connection = gx_connection_get_xcb_connection (connection);
+
+  cookies[0] = xcb_get_property (xcb_connection,
+				 delete,
+				 window,
+				 property,
+				 type,
+				 0,
+				 MIN (max_bytes / 4 + (max_bytes % 4 ? 1 : 0),
+				      GX_XPROPERTY_CHUNK_LENGTH));
+  _gx_connection_request_queued (connection,
+				 sizeof (xcb_get_property_request_t));
+  reply = xcb_get_property_reply (xcb_connection, cookies[0], &xcb_error);
+  /* NB: This is the newest request, so XCB has to write out everything
+   * queued before it can wait for the reply */
+  _gx_connection_requests_flushed (connection);
+  if (!reply)
+    {
+      g_object_unref (connection);
+      return set_error_from_xcb_error (error, xcb_error);
+    }
+
+  *actual_type = reply->type;
+  *format = reply->format;
+  *total_bytes = xcb_get_property_value_length (reply) + reply->bytes_after;
+
+  /* NB: if type doesn't match, the server doesn't return any data */
+  if (reply->value_len)
+    ret = write_func (xcb_get_property_value (reply),
+		      MIN (xcb_get_property_value_length (reply), max_bytes),
+		      user_data,
+		      error);
+
+  remaining = MIN (*total_bytes, max_bytes);
+  remaining -= MIN (remaining, (gsize)xcb_get_property_value_length (reply));
+  free (reply);
+
+  n_chunks = (remaining + chunk_bytes - 1) / chunk_bytes;
+
+  while (ret && received < n_chunks)
+    {
+      gsize len;
+
+      while (issued < n_chunks
+	     && issued - received < GX_XPROPERTY_MAX_PENDING)
+	{
+	  issued++;
+	  cookies[issued % GX_XPROPERTY_MAX_PENDING] =
+	    xcb_get_property (xcb_connection,
+			      delete,
+			      window,
+			      property,
+			      *actual_type,
+			      issued * GX_XPROPERTY_CHUNK_LENGTH,
+			      GX_XPROPERTY_CHUNK_LENGTH);
+	  _gx_connection_request_queued (connection,
+					 sizeof (xcb_get_property_request_t));
+	}
+
+      received++;
+      _gx_connection_flush_for_reply (connection);
+      reply =
+	xcb_get_property_reply (xcb_connection,
+				cookies[received % GX_XPROPERTY_MAX_PENDING],
+				&xcb_error);
+      if (!reply)
+	{
+	  ret = set_error_from_xcb_error (error, xcb_error);
+	  break;
+	}
+
+      if (reply->type != *actual_type || reply->format != *format)
+	{
+	  g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+		       "The property changed while being read");
+	  ret = FALSE;
+	}
+      else
+	{
+	  len = MIN ((gsize)xcb_get_property_value_length (reply), remaining);
+	  ret = write_func (xcb_get_property_value (reply), len,
+			    user_data, error);
+	  remaining -= len;
+	}
+      free (reply);
+    }
+
+  /* If we bailed out early, any outstanding replies still need to be
+   * claimed */
+  while (received < issued)
+    {
+      received++;
+      xcb_discard_reply (xcb_connection,
+			 cookies[received % GX_XPROPERTY_MAX_PENDING].sequence);
+    }
+
+  g_object_unref (connection);
+  return ret;
+}
+
+typedef struct
+{
+  guint8 *buffer;
+  gsize	  offset;
+} BufferWriteState;
+
+static gboolean
+buffer_write (const guint8 *data, gsize len, gpointer user_data,
+	      GError **error)
+{
+  BufferWriteState *state = user_data;
+
+  memcpy (state->buffer + state->offset, data, len);
+  state->offset += len;
+  return TRUE;
+}
+
+/**
+ * gx_window_get_xproperty_data:
+ * @self: A window
+ * @property: The property to read
+ * @type: The expected type of the property, or XCB_GET_PROPERTY_TYPE_ANY
+ * @delete: Whether to delete the property once it has been read
+ * @buffer: The buffer to read the property data into
+ * @buffer_size: The size of @buffer
+ * @actual_type: Return location for the property's type
+ * @format: Return location for the property's format (8, 16 or 32),
+ *	    or 0 if the property doesn't exist
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Reads the value of an X property into @buffer. Large properties are
+ * read with several pipelined GetProperty requests, so there is no
+ * intermediate copy of the whole property.
+ *
+ * Only the first @buffer_size bytes are read, and in that case
+ * @delete has no effect. If @type doesn't match the type of the
+ * property no data is read. (Check @actual_type)
+ *
+ * Returns: The full size of the property in bytes, which may be larger
+ * than @buffer_size, or -1 if there was an error.
+ */
+gssize
+gx_window_get_xproperty_data (GXWindow *self,
+			      xcb_atom_t property,
+			      xcb_atom_t type,
+			      gboolean delete,
+			      guint8 *buffer,
+			      gsize buffer_size,
+			      xcb_atom_t *actual_type,
+			      guint8 *format,
+			      GError **error)
+{
+  BufferWriteState state;
+  gsize total_bytes;
+
+  g_return_val_if_fail (GX_IS_WINDOW (self), -1);
+  g_return_val_if_fail (error == NULL || *error == NULL, -1);
+
+  state.buffer = buffer;
+  state.offset = 0;
+
+  if (!read_xproperty (self, property, type, delete, buffer_size,
+		       buffer_write, &state,
+		       actual_type, format, &total_bytes,
+		       error))
+    return -1;
+
+  return total_bytes;
+}
+
+typedef struct
+{
+  GOutputStream *stream;
+  GCancellable	*cancellable;
+  gsize		 bytes_written;
+} StreamWriteState;
+
+static gboolean
+stream_write (const guint8 *data, gsize len, gpointer user_data,
+	      GError **error)
+{
+  StreamWriteState *state = user_data;
+  gsize bytes_written = 0;
+  gboolean ret;
+
+  ret = g_output_stream_write_all (state->stream, data, len,
+				   &bytes_written,
+				   state->cancellable,
+				   error);
+  state->bytes_written += bytes_written;
+  return ret;
+}
+
+/**
+ * gx_window_get_xproperty_to_stream:
+ * @self: A window
+ * @property: The property to read
+ * @type: The expected type of the property, or XCB_GET_PROPERTY_TYPE_ANY
+ * @delete: Whether to delete the property once it has been read
+ * @stream: The stream to write the property data to
+ * @cancellable: An optional #GCancellable for writing to @stream
+ * @actual_type: Return location for the property's type, or %NULL
+ * @format: Return location for the property's format, or %NULL
+ * @bytes_written: Return location for the number of bytes written to
+ *		   @stream, or %NULL
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Reads the value of an X property and writes it to @stream, one chunk
+ * at a time as the pipelined GetProperty replies arrive.
+ *
+ * Returns: %FALSE if there was an error
+ */
+gboolean
+gx_window_get_xproperty_to_stream (GXWindow *self,
+				   xcb_atom_t property,
+				   xcb_atom_t type,
+				   gboolean delete,
+				   GOutputStream *stream,
+				   GCancellable *cancellable,
+				   xcb_atom_t *actual_type,
+				   guint8 *format,
+				   gsize *bytes_written,
+				   GError **error)
+{
+  StreamWriteState state;
+  xcb_atom_t tmp_type;
+  guint8 tmp_format;
+  gsize total_bytes;
+  gboolean ret;
+
+  g_return_val_if_fail (GX_IS_WINDOW (self), FALSE);
+  g_return_val_if_fail (G_IS_OUTPUT_STREAM (stream), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  state.stream = stream;
+  state.cancellable = cancellable;
+  state.bytes_written = 0;
+
+  ret = read_xproperty (self, property, type, delete, G_MAXSIZE,
+			stream_write, &state,
+			actual_type ? actual_type : &tmp_type,
+			format ? format : &tmp_format,
+			&total_bytes,
+			error);
+
+  if (bytes_written)
+    *bytes_written = state.bytes_written;
+
+  return ret;
+}
+
+/* State for gx_window_convert_selection_async () */
+typedef struct
+{
+  GXWindow	*window;
+  xcb_atom_t	 selection;
+  xcb_atom_t	 property;
+  xcb_atom_t	 incr_atom;
+  GOutputStream *stream;
+  GCancellable	*cancellable;
+  gulong	 event_handler;
+  gboolean	 incr;
+
+  xcb_atom_t	 type;
+  guint8	 format;
+  gsize		 bytes_written;
+} ConvertSelectionData;
+
+static void
+convert_selection_data_free (ConvertSelectionData *data)
+{
+  g_object_unref (data->window);
+  g_object_unref (data->stream);
+  if (data->cancellable)
+    g_object_unref (data->cancellable);
+  g_slice_free (ConvertSelectionData, data);
+}
+
+static void
+convert_selection_complete (GSimpleAsyncResult *result, GError *error)
+{
+  ConvertSelectionData *data =
+    g_simple_async_result_get_op_res_gpointer (result);
+
+  g_signal_handler_disconnect (data->window, data->event_handler);
+
+  if (error)
+    {
+      g_simple_async_result_set_from_error (result, error);
+      g_error_free (error);
+    }
+
+  g_simple_async_result_complete (result);
+  g_object_unref (result);
+}
+
+static void
+convert_selection_event_cb (GXWindow *window,
+			    GXGenericEvent *event,
+			    gpointer user_data)
+{
+  GSimpleAsyncResult *result = user_data;
+  ConvertSelectionData *data =
+    g_simple_async_result_get_op_res_gpointer (result);
+  StreamWriteState state;
+  xcb_atom_t type;
+  guint8 format;
+  gsize total_bytes;
+  GError *error = NULL;
+
+  switch (event->type & GX_EVENT_CODE_MASK)
+    {
+    case XCB_SELECTION_NOTIFY:
+      {
+	xcb_selection_notify_event_t *notify =
+	  (xcb_selection_notify_event_t *)event;
+
+	if (data->incr || notify->selection != data->selection)
+	  return;
+
+	if (notify->property == XCB_ATOM_NONE)
+	  {
+	    g_set_error (&error, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+			 "The selection couldn't be converted");
+	    convert_selection_complete (result, error);
+	    return;
+	  }
+
+	/* Check whether the owner wants to use the INCR protocol before
+	 * reading any data, since the value of an INCR property is only
+	 * a lower bound on the size of the selection. */
+	if (!read_xproperty (window, data->property,
+			     XCB_GET_PROPERTY_TYPE_ANY, FALSE, 0,
+			     NULL, NULL,
+			     &type, &format, &total_bytes,
+			     &error))
+	  {
+	    convert_selection_complete (result, error);
+	    return;
+	  }
+
+	if (type == data->incr_atom)
+	  {
+	    GXConnection *connection = gx_window_get_connection (window);
+
+	    /* Deleting the property tells the owner to start sending.
+	     *
+	     * NB: We don't wait to check this request since that would
+	     * block the main loop until the server replies; any error
+	     * (which would only be BadWindow if @window has already been
+	     * destroyed) is delivered via the connection's "protocol-error"
+	     * signal instead. */
+	    data->incr = TRUE;
+	    xcb_delete_property (gx_connection_get_xcb_connection (connection),
+				 gx_drawable_get_xid (GX_DRAWABLE (window)),
+				 data->property);
+	    _gx_connection_request_queued (connection,
+					   sizeof (xcb_delete_property_request_t));
+	    gx_connection_flush (connection, FALSE);
+	    g_object_unref (connection);
+	    return;
+	  }
+	break;
+      }
+    case XCB_PROPERTY_NOTIFY:
+      {
+	xcb_property_notify_event_t *notify =
+	  (xcb_property_notify_event_t *)event;
+
+	if (!data->incr
+	    || notify->atom != data->property
+	    || notify->state != XCB_PROPERTY_NEW_VALUE)
+	  return;
+	break;
+      }
+    default:
+      return;
+    }
+
+  if (g_cancellable_set_error_if_cancelled (data->cancellable, &error))
+    {
+      convert_selection_complete (result, error);
+      return;
+    }
+
+  state.stream = data->stream;
+  state.cancellable = data->cancellable;
+  state.bytes_written = 0;
+
+  if (!read_xproperty (window, data->property,
+		       XCB_GET_PROPERTY_TYPE_ANY, TRUE, G_MAXSIZE,
+		       stream_write, &state,
+		       &type, &format, &total_bytes,
+		       &error))
+    {
+      convert_selection_complete (result, error);
+      return;
+    }
+
+  /* With INCR the first chunk determines the type, and a zero length
+   * chunk marks the end of the transfer */
+  if (!data->bytes_written)
+    {
+      data->type = type;
+      data->format = format;
+    }
+  data->bytes_written += state.bytes_written;
+
+  if (!data->incr || total_bytes == 0)
+    convert_selection_complete (result, NULL);
+}
+
+/**
+ * gx_window_convert_selection_async:
+ * @self: The requestor window
+ * @selection: The selection to convert, e.g. CLIPBOARD
+ * @target: The target to convert the selection to, e.g. UTF8_STRING
+ * @property: The property of @self that should receive the data
+ * @time: The timestamp of the event that triggered the request
+ * @stream: The stream to write the selection data to
+ * @cancellable: An optional #GCancellable
+ * @callback: A #GAsyncReadyCallback to call once finished
+ * @user_data: The data to pass to @callback
+ *
+ * Asks the owner of @selection to convert it to @target, and writes the
+ * resulting data to @stream as it arrives. Large selections sent with
+ * the INCR protocol are handled, but for that @self must have selected
+ * for XCB_EVENT_MASK_PROPERTY_CHANGE events.
+ *
+ * Call gx_window_convert_selection_finish () from @callback to get the
+ * result.
+ */
+void
+gx_window_convert_selection_async (GXWindow *self,
+				   xcb_atom_t selection,
+				   xcb_atom_t target,
+				   xcb_atom_t property,
+				   xcb_timestamp_t time,
+				   GOutputStream *stream,
+				   GCancellable *cancellable,
+				   GAsyncReadyCallback callback,
+				   gpointer user_data)
+{
+  GXConnection *connection;
+  GSimpleAsyncResult *result;
+  ConvertSelectionData *data;
+
+  g_return_if_fail (GX_IS_WINDOW (self));
+  g_return_if_fail (G_IS_OUTPUT_STREAM (stream));
+
+  connection = gx_window_get_connection (self);
+  g_return_if_fail (connection != NULL);
+
+  data = g_slice_new0 (ConvertSelectionData);
+  data->window = g_object_ref (self);
+  data->selection = selection;
+  data->property = property;
+  data->incr_atom = gx_connection_lookup_atom (connection, "INCR",
+					       FALSE, NULL);
+  data->stream = g_object_ref (stream);
+  data->cancellable = cancellable ? g_object_ref (cancellable) : NULL;
+
+  result = g_simple_async_result_new (G_OBJECT (self), callback, user_data,
+				      gx_window_convert_selection_async);
+  g_simple_async_result_set_op_res_gpointer (result, data,
+					     (GDestroyNotify)
+					     convert_selection_data_free);
+
+  /* NB: The event handler owns the reference on result until the
+   * conversion completes */
+  data->event_handler =
+    g_signal_connect (self, "event",
+		      G_CALLBACK (convert_selection_event_cb),
+		      result);
+
+  xcb_convert_selection (gx_connection_get_xcb_connection (connection),
+			 gx_drawable_get_xid (GX_DRAWABLE (self)),
+			 selection,
+			 target,
+			 property,
+			 time);
+  _gx_connection_request_queued (connection,
+				 sizeof (xcb_convert_selection_request_t));
+  gx_connection_flush (connection, FALSE);
+
+  g_object_unref (connection);
+}
+
+/**
+ * gx_window_convert_selection_finish:
+ * @self: The requestor window
+ * @result: The #GAsyncResult passed to your #GAsyncReadyCallback
+ * @type: Return location for the type of the selection data, or %NULL
+ * @format: Return location for the format of the data, or %NULL
+ * @bytes_written: Return location for the number of bytes written to
+ *		   the stream, or %NULL
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Finishes an operation started with gx_window_convert_selection_async ().
+ *
+ * Returns: %FALSE if the selection couldn't be converted
+ */
+gboolean
+gx_window_convert_selection_finish (GXWindow *self,
+				    GAsyncResult *result,
+				    xcb_atom_t *type,
+				    guint8 *format,
+				    gsize *bytes_written,
+				    GError **error)
+{
+  GSimpleAsyncResult *simple = G_SIMPLE_ASYNC_RESULT (result);
+  ConvertSelectionData *data;
+
+  g_return_val_if_fail (g_simple_async_result_get_source_tag (simple)
+			== gx_window_convert_selection_async, FALSE);
+
+  if (g_simple_async_result_propagate_error (simple, error))
+    return FALSE;
+
+  data = g_simple_async_result_get_op_res_gpointer (simple);
+  if (type)
+    *type = data->type;
+  if (format)
+    *format = data->format;
+  if (bytes_written)
+    *bytes_written = data->bytes_written;
+
+  return TRUE;
+}
+
+/* The events we need to keep a window's mirrored state up to date */
+#define GX_WINDOW_STATE_EVENT_MASK \
+  (XCB_EVENT_MASK_STRUCTURE_NOTIFY | XCB_EVENT_MASK_PROPERTY_CHANGE)
+
+/* The event codes handled by state_event_cb () */
+static GXEventCodeSet state_event_codes;
+static gboolean state_event_codes_initialized = FALSE;
+
+static void
+state_event_cb (GXWindow *self, GXGenericEvent *event, gpointer user_data)
+{
+  GXWindowState *state = self->priv->state;
+  xcb_window_t xid = gx_drawable_get_xid (GX_DRAWABLE (self));
+
+  /* Ignore events that were generated before the state was last
+   * queried, since the reply already reflects them. */
+  if ((gint32)(event->full_sequence - self->priv->state_sequence) < 0)
+    return;
+
+  switch (event->type & GX_EVENT_CODE_MASK)
+    {
+    case XCB_CONFIGURE_NOTIFY:
+      {
+	xcb_configure_notify_event_t *configure =
+	  (xcb_configure_notify_event_t *)event;
+
+	if (configure->window != xid)
+	  return;
+
+	state->x = configure->x;
+	state->y = configure->y;
+	state->width = configure->width;
+	state->height = configure->height;
+	state->border_width = configure->border_width;
+	state->override_redirect = configure->override_redirect;
+	break;
+      }
+    case XCB_GRAVITY_NOTIFY:
+      {
+	xcb_gravity_notify_event_t *gravity =
+	  (xcb_gravity_notify_event_t *)event;
+
+	if (gravity->window != xid)
+	  return;
+
+	state->x = gravity->x;
+	state->y = gravity->y;
+	break;
+      }
+    case XCB_REPARENT_NOTIFY:
+      {
+	xcb_reparent_notify_event_t *reparent =
+	  (xcb_reparent_notify_event_t *)event;
+
+	if (reparent->window != xid)
+	  return;
+
+	state->x = reparent->x;
+	state->y = reparent->y;
+	state->override_redirect = reparent->override_redirect;
+	break;
+      }
+    case XCB_MAP_NOTIFY:
+      {
+	xcb_map_notify_event_t *map = (xcb_map_notify_event_t *)event;
+
+	if (map->window != xid)
+	  return;
+
+	state->mapped = TRUE;
+	break;
+      }
+    case XCB_UNMAP_NOTIFY:
+      {
+	xcb_unmap_notify_event_t *unmap = (xcb_unmap_notify_event_t *)event;
+
+	if (unmap->window != xid)
+	  return;
+
+	state->mapped = FALSE;
+	break;
+      }
+    case XCB_DESTROY_NOTIFY:
+      {
+	xcb_destroy_notify_event_t *destroy =
+	  (xcb_destroy_notify_event_t *)event;
+
+	if (destroy->window != xid)
+	  return;
+
+	state->destroyed = TRUE;
+	state->mapped = FALSE;
+	break;
+      }
+    case XCB_PROPERTY_NOTIFY:
+      {
+	xcb_property_notify_event_t *property =
+	  (xcb_property_notify_event_t *)event;
+
+	state->property_serial++;
+	state->property_time = property->time;
+	break;
+      }
+    default:
+      break;
+    }
+}
+
+static void
+state_update_from_geometry (GXWindowState *state,
+			    xcb_get_geometry_reply_t *geometry)
+{
+  state->root = geometry->root;
+  state->x = geometry->x;
+  state->y = geometry->y;
+  state->width = geometry->width;
+  state->height = geometry->height;
+  state->border_width = geometry->border_width;
+  state->depth = geometry->depth;
+}
+
+static void
+state_update_from_attributes (GXWindowState *state,
+			      xcb_get_window_attributes_reply_t *attributes)
+{
+  state->visual = attributes->visual;
+  state->window_class = attributes->_class;
+  state->bit_gravity = attributes->bit_gravity;
+  state->win_gravity = attributes->win_gravity;
+  state->backing_store = attributes->backing_store;
+  state->mapped = attributes->map_state != XCB_MAP_STATE_UNMAPPED;
+  state->override_redirect = attributes->override_redirect;
+  state->colormap = attributes->colormap;
+  state->all_event_masks = attributes->all_event_masks;
+  state->your_event_mask = attributes->your_event_mask;
+  state->do_not_propagate_mask = attributes->do_not_propagate_mask;
+}
+
+/* Queues the requests to query a window's geometry and attributes */
+static void
+queue_window_state_query (GXConnection *connection,
+			  GXWindow *window,
+			  xcb_get_geometry_cookie_t *geometry_cookie,
+			  xcb_get_window_attributes_cookie_t *attributes_cookie)
+{
+  xcb_connection_t *xcb_connection =
+    gx_connection_get_xcb_connection (connection);
+  xcb_window_t xid = gx_drawable_get_xid (GX_DRAWABLE (window));
+
+  *geometry_cookie = xcb_get_geometry (xcb_connection, xid);
+  _gx_connection_request_queued (connection,
+				 sizeof (xcb_get_geometry_request_t));
+  *attributes_cookie = xcb_get_window_attributes (xcb_connection, xid);
+  _gx_connection_request_queued (connection,
+				 sizeof (xcb_get_window_attributes_request_t));
+
+  /* Events generated after this point will be newer than the replies */
+  window->priv->state_sequence = geometry_cookie->sequence;
+}
+
+/* Claims the replies queued by queue_window_state_query () and updates
+ * the window's state from them. Returns the attributes reply, which the
+ * caller must free, or NULL if the state couldn't be queried in which
+ * case the state is marked as stale and the error is returned in
+ * xcb_error. */
+static xcb_get_window_attributes_reply_t *
+claim_window_state (xcb_connection_t *xcb_connection,
+		    GXWindow *window,
+		    xcb_get_geometry_cookie_t geometry_cookie,
+		    xcb_get_window_attributes_cookie_t attributes_cookie,
+		    xcb_generic_error_t **xcb_error)
+{
+  GXWindowState *state = window->priv->state;
+  xcb_get_geometry_reply_t *geometry;
+  xcb_get_window_attributes_reply_t *attributes;
+  xcb_generic_error_t *geometry_error = NULL;
+  xcb_generic_error_t *attributes_error = NULL;
+
+  /* NB: We always claim both replies, even if one is an error */
+  geometry = xcb_get_geometry_reply (xcb_connection,
+				     geometry_cookie,
+				     &geometry_error);
+  attributes = xcb_get_window_attributes_reply (xcb_connection,
+						attributes_cookie,
+						&attributes_error);
+
+  if (geometry && attributes)
+    {
+      state_update_from_geometry (state, geometry);
+      state_update_from_attributes (state, attributes);
+      state->stale = FALSE;
+      free (geometry);
+      return attributes;
+    }
+
+  state->stale = TRUE;
+  if (geometry_error)
+    {
+      *xcb_error = geometry_error;
+      free (attributes_error);
+    }
+  else
+    *xcb_error = attributes_error;
+
+  free (geometry);
+  free (attributes);
+  return NULL;
+}
+
+/* Takes ownership of xcb_error. Only the first error is reported. */
+static void
+window_state_error (GError **error, gboolean *ret,
+		    xcb_generic_error_t *xcb_error)
+{
+  if (*ret)
+    *ret = set_error_from_xcb_error (error, xcb_error);
+  else
+    free (xcb_error);
+}
+
+/* Queries the geometry and attributes of all the given windows, and
+ * updates the event masks of any windows that aren't already selecting
+ * the events needed to keep their state mirrored.
+ *
+ * Something may change before a window's new event mask takes effect,
+ * so those windows are queried again. The event mask change and the
+ * second query are issued together straight after the first query's
+ * reply arrives, so in total this costs at most two round trips however
+ * many windows are given. */
+static gboolean
+query_window_states (GXConnection *connection,
+		     GXWindow **windows,
+		     int n_windows,
+		     GError **error)
+{
+  xcb_connection_t *xcb_connection =
+    gx_connection_get_xcb_connection (connection);
+  xcb_get_geometry_cookie_t *geometry_cookies;
+  xcb_get_window_attributes_cookie_t *attributes_cookies;
+  xcb_void_cookie_t *event_mask_cookies;
+  int *requery_windows;
+  int n_requeries = 0;
+  gboolean ret = TRUE;
+  int i;
+
+  geometry_cookies = g_new (xcb_get_geometry_cookie_t, n_windows);
+  attributes_cookies = g_new (xcb_get_window_attributes_cookie_t, n_windows);
+  event_mask_cookies = g_new (xcb_void_cookie_t, n_windows);
+  requery_windows = g_new (int, n_windows);
+
+  for (i = 0; i < n_windows; i++)
+    queue_window_state_query (connection, windows[i],
+			      &geometry_cookies[i], &attributes_cookies[i]);
+
+  _gx_connection_flush_for_reply (connection);
+
+  /* NB: We always claim every reply, even once we've hit an error */
+  for (i = 0; i < n_windows; i++)
+    {
+      xcb_get_window_attributes_reply_t *attributes;
+      xcb_generic_error_t *xcb_error = NULL;
+      guint32 event_mask;
+
+      attributes = claim_window_state (xcb_connection, windows[i],
+				       geometry_cookies[i],
+				       attributes_cookies[i],
+				       &xcb_error);
+      if (!attributes)
+	{
+	  window_state_error (error, &ret, xcb_error);
+	  continue;
+	}
+
+      if ((attributes->your_event_mask & GX_WINDOW_STATE_EVENT_MASK)
+	  == GX_WINDOW_STATE_EVENT_MASK)
+	{
+	  free (attributes);
+	  continue;
+	}
+
+      event_mask = attributes->your_event_mask | GX_WINDOW_STATE_EVENT_MASK;
+      free (attributes);
+
+      event_mask_cookies[n_requeries] =
+	xcb_change_window_attributes_checked (xcb_connection,
+					      gx_drawable_get_xid (
+					       GX_DRAWABLE (windows[i])),
+					      XCB_CW_EVENT_MASK,
+					      &event_mask);
+      _gx_connection_request_queued (connection,
+	sizeof (xcb_change_window_attributes_request_t) + 4);
+
+      /* NB: The cookies for the first query have been claimed so we
+       * can reuse their slots */
+      queue_window_state_query (connection, windows[i],
+				&geometry_cookies[n_requeries],
+				&attributes_cookies[n_requeries]);
+      requery_windows[n_requeries++] = i;
+    }
+
+  if (n_requeries)
+    _gx_connection_flush_for_reply (connection);
+
+  /* NB: The second query is only trusted if the event mask was really
+   * changed */
+  for (i = 0; i < n_requeries; i++)
+    {
+      GXWindow *window = windows[requery_windows[i]];
+      xcb_get_window_attributes_reply_t *attributes;
+      xcb_generic_error_t *event_mask_error;
+      xcb_generic_error_t *xcb_error = NULL;
+
+      event_mask_error = xcb_request_check (xcb_connection,
+					    event_mask_cookies[i]);
+      attributes = claim_window_state (xcb_connection, window,
+				       geometry_cookies[i],
+				       attributes_cookies[i],
+				       &xcb_error);
+      free (attributes);
+
+      if (event_mask_error)
+	{
+	  window->priv->state->stale = TRUE;
+	  window_state_error (error, &ret, event_mask_error);
+	}
+      if (xcb_error)
+	window_state_error (error, &ret, xcb_error);
+    }
+
+  g_free (geometry_cookies);
+  g_free (attributes_cookies);
+  g_free (event_mask_cookies);
+  g_free (requery_windows);
+
+  return ret;
+}
+
+/**
+ * gx_window_enable_state_mirrors:
+ * @windows: An array of windows belonging to the same connection
+ * @n_windows: The number of windows
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Starts mirroring the geometry and attributes of the given windows
+ * (See gx_window_get_state ()), or refreshes the state of windows that
+ * are already mirrored. The state of all the windows is queried with
+ * a single round trip. Windows whose event masks have to be changed
+ * (see below) are queried again along with the change, which costs
+ * one more round trip in total.
+ *
+ * The mirrored state is kept up to date from ConfigureNotify,
+ * MapNotify, UnmapNotify, PropertyNotify and DestroyNotify events, and
+ * the StructureNotify and PropertyChange event masks are added to any
+ * windows that aren't already selecting them. If the event mask of a
+ * window is changed later without these masks, or the state is changed
+ * in some way that doesn't generate an event, then the state should be
+ * invalidated and refreshed.
+ *
+ * Returns: %FALSE if the state of any window couldn't be queried, in
+ * which case its state is left marked as stale.
+ */
+gboolean
+gx_window_enable_state_mirrors (GXWindow **windows,
+				int n_windows,
+				GError **error)
+{
+  GXConnection *connection;
+  gboolean ret;
+  int i;
+
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  if (n_windows == 0)
+    return TRUE;
+
+  if (!state_event_codes_initialized)
+    {
+      gx_event_code_set_clear (&state_event_codes);
+      gx_event_code_set_add (&state_event_codes, XCB_CONFIGURE_NOTIFY);
+      gx_event_code_set_add (&state_event_codes, XCB_GRAVITY_NOTIFY);
+      gx_event_code_set_add (&state_event_codes, XCB_REPARENT_NOTIFY);
+      gx_event_code_set_add (&state_event_codes, XCB_MAP_NOTIFY);
+      gx_event_code_set_add (&state_event_codes, XCB_UNMAP_NOTIFY);
+      gx_event_code_set_add (&state_event_codes, XCB_DESTROY_NOTIFY);
+      gx_event_code_set_add (&state_event_codes, XCB_PROPERTY_NOTIFY);
+      state_event_codes_initialized = TRUE;
+    }
+
+  connection = gx_window_get_connection (windows[0]);
+  if (!connection)
+    return FALSE;
+
+  for (i = 0; i < n_windows; i++)
+    {
+      GXWindow *window = windows[i];
+
+      if (window->priv->state)
+	continue;
+
+      window->priv->state = g_slice_new0 (GXWindowState);
+      window->priv->state->stale = TRUE;
+      window->priv->state_event_handler =
+	gx_window_add_event_handler (window, &state_event_codes,
+				     state_event_cb, NULL, NULL);
+    }
+
+  ret = query_window_states (connection, windows, n_windows, error);
+
+  g_object_unref (connection);
+
+  return ret;
+}
+
+/**
+ * gx_window_enable_state_mirror:
+ * @self: A window
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Starts mirroring the state of a single window. To start mirroring
+ * many windows use gx_window_enable_state_mirrors () which only costs
+ * a single round trip.
+ *
+ * Returns: %FALSE if the window's state couldn't be queried
+ */
+gboolean
+gx_window_enable_state_mirror (GXWindow *self, GError **error)
 {
-  /* FIXME - mutex */
-  GXWindow *window = g_hash_table_lookup (xid_to_windows_map,
-					  GUINT_TO_POINTER (xid));
-  return window ? g_object_ref (window) : NULL;
+  g_return_val_if_fail (GX_IS_WINDOW (self), FALSE);
+
+  return gx_window_enable_state_mirrors (&self, 1, error);
 }
 
+/**
+ * gx_window_disable_state_mirror:
+ * @self: A window
+ *
+ * Stops mirroring the state of the window. NB: The event mask of the
+ * window is left unchanged.
+ */
+void
+gx_window_disable_state_mirror (GXWindow *self)
+{
+  g_return_if_fail (GX_IS_WINDOW (self));
+
+  if (!self->priv->state)
+    return;
+
+  gx_window_remove_event_handler (self, self->priv->state_event_handler);
+  g_slice_free (GXWindowState, self->priv->state);
+  self->priv->state = NULL;
+}
+
+/**
+ * gx_window_get_state:
+ * @self: A window
+ *
+ * Returns: The mirrored state of the window, or %NULL if the state
+ * isn't being mirrored. Check the stale flag before trusting it.
+ */
+const GXWindowState *
+gx_window_get_state (GXWindow *self)
+{
+  g_return_val_if_fail (GX_IS_WINDOW (self), NULL);
+
+  return self->priv->state;
+}
+
+/**
+ * gx_window_invalidate_state:
+ * @self: A window
+ *
+ * Marks the mirrored state of the window as stale, e.g. because its
+ * event mask was changed, until it is next refreshed.
+ */
+void
+gx_window_invalidate_state (GXWindow *self)
+{
+  g_return_if_fail (GX_IS_WINDOW (self));
+
+  if (self->priv->state)
+    self->priv->state->stale = TRUE;
+}
+
+/**
+ * gx_window_refresh_state:
+ * @self: A window
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Forces the mirrored state of the window to be queried again.
+ *
+ * Returns: %FALSE if the window's state couldn't be queried
+ */
+gboolean
+gx_window_refresh_state (GXWindow *self, GError **error)
+{
+  return gx_window_enable_state_mirror (self, error);
+}
+
+/**
+ * gx_window_snapshot_tree:
+ * @self: The window at the top of the tree
+ * @flags: #GXWindowSnapshotFlags to select what is queried for each
+ *	   window
+ * @error: Return location for a #GError, or %NULL
+ *
+ * Walks the tree of windows below @self breadth first, issuing the
+ * QueryTree requests for each level of the tree together so a whole
+ * tree costs one round trip per level instead of one per window. The
+ * geometry and attributes of each window can be queried in the same
+ * pass.
+ *
+ * The windows are returned in a flat array with @self as the first
+ * node. The children of a node are stored together, bottom-most
+ * first, so they can be walked without any per window allocations or
+ * GObjects.
+ *
+ * NB: Unless %GX_WINDOW_SNAPSHOT_GRAB_SERVER is passed, the tree may
+ * change while it is being walked. Windows that are destroyed before
+ * they are queried are marked as destroyed and stale.
+ *
+ * Returns: A new #GXWindowTree to be freed with gx_window_tree_free (),
+ * or %NULL if @self couldn't be queried.
+ */
+GXWindowTree *
+gx_window_snapshot_tree (GXWindow *self,
+			 GXWindowSnapshotFlags flags,
+			 GError **error)
+{
+  GXConnection *connection;
+  xcb_connection_t *xcb_connection;
+  GArray *nodes;
+  GXWindowTreeNode node;
+  GXWindowTree *tree;
+  guint level_start;
+  gboolean ret = TRUE;
+
+  g_return_val_if_fail (GX_IS_WINDOW (self), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  connection = gx_window_get_connection (self);
+  if (!connection)
+    return NULL;
+  xcb_connection = gx_connection_get_xcb_connection (connection);
+
+  if (flags & GX_WINDOW_SNAPSHOT_GRAB_SERVER)
+    {
+      xcb_grab_server (xcb_connection);
+      _gx_connection_request_queued (connection,
+				     sizeof (xcb_grab_server_request_t));
+    }
+
+  nodes = g_array_new (FALSE, FALSE, sizeof (GXWindowTreeNode));
+
+  memset (&node, 0, sizeof (node));
+  node.window = gx_drawable_get_xid (GX_DRAWABLE (self));
+  node.parent = -1;
+  g_array_append_val (nodes, node);
+
+  for (level_start = 0; ret && level_start < nodes->len; )
+    {
+      guint level_end = nodes->len;
+      guint n_windows = level_end - level_start;
+      xcb_query_tree_cookie_t *tree_cookies;
+      xcb_get_geometry_cookie_t *geometry_cookies = NULL;
+      xcb_get_window_attributes_cookie_t *attributes_cookies = NULL;
+      guint i;
+
+      tree_cookies = g_new (xcb_query_tree_cookie_t, n_windows);
+      if (flags & GX_WINDOW_SNAPSHOT_GEOMETRY)
+	geometry_cookies = g_new (xcb_get_geometry_cookie_t, n_windows);
+      if (flags & GX_WINDOW_SNAPSHOT_ATTRIBUTES)
+	attributes_cookies =
+	  g_new (xcb_get_window_attributes_cookie_t, n_windows);
+
+      for (i = 0; i < n_windows; i++)
+	{
+	  xcb_window_t xid =
+	    g_array_index (nodes, GXWindowTreeNode, level_start + i).window;
+
+	  tree_cookies[i] = xcb_query_tree (xcb_connection, xid);
+	  _gx_connection_request_queued (connection,
+					 sizeof (xcb_query_tree_request_t));
+	  if (geometry_cookies)
+	    {
+	      geometry_cookies[i] = xcb_get_geometry (xcb_connection, xid);
+	      _gx_connection_request_queued (connection,
+					     sizeof (xcb_get_geometry_request_t));
+	    }
+	  if (attributes_cookies)
+	    {
+	      attributes_cookies[i] =
+		xcb_get_window_attributes (xcb_connection, xid);
+	      _gx_connection_request_queued (connection,
+		sizeof (xcb_get_window_attributes_request_t));
+	    }
+	}
+
+      _gx_connection_flush_for_reply (connection);
+
+      /* NB: We always claim every reply, even if the top window
+       * couldn't be queried */
+      for (i = 0; i < n_windows; i++)
+	{
+	  guint index = level_start + i;
+	  GXWindowTreeNode *current =
+	    &g_array_index (nodes, GXWindowTreeNode, index);
+	  xcb_query_tree_reply_t *query_tree;
+	  xcb_generic_error_t *xcb_error = NULL;
+	  gboolean stale = FALSE;
+
+	  if (geometry_cookies)
+	    {
+	      xcb_get_geometry_reply_t *geometry =
+		xcb_get_geometry_reply (xcb_connection,
+					geometry_cookies[i],
+					&xcb_error);
+	      if (geometry)
+		state_update_from_geometry (&current->state, geometry);
+	      else
+		stale = TRUE;
+	      free (xcb_error);
+	      xcb_error = NULL;
+	      free (geometry);
+	    }
+	  if (attributes_cookies)
+	    {
+	      xcb_get_window_attributes_reply_t *attributes =
+		xcb_get_window_attributes_reply (xcb_connection,
+						 attributes_cookies[i],
+						 &xcb_error);
+	      if (attributes)
+		state_update_from_attributes (&current->state, attributes);
+	      else
+		stale = TRUE;
+	      free (xcb_error);
+	      xcb_error = NULL;
+	      free (attributes);
+	    }
+
+	  query_tree = xcb_query_tree_reply (xcb_connection,
+					     tree_cookies[i],
+					     &xcb_error);
+	  if (!query_tree)
+	    {
+	      if (index == 0)
+		ret = set_error_from_xcb_error (error, xcb_error);
+	      else
+		free (xcb_error);
+	      current->state.destroyed = TRUE;
+	      current->state.stale = TRUE;
+	      continue;
+	    }
+
+	  current->state.root = query_tree->root;
+	  current->state.stale = stale;
+	  current->first_child = nodes->len;
+	  current->n_children = xcb_query_tree_children_length (query_tree);
+
+	  /* NB: this may move the nodes so current can't be used after
+	   * this point */
+	  if (current->n_children)
+	    {
+	      xcb_window_t *children =
+		xcb_query_tree_children (query_tree);
+	      int j;
+
+	      memset (&node, 0, sizeof (node));
+	      node.parent = index;
+	      for (j = 0; j < xcb_query_tree_children_length (query_tree); j++)
+		{
+		  node.window = children[j];
+		  g_array_append_val (nodes, node);
+		}
+	    }
+
+	  free (query_tree);
+	}
+
+      g_free (tree_cookies);
+      g_free (geometry_cookies);
+      g_free (attributes_cookies);
+
+      level_start = level_end;
+    }
+
+  if (flags & GX_WINDOW_SNAPSHOT_GRAB_SERVER)
+    {
+      xcb_ungrab_server (xcb_connection);
+      _gx_connection_request_queued (connection,
+				     sizeof (xcb_ungrab_server_request_t));
+      gx_connection_flush (connection, FALSE);
+    }
+
+  g_object_unref (connection);
+
+  if (!ret)
+    {
+      g_array_free (nodes, TRUE);
+      return NULL;
+    }
+
+  tree = g_slice_new (GXWindowTree);
+  tree->n_nodes = nodes->len;
+  tree->nodes = (GXWindowTreeNode *)g_array_free (nodes, FALSE);
+
+  return tree;
+}
+
+/**
+ * gx_window_tree_free:
+ * @tree: A #GXWindowTree returned by gx_window_snapshot_tree ()
+ */
+void
+gx_window_tree_free (GXWindowTree *tree)
+{
+  g_free (tree->nodes);
+  g_slice_free (GXWindowTree, tree);
+}
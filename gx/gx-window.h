@@ -36,13 +36,14 @@
 
 #include <glib-object.h>
 #include <glib.h>
+#include <gio/gio.h>
 
 G_BEGIN_DECLS
 #define GX_WINDOW(obj)		  (G_TYPE_CHECK_INSTANCE_CAST ((obj), GX_TYPE_WINDOW, GXWindow))
 #define GX_TYPE_WINDOW		  (gx_window_get_type())
 #define GX_WINDOW_CLASS(klass)	  (G_TYPE_CHECK_CLASS_CAST ((klass), GX_TYPE_WINDOW, GXWindowClass))
-#define GX_IS_WINDOW(obj)	  (G_TYPE_CHECK_INSTANCE_Type ((obj), GX_TYPE_WINDOW))
-#define GX_IS_WINDOW_CLASS(klass) (G_TYPE_CHECK_CLASS_Type ((klass), GX_TYPE_WINDOW))
+#define GX_IS_WINDOW(obj)	  (G_TYPE_CHECK_INSTANCE_TYPE ((obj), GX_TYPE_WINDOW))
+#define GX_IS_WINDOW_CLASS(klass) (G_TYPE_CHECK_CLASS_TYPE ((klass), GX_TYPE_WINDOW))
 #define GX_WINDOW_GET_CLASS(obj)  (G_TYPE_INSTANCE_GET_CLASS ((obj), GX_TYPE_WINDOW, _GXWindowClass))
 
 #ifndef GX_WINDOW_TYPEDEF
@@ -74,6 +75,64 @@ struct __GXWindowClass
   void (* event) (GXConnection *object, GXGenericEvent *event);
 };
 
+/* The state of a window that's mirrored on the client side. (See
+ * gx_window_enable_state_mirrors ()) */
+typedef struct {
+  xcb_window_t	   root;
+  gint16	   x;
+  gint16	   y;
+  guint16	   width;
+  guint16	   height;
+  guint16	   border_width;
+  guint8	   depth;
+
+  xcb_visualid_t   visual;
+  guint16	   window_class;
+  guint8	   bit_gravity;
+  guint8	   win_gravity;
+  guint8	   backing_store;
+  gboolean	   mapped;
+  gboolean	   override_redirect;
+  xcb_colormap_t   colormap;
+  guint32	   all_event_masks;
+  guint32	   your_event_mask;
+  guint16	   do_not_propagate_mask;
+
+  /* Incremented for each PropertyNotify, along with the time of the
+   * latest one */
+  guint		   property_serial;
+  xcb_timestamp_t  property_time;
+
+  /* Set once a DestroyNotify has been received */
+  gboolean	   destroyed;
+  /* Set if the state may be out of date and should be refreshed */
+  gboolean	   stale;
+} GXWindowState;
+
+typedef enum {
+  GX_WINDOW_SNAPSHOT_GEOMETRY	  = 1<<0,
+  GX_WINDOW_SNAPSHOT_ATTRIBUTES	  = 1<<1,
+  /* Grab the server so the tree can't change while it's walked */
+  GX_WINDOW_SNAPSHOT_GRAB_SERVER  = 1<<2
+} GXWindowSnapshotFlags;
+
+/* A window in a tree snapshot. (See gx_window_snapshot_tree ()) */
+typedef struct {
+  xcb_window_t	   window;
+  /* The index of the parent node, or -1 for the top of the tree */
+  gint		   parent;
+  /* The children of a node are stored together in stacking order */
+  guint		   first_child;
+  guint		   n_children;
+  /* Only the fields selected by the GXWindowSnapshotFlags are valid */
+  GXWindowState	   state;
+} GXWindowTreeNode;
+
+typedef struct {
+  GXWindowTreeNode *nodes;
+  guint		    n_nodes;
+} GXWindowTree;
+
 GType gx_window_get_type (void);
 
 /* add additional methods here */
@@ -92,7 +151,89 @@ GXConnection *
 gx_window_get_connection (GXWindow *self);
 
 GXWindow *
-gx_window_find_from_xid (guint32 xid);
+gx_window_find_from_xid (GXConnection *connection, guint32 xid);
+
+typedef void (*GXWindowEventFunc) (GXWindow *window,
+				   GXGenericEvent *event,
+				   gpointer user_data);
+
+guint
+gx_window_add_event_handler (GXWindow *self,
+			     const GXEventCodeSet *codes,
+			     GXWindowEventFunc func,
+			     gpointer user_data,
+			     GDestroyNotify notify);
+
+void
+gx_window_remove_event_handler (GXWindow *self, guint id);
+
+void
+_gx_window_dispatch_event (GXWindow *self,
+			   GXGenericEvent *event,
+			   GQuark detail);
+
+gssize
+gx_window_get_xproperty_data (GXWindow *self,
+			      xcb_atom_t property,
+			      xcb_atom_t type,
+			      gboolean delete,
+			      guint8 *buffer,
+			      gsize buffer_size,
+			      xcb_atom_t *actual_type,
+			      guint8 *format,
+			      GError **error);
+
+gboolean
+gx_window_get_xproperty_to_stream (GXWindow *self,
+				   xcb_atom_t property,
+				   xcb_atom_t type,
+				   gboolean delete,
+				   GOutputStream *stream,
+				   GCancellable *cancellable,
+				   xcb_atom_t *actual_type,
+				   guint8 *format,
+				   gsize *bytes_written,
+				   GError **error);
+
+gboolean
+gx_window_enable_state_mirrors (GXWindow **windows,
+				int n_windows,
+				GError **error);
+gboolean
+gx_window_enable_state_mirror (GXWindow *self, GError **error);
+void
+gx_window_disable_state_mirror (GXWindow *self);
+const GXWindowState *
+gx_window_get_state (GXWindow *self);
+void
+gx_window_invalidate_state (GXWindow *self);
+gboolean
+gx_window_refresh_state (GXWindow *self, GError **error);
+
+GXWindowTree *
+gx_window_snapshot_tree (GXWindow *self,
+			 GXWindowSnapshotFlags flags,
+			 GError **error);
+void
+gx_window_tree_free (GXWindowTree *tree);
+
+void
+gx_window_convert_selection_async (GXWindow *self,
+				   xcb_atom_t selection,
+				   xcb_atom_t target,
+				   xcb_atom_t property,
+				   xcb_timestamp_t time,
+				   GOutputStream *stream,
+				   GCancellable *cancellable,
+				   GAsyncReadyCallback callback,
+				   gpointer user_data);
+gboolean
+gx_window_convert_selection_finish (GXWindow *self,
+				    GAsyncResult *result,
+				    xcb_atom_t *type,
+				    guint8 *format,
+				    gsize *bytes_written,
+				    GError **error);
 
 G_END_DECLS
 #endif /* GX_WINDOW_H */
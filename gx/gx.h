@@ -8,6 +8,7 @@
 #include <gx/gx-window.h>
 #include <gx/gx-gcontext.h>
 #include <gx/gx-screen.h>
+#include <gx/gx-shm-image.h>
 
 #include <glib.h>
 
@@ -0,0 +1,758 @@
+#include <gx.h>
+#include <gx/gx-cookie.h>
+#include <gx/gx-event.h>
+#include <gx/gx-pixmap.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "gx-fake-server.h"
+
+/* A suite of benchmarks for the hot paths of GX, using the GTest
+ * timers:
+ *
+ * - The rate async requests can be issued, with light cookies or
+ *   with their replies discarded
+ * - The rate requests can be issued and claimed with GXCookies vs
+ *   GXLightCookies
+ * - The round trip latency distribution of synchronous requests
+ * - The rate of serial vs pipelined requests with a simulated network
+ *   latency (fake server only)
+ * - The rate replies are delivered via a cookie's "notify::reply"
+ * - The rate events are delivered via the "event" signal, for a range
+ *   of "dispatch-batch-size" values, and via a direct handler
+ * - The memory used by each outstanding cookie
+ * - The time taken to connect and set up a connection
+ * - Walking a window tree with QueryTree per window vs
+ *   gx_window_snapshot_tree () (real server only)
+ * - The throughput of uploading and downloading images with and
+ *   without MIT-SHM (real server only)
+ *
+ * By default the benchmarks run against the in-process fake server so
+ * the results are reproducible and don't need an X server. Pass
+ * --real-server to use $DISPLAY instead. Pass --json=FILE to also write
+ * the results as JSON (use - for stdout) so they can be tracked across
+ * releases.
+ */
+
+#define N_REQUESTS	50000
+#define N_ROUND_TRIPS	2000
+#define N_PIPELINED	200
+#define REPLY_DELAY	1000 /* usecs */
+#define N_REPLIES	20000
+#define N_EVENTS	50000
+#define N_COOKIES	10000
+#define N_CONNECTIONS	20
+#define N_CHILDREN	50
+#define N_GRANDCHILDREN 40
+#define FRAME_WIDTH	1920
+#define FRAME_HEIGHT	1080
+#define N_FRAMES	60
+
+static guint batch_sizes[] = { 1, 4, 16, 64, 256, 1024 };
+
+typedef struct {
+  const char *name;
+  double      value;
+  const char *unit;
+} BenchResult;
+
+static GXConnection *connection;
+static GXFakeServer *server;
+static gboolean use_real_server = FALSE;
+static GArray *results;
+static int n_received;
+
+static void
+add_result (const char *name, double value, const char *unit)
+{
+  BenchResult result;
+
+  result.name = name;
+  result.value = value;
+  result.unit = unit;
+  g_array_append_val (results, result);
+
+  g_print ("%-28s %14.3f %s\n", name, value, unit);
+}
+
+static GXConnection *
+bench_connect (GXFakeServer **fake_server)
+{
+  GXConnection *new_connection;
+
+  if (use_real_server)
+    {
+      *fake_server = NULL;
+      new_connection = gx_connection_new (NULL);
+    }
+  else
+    {
+      *fake_server = gx_fake_server_new ();
+      new_connection = gx_fake_server_connect (*fake_server);
+    }
+
+  if (gx_connection_has_error (new_connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  return new_connection;
+}
+
+static void
+bench_request_issue_rate (void)
+{
+  static GXLightCookie *cookies[N_REQUESTS];
+  double elapsed;
+  int i;
+
+  g_test_timer_start ();
+  for (i = 0; i < N_REQUESTS; i++)
+    cookies[i] = gx_connection_get_input_focus_async_light (connection);
+  elapsed = g_test_timer_elapsed ();
+
+  for (i = 0; i < N_REQUESTS; i++)
+    gx_connection_get_input_focus_reply_free (
+      gx_connection_get_input_focus_reply_light (cookies[i], NULL));
+
+  g_test_maximized_result (N_REQUESTS / elapsed,
+			   "%.0f requests/sec", N_REQUESTS / elapsed);
+  add_result ("request_issue_rate", N_REQUESTS / elapsed, "requests/s");
+}
+
+static void
+bench_discard_issue_rate (void)
+{
+  double elapsed;
+  int i;
+
+  g_test_timer_start ();
+  for (i = 0; i < N_REQUESTS; i++)
+    gx_connection_get_input_focus_discard (connection);
+  elapsed = g_test_timer_elapsed ();
+
+  /* NB: Once we have this reply, all the discarded ones have been
+   * received too */
+  gx_connection_get_input_focus_reply_free (
+    gx_connection_get_input_focus (connection, NULL));
+
+  g_test_maximized_result (N_REQUESTS / elapsed,
+			   "%.0f requests/sec", N_REQUESTS / elapsed);
+  add_result ("discard_issue_rate", N_REQUESTS / elapsed, "requests/s");
+}
+
+/* NB: We issue all the requests before claiming any of the replies so
+ * the time is dominated by the client side cost of tracking the
+ * requests rather than round trips */
+static void
+bench_cookie_claim_rate (void)
+{
+  static GXCookie *cookies[N_REQUESTS];
+  static GXLightCookie *light_cookies[N_REQUESTS];
+  double elapsed;
+  int i;
+
+  g_test_timer_start ();
+  for (i = 0; i < N_REQUESTS; i++)
+    cookies[i] = gx_connection_get_input_focus_async (connection);
+  for (i = 0; i < N_REQUESTS; i++)
+    gx_connection_get_input_focus_reply_free (
+      gx_connection_get_input_focus_reply (cookies[i], NULL));
+  elapsed = g_test_timer_elapsed ();
+
+  add_result ("cookie_claim_rate", N_REQUESTS / elapsed, "requests/s");
+
+  g_test_timer_start ();
+  for (i = 0; i < N_REQUESTS; i++)
+    light_cookies[i] = gx_connection_get_input_focus_async_light (connection);
+  for (i = 0; i < N_REQUESTS; i++)
+    gx_connection_get_input_focus_reply_free (
+      gx_connection_get_input_focus_reply_light (light_cookies[i], NULL));
+  elapsed = g_test_timer_elapsed ();
+
+  g_test_maximized_result (N_REQUESTS / elapsed,
+			   "%.0f requests/sec", N_REQUESTS / elapsed);
+  add_result ("light_cookie_claim_rate", N_REQUESTS / elapsed, "requests/s");
+}
+
+static int
+compare_doubles (const void *a, const void *b)
+{
+  double delta = *(const double *)a - *(const double *)b;
+
+  return delta < 0 ? -1 : delta > 0 ? 1 : 0;
+}
+
+static void
+bench_round_trip_latency (void)
+{
+  double *latencies = g_new (double, N_ROUND_TRIPS);
+  int i;
+
+  for (i = 0; i < N_ROUND_TRIPS; i++)
+    {
+      GXConnectionGetInputFocusReply *reply;
+
+      g_test_timer_start ();
+      reply = gx_connection_get_input_focus (connection, NULL);
+      latencies[i] = g_test_timer_elapsed ();
+      gx_connection_get_input_focus_reply_free (reply);
+    }
+
+  qsort (latencies, N_ROUND_TRIPS, sizeof (double), compare_doubles);
+
+  g_test_minimized_result (latencies[N_ROUND_TRIPS / 2] * 1000000,
+			   "%.1fus p50 round trip",
+			   latencies[N_ROUND_TRIPS / 2] * 1000000);
+  add_result ("round_trip_p50", latencies[N_ROUND_TRIPS / 2] * 1000000, "us");
+  add_result ("round_trip_p99",
+	      latencies[N_ROUND_TRIPS * 99 / 100] * 1000000, "us");
+  add_result ("round_trip_max", latencies[N_ROUND_TRIPS - 1] * 1000000, "us");
+
+  g_free (latencies);
+}
+
+static double
+run_requests (gboolean pipelined)
+{
+  static GXLightCookie *cookies[N_PIPELINED];
+  double elapsed;
+  int i;
+
+  g_test_timer_start ();
+
+  for (i = 0; i < N_PIPELINED; i++)
+    {
+      cookies[i] = gx_connection_get_input_focus_async_light (connection);
+      if (!pipelined)
+	gx_connection_get_input_focus_reply_free (
+	  gx_connection_get_input_focus_reply_light (cookies[i], NULL));
+    }
+
+  if (pipelined)
+    for (i = 0; i < N_PIPELINED; i++)
+      gx_connection_get_input_focus_reply_free (
+	gx_connection_get_input_focus_reply_light (cookies[i], NULL));
+
+  elapsed = g_test_timer_elapsed ();
+
+  return N_PIPELINED / elapsed;
+}
+
+/* NB: This needs the fake server to simulate the network latency */
+static void
+bench_pipelined_requests (void)
+{
+  double rate;
+
+  gx_fake_server_set_reply_delay (server, REPLY_DELAY);
+
+  add_result ("serial_request_rate", run_requests (FALSE), "requests/s");
+  rate = run_requests (TRUE);
+  g_test_maximized_result (rate, "%.0f pipelined requests/sec", rate);
+  add_result ("pipelined_request_rate", rate, "requests/s");
+
+  gx_fake_server_set_reply_delay (server, 0);
+}
+
+static void
+reply_notify_cb (GXCookie *cookie, GParamSpec *pspec, gpointer user_data)
+{
+  gx_connection_get_input_focus_reply_free (
+    gx_connection_get_input_focus_reply (cookie, NULL));
+
+  if (++n_received == N_REPLIES)
+    gx_main_quit ();
+}
+
+static void
+bench_reply_notify_rate (void)
+{
+  double elapsed;
+  int i;
+
+  n_received = 0;
+
+  g_test_timer_start ();
+  for (i = 0; i < N_REPLIES; i++)
+    {
+      GXCookie *cookie = gx_connection_get_input_focus_async (connection);
+      g_signal_connect (cookie, "notify::reply",
+			G_CALLBACK (reply_notify_cb), NULL);
+    }
+  gx_connection_flush (connection, FALSE);
+  gx_main ();
+  elapsed = g_test_timer_elapsed ();
+
+  g_test_maximized_result (N_REPLIES / elapsed,
+			   "%.0f replies/sec", N_REPLIES / elapsed);
+  add_result ("reply_notify_rate", N_REPLIES / elapsed, "replies/s");
+}
+
+static void
+event_cb (GXConnection *connection,
+	  GXGenericEvent *event,
+	  gpointer user_data)
+{
+  if ((event->type & GX_EVENT_CODE_MASK) != XCB_EXPOSE)
+    return;
+
+  if (server)
+    gx_fake_server_event_received (server);
+
+  if (++n_received == N_EVENTS)
+    gx_main_quit ();
+}
+
+static GXWindow *
+event_window_new (void)
+{
+  GXWindow *root = gx_connection_get_default_root (connection);
+  GXWindow *window = gx_window_new (connection, root, 0, 0, 1, 1,
+				    GX_EVENT_MASK_EXPOSURE);
+
+  g_object_unref (root);
+  return window;
+}
+
+/* Sends N_EVENTS Expose events to the window and returns the rate they
+ * are delivered. With a real server we send synthetic events ourselves,
+ * so this works with any X server, including Xvfb. */
+static double
+run_event_storm (GXWindow *window)
+{
+  xcb_expose_event_t expose;
+  double elapsed;
+  int i;
+
+  memset (&expose, 0, sizeof (expose));
+  expose.response_type = XCB_EXPOSE;
+  expose.window = gx_drawable_get_xid (GX_DRAWABLE (window));
+
+  n_received = 0;
+
+  g_test_timer_start ();
+  if (server)
+    gx_fake_server_inject_events (server, (xcb_generic_event_t *)&expose,
+				  N_EVENTS, 0);
+  else
+    {
+      for (i = 0; i < N_EVENTS; i++)
+	xcb_send_event (gx_connection_get_xcb_connection (connection),
+			FALSE,
+			expose.window,
+			XCB_EVENT_MASK_EXPOSURE,
+			(const char *)&expose);
+      gx_connection_flush (connection, FALSE);
+    }
+  gx_main ();
+  elapsed = g_test_timer_elapsed ();
+
+  return N_EVENTS / elapsed;
+}
+
+static void
+bench_event_signal_rate (void)
+{
+  GXWindow *window = event_window_new ();
+  gulong handler;
+  guint default_batch_size;
+  double rate;
+  int i;
+
+  handler = g_signal_connect (connection, "event",
+			      G_CALLBACK (event_cb), NULL);
+
+  rate = run_event_storm (window);
+  g_test_maximized_result (rate, "%.0f events/sec", rate);
+  add_result ("event_signal_rate", rate, "events/s");
+
+  if (server)
+    {
+      GXFakeServerStats stats;
+
+      gx_fake_server_get_stats (server, &stats);
+      add_result ("event_latency_mean", stats.event_latency_mean * 1000, "ms");
+      add_result ("event_latency_max", stats.event_latency_max * 1000, "ms");
+    }
+
+  g_object_get (connection, "dispatch-batch-size", &default_batch_size, NULL);
+  for (i = 0; i < G_N_ELEMENTS (batch_sizes); i++)
+    {
+      char *name = g_strdup_printf ("event_signal_rate_batch_%u",
+				    batch_sizes[i]);
+
+      g_object_set (connection, "dispatch-batch-size", batch_sizes[i], NULL);
+      add_result (g_intern_string (name), run_event_storm (window),
+		  "events/s");
+      g_free (name);
+    }
+  g_object_set (connection, "dispatch-batch-size", default_batch_size, NULL);
+
+  g_signal_handler_disconnect (connection, handler);
+  g_object_unref (window);
+}
+
+static void
+bench_event_handler_rate (void)
+{
+  GXWindow *window = event_window_new ();
+  GXEventCodeSet codes;
+  guint handler;
+  double rate;
+
+  gx_event_code_set_clear (&codes);
+  gx_event_code_set_add (&codes, XCB_EXPOSE);
+  handler = gx_connection_add_event_handler (connection, &codes,
+					     event_cb, NULL, NULL);
+
+  rate = run_event_storm (window);
+  g_test_maximized_result (rate, "%.0f events/sec", rate);
+  add_result ("event_handler_rate", rate, "events/s");
+
+  gx_connection_remove_event_handler (connection, handler);
+  g_object_unref (window);
+}
+
+#ifdef __GLIBC__
+static gsize
+get_heap_in_use (void)
+{
+#if __GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33)
+  return mallinfo2 ().uordblks;
+#else
+  return mallinfo ().uordblks;
+#endif
+}
+
+static void
+bench_cookie_memory (void)
+{
+  static GXCookie *cookies[N_COOKIES];
+  static GXLightCookie *light_cookies[N_COOKIES];
+  gsize before;
+  gsize after;
+  int i;
+
+  before = get_heap_in_use ();
+  for (i = 0; i < N_COOKIES; i++)
+    cookies[i] = gx_connection_get_input_focus_async (connection);
+  after = get_heap_in_use ();
+  for (i = 0; i < N_COOKIES; i++)
+    gx_connection_get_input_focus_reply_free (
+      gx_connection_get_input_focus_reply (cookies[i], NULL));
+
+  add_result ("cookie_memory",
+	      (double)(after - before) / N_COOKIES, "bytes/cookie");
+
+  before = get_heap_in_use ();
+  for (i = 0; i < N_COOKIES; i++)
+    light_cookies[i] = gx_connection_get_input_focus_async_light (connection);
+  after = get_heap_in_use ();
+  for (i = 0; i < N_COOKIES; i++)
+    gx_connection_get_input_focus_reply_free (
+      gx_connection_get_input_focus_reply_light (light_cookies[i], NULL));
+
+  add_result ("light_cookie_memory",
+	      (double)(after - before) / N_COOKIES, "bytes/cookie");
+}
+#endif
+
+static void
+bench_connection_setup (void)
+{
+  double connect_time = 0;
+  double setup_time = 0;
+  int i;
+
+  for (i = 0; i < N_CONNECTIONS; i++)
+    {
+      GXFakeServer *fake_server;
+      GXConnection *new_connection = bench_connect (&fake_server);
+      GXScreen *screen;
+
+      /* NB: The screen objects are created lazily, so we include the
+       * default screen which most clients will need */
+      screen = gx_connection_get_default_screen (new_connection);
+
+      connect_time += gx_connection_get_connect_time (new_connection);
+      setup_time += gx_connection_get_setup_time (new_connection);
+
+      g_object_unref (screen);
+      g_object_unref (new_connection);
+      if (fake_server)
+	gx_fake_server_free (fake_server);
+    }
+
+  g_test_minimized_result (connect_time / N_CONNECTIONS * 1000,
+			   "%.3fms to connect",
+			   connect_time / N_CONNECTIONS * 1000);
+  add_result ("connect_time", connect_time / N_CONNECTIONS * 1000, "ms");
+  add_result ("setup_time", setup_time / N_CONNECTIONS * 1000, "ms");
+}
+
+static int
+walk_tree_serial (xcb_window_t xid)
+{
+  GXWindow *window = gx_window_find_from_xid (connection, xid);
+  GXWindowQueryTreeReply *query_tree;
+  const guint32 *children;
+  int n_children;
+  int n_windows = 1;
+  int i;
+
+  if (!window)
+    window = g_object_new (GX_TYPE_WINDOW,
+			   "connection", connection,
+			   "xid", xid,
+			   "wrap", TRUE,
+			   NULL);
+
+  query_tree = gx_window_query_tree (window, NULL);
+  children = gx_window_query_tree_peek_children (query_tree, &n_children);
+  for (i = 0; i < n_children; i++)
+    n_windows += walk_tree_serial (children[i]);
+
+  gx_window_query_tree_reply_free (query_tree);
+  g_object_unref (window);
+
+  return n_windows;
+}
+
+/* NB: This needs a real server since the fake server doesn't implement
+ * QueryTree */
+static void
+bench_query_tree (void)
+{
+  GXWindow *root;
+  GXWindow *top;
+  GPtrArray *windows;
+  GXWindowTree *tree;
+  double elapsed;
+  int n_windows;
+  int i;
+
+  root = gx_connection_get_default_root (connection);
+  top = gx_window_new (connection, root, 0, 0, 100, 100, 0);
+
+  windows = g_ptr_array_new ();
+  for (i = 0; i < N_CHILDREN; i++)
+    {
+      GXWindow *child = gx_window_new (connection, top, 0, 0, 10, 10, 0);
+      int j;
+
+      g_ptr_array_add (windows, child);
+      for (j = 0; j < N_GRANDCHILDREN; j++)
+	g_ptr_array_add (windows,
+			 gx_window_new (connection, child, 0, 0, 1, 1, 0));
+    }
+
+  g_test_timer_start ();
+  n_windows = walk_tree_serial (gx_drawable_get_xid (GX_DRAWABLE (top)));
+  elapsed = g_test_timer_elapsed ();
+  add_result ("query_tree_walk_rate", n_windows / elapsed, "windows/s");
+
+  g_test_timer_start ();
+  tree = gx_window_snapshot_tree (top, 0, NULL);
+  n_windows = tree->n_nodes;
+  gx_window_tree_free (tree);
+  elapsed = g_test_timer_elapsed ();
+  g_test_maximized_result (n_windows / elapsed,
+			   "%.0f windows/sec", n_windows / elapsed);
+  add_result ("snapshot_tree_rate", n_windows / elapsed, "windows/s");
+
+  for (i = 0; i < windows->len; i++)
+    g_object_unref (g_ptr_array_index (windows, i));
+  g_ptr_array_free (windows, TRUE);
+  g_object_unref (top);
+  g_object_unref (root);
+}
+
+/* Each frame is followed by a round trip so we measure the time until
+ * the server has actually consumed the data */
+static double
+run_put_image (GXPixmap *pixmap, GXGContext *gcontext, GXShmImage *image)
+{
+  gsize frame_size =
+    gx_shm_image_get_stride (image) * gx_shm_image_get_height (image);
+  double elapsed;
+  int i;
+
+  g_test_timer_start ();
+  for (i = 0; i < N_FRAMES; i++)
+    {
+      gx_shm_image_wait (image, NULL);
+      memset (gx_shm_image_get_data (image), i, frame_size);
+      gx_drawable_put_shm_image (GX_DRAWABLE (pixmap), gcontext, image, 0, 0);
+      gx_connection_get_input_focus_reply_free (
+	gx_connection_get_input_focus (connection, NULL));
+    }
+  elapsed = g_test_timer_elapsed ();
+
+  return (frame_size * N_FRAMES) / (elapsed * 1024 * 1024);
+}
+
+static double
+run_get_image (GXPixmap *pixmap, GXShmImage *image)
+{
+  gsize frame_size =
+    gx_shm_image_get_stride (image) * gx_shm_image_get_height (image);
+  double elapsed;
+  int i;
+
+  g_test_timer_start ();
+  for (i = 0; i < N_FRAMES; i++)
+    gx_drawable_get_shm_image (GX_DRAWABLE (pixmap), image, 0, 0, NULL);
+  elapsed = g_test_timer_elapsed ();
+
+  return (frame_size * N_FRAMES) / (elapsed * 1024 * 1024);
+}
+
+/* NB: This needs a real server since the fake server doesn't implement
+ * pixmaps or images */
+static void
+bench_shm_image (void)
+{
+  GXWindow *root;
+  GXScreen *screen;
+  guint8 depth;
+  GXPixmap *pixmap;
+  GXGContext *gcontext;
+  GXShmImage *shared;
+  GXShmImage *unshared;
+  double rate;
+
+  root = gx_connection_get_default_root (connection);
+  screen = gx_connection_get_default_screen (connection);
+  depth = gx_screen_get_root_depth (screen);
+
+  pixmap = gx_pixmap_new (connection, GX_DRAWABLE (root),
+			  FRAME_WIDTH, FRAME_HEIGHT, depth);
+  gcontext = gx_gcontext_new (connection, GX_DRAWABLE (pixmap), NULL);
+
+  shared = gx_shm_image_new (connection, FRAME_WIDTH, FRAME_HEIGHT, depth);
+  unshared = gx_shm_image_new_unshared (connection,
+					FRAME_WIDTH, FRAME_HEIGHT, depth);
+
+  if (!gx_shm_image_is_shared (shared))
+    g_test_message ("MIT-SHM isn't available; both images are unshared");
+
+  rate = run_put_image (pixmap, gcontext, shared);
+  g_test_maximized_result (rate, "%.1f MB/s ShmPutImage", rate);
+  add_result ("shm_put_image_rate", rate, "MB/s");
+  add_result ("put_image_rate", run_put_image (pixmap, gcontext, unshared),
+	      "MB/s");
+  add_result ("shm_get_image_rate", run_get_image (pixmap, shared), "MB/s");
+  add_result ("get_image_rate", run_get_image (pixmap, unshared), "MB/s");
+
+  g_object_unref (unshared);
+  g_object_unref (shared);
+  g_object_unref (gcontext);
+  g_object_unref (pixmap);
+  g_object_unref (screen);
+  g_object_unref (root);
+}
+
+static void
+write_json (const char *filename)
+{
+  FILE *file;
+  guint i;
+
+  if (strcmp (filename, "-") == 0)
+    file = stdout;
+  else if (!(file = fopen (filename, "w")))
+    {
+      g_printerr ("Failed to open %s\n", filename);
+      exit (1);
+    }
+
+  fprintf (file, "{\n");
+  fprintf (file, "  \"benchmark\": \"gx\",\n");
+  fprintf (file, "  \"version\": \"%s\",\n", GX_VERSION);
+  fprintf (file, "  \"server\": \"%s\",\n",
+	   use_real_server ? "real" : "fake");
+  fprintf (file, "  \"results\": {\n");
+  for (i = 0; i < results->len; i++)
+    {
+      BenchResult *result = &g_array_index (results, BenchResult, i);
+
+      fprintf (file, "    \"%s\": { \"value\": %.6g, \"unit\": \"%s\" }%s\n",
+	       result->name, result->value, result->unit,
+	       i + 1 < results->len ? "," : "");
+    }
+  fprintf (file, "  }\n");
+  fprintf (file, "}\n");
+
+  if (file != stdout)
+    fclose (file);
+}
+
+int
+main (int argc, char **argv)
+{
+  const char *json_filename = NULL;
+  int i;
+  int j;
+
+#ifdef __GLIBC__
+  /* So the memory used by cookies can be seen by mallinfo () */
+  g_setenv ("G_SLICE", "always-malloc", TRUE);
+#endif
+
+  /* NB: Our options are removed before GTest sees them */
+  for (i = 1, j = 1; i < argc; i++)
+    {
+      if (strcmp (argv[i], "--real-server") == 0)
+	use_real_server = TRUE;
+      else if (strncmp (argv[i], "--json=", 7) == 0)
+	json_filename = argv[i] + 7;
+      else
+	argv[j++] = argv[i];
+    }
+  argc = j;
+  argv[argc] = NULL;
+
+  g_test_init (&argc, &argv, NULL);
+  gx_init (&argc, &argv);
+
+  results = g_array_new (FALSE, FALSE, sizeof (BenchResult));
+  connection = bench_connect (&server);
+
+  g_test_add_func ("/bench/request-issue-rate", bench_request_issue_rate);
+  g_test_add_func ("/bench/discard-issue-rate", bench_discard_issue_rate);
+  g_test_add_func ("/bench/cookie-claim-rate", bench_cookie_claim_rate);
+  g_test_add_func ("/bench/round-trip-latency", bench_round_trip_latency);
+  if (server)
+    g_test_add_func ("/bench/pipelined-requests", bench_pipelined_requests);
+  g_test_add_func ("/bench/reply-notify-rate", bench_reply_notify_rate);
+  g_test_add_func ("/bench/event-signal-rate", bench_event_signal_rate);
+  g_test_add_func ("/bench/event-handler-rate", bench_event_handler_rate);
+#ifdef __GLIBC__
+  g_test_add_func ("/bench/cookie-memory", bench_cookie_memory);
+#endif
+  g_test_add_func ("/bench/connection-setup", bench_connection_setup);
+  if (use_real_server)
+    {
+      g_test_add_func ("/bench/query-tree", bench_query_tree);
+      g_test_add_func ("/bench/shm-image", bench_shm_image);
+    }
+
+  g_test_run ();
+
+  if (json_filename)
+    write_json (json_filename);
+
+  g_array_free (results, TRUE);
+  g_object_unref (connection);
+  if (server)
+    gx_fake_server_free (server);
+
+  return EXIT_SUCCESS;
+}
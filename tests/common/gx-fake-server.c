@@ -0,0 +1,1236 @@
+/*
+ * vim: tabstop=8 shiftwidth=2 noexpandtab softtabstop=2 cinoptions=>2,{2,:0,t0,(0,W4
+ *
+ * <license>
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301, USA.
+ * </license>
+ *
+ */
+
+#include "gx-fake-server.h"
+
+#include <xcb/xcb.h>
+#include <xcb/xproto.h>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <errno.h>
+#include <time.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* The resources described in the connection setup */
+#define FAKE_ROOT_XID		0x00000100
+#define FAKE_COLORMAP_XID	0x00000101
+#define FAKE_ROOT_VISUAL	0x00000102
+#define FAKE_ARGB_VISUAL	0x00000103
+#define FAKE_RESOURCE_ID_BASE	0x00200000
+#define FAKE_RESOURCE_ID_MASK	0x001fffff
+#define FAKE_SCREEN_WIDTH	1024
+#define FAKE_SCREEN_HEIGHT	768
+#define FAKE_VENDOR		"GX fake server"
+
+/* The most events a storm with no rate limit writes before the server
+ * goes back to reading requests */
+#define FAKE_STORM_BATCH	1024
+
+typedef struct {
+  gint64  due;
+  gboolean injected;
+  gsize	  length;
+  guint8  data[1];
+} FakePacket;
+
+typedef struct {
+  guint8  event[32];
+  guint	  remaining;
+  gint64  interval;
+  gint64  next_due;
+} FakeStorm;
+
+typedef struct {
+  guint8  opcode;
+  guint8  error_code;
+  guint	  remaining;
+  guint	  interval;
+  guint	  counter;
+} FakeErrorInjection;
+
+typedef struct {
+  xcb_window_t parent;
+  gint16  x;
+  gint16  y;
+  guint16 width;
+  guint16 height;
+  guint16 border_width;
+  guint8  depth;
+} FakeWindow;
+
+typedef struct {
+  GXFakeServerRequestFunc func;
+  gpointer user_data;
+} FakeRequestHandler;
+
+struct _GXFakeServer
+{
+  int		fd;
+  int		wakeup_fds[2];
+  GThread      *thread;
+
+  /* Everything below, up to the server thread state, is shared with
+   * the client's thread and protected by the mutex. */
+  GMutex       *mutex;
+  gboolean	quit;
+  guint		reply_delay;
+  FakeRequestHandler handlers[256];
+  GQueue       *storms;
+  GQueue       *error_injections;
+  GXFakeServerStats stats;
+  gdouble	event_latency_total;
+  /* The times that injected events were written, until the client
+   * reports receiving them */
+  GQueue       *event_write_times;
+
+  /* Server thread state */
+  guint32	sequence;
+  guint8	opcode;
+  GByteArray   *input;
+  GQueue       *outgoing;
+  GHashTable   *atoms;
+  GPtrArray    *atom_names;
+  GHashTable   *windows;
+};
+
+/* The predefined atoms, indexed by atom - 1 */
+static const char *predefined_atoms[] = {
+  "PRIMARY", "SECONDARY", "ARC", "ATOM", "BITMAP", "CARDINAL",
+  "COLORMAP", "CURSOR", "CUT_BUFFER0", "CUT_BUFFER1", "CUT_BUFFER2",
+  "CUT_BUFFER3", "CUT_BUFFER4", "CUT_BUFFER5", "CUT_BUFFER6",
+  "CUT_BUFFER7", "DRAWABLE", "FONT", "INTEGER", "PIXMAP", "POINT",
+  "RECTANGLE", "RESOURCE_MANAGER", "RGB_COLOR_MAP", "RGB_BEST_MAP",
+  "RGB_BLUE_MAP", "RGB_DEFAULT_MAP", "RGB_GRAY_MAP", "RGB_GREEN_MAP",
+  "RGB_RED_MAP", "STRING", "VISUALID", "WINDOW", "WM_COMMAND",
+  "WM_HINTS", "WM_CLIENT_MACHINE", "WM_ICON_NAME", "WM_ICON_SIZE",
+  "WM_NAME", "WM_NORMAL_HINTS", "WM_SIZE_HINTS", "WM_ZOOM_HINTS",
+  "MIN_SPACE", "NORM_SPACE", "MAX_SPACE", "END_SPACE", "SUPERSCRIPT_X",
+  "SUPERSCRIPT_Y", "SUBSCRIPT_X", "SUBSCRIPT_Y", "UNDERLINE_POSITION",
+  "UNDERLINE_THICKNESS", "STRIKEOUT_ASCENT", "STRIKEOUT_DESCENT",
+  "ITALIC_ANGLE", "X_HEIGHT", "QUAD_WIDTH", "WEIGHT", "POINT_SIZE",
+  "RESOLUTION", "COPYRIGHT", "NOTICE", "FONT_NAME", "FAMILY_NAME",
+  "FULL_NAME", "CAP_HEIGHT", "WM_CLASS", "WM_TRANSIENT_FOR"
+};
+
+/* The core requests that have replies. The client would wait forever
+ * if we ignored one of these, so they get an error by default. */
+static const guint8 core_reply_opcodes[] = {
+  XCB_GET_WINDOW_ATTRIBUTES, XCB_GET_GEOMETRY, XCB_QUERY_TREE,
+  XCB_INTERN_ATOM, XCB_GET_ATOM_NAME, XCB_GET_PROPERTY,
+  XCB_LIST_PROPERTIES, XCB_GET_SELECTION_OWNER, XCB_GRAB_POINTER,
+  XCB_GRAB_KEYBOARD, XCB_QUERY_POINTER, XCB_GET_MOTION_EVENTS,
+  XCB_TRANSLATE_COORDINATES, XCB_GET_INPUT_FOCUS, XCB_QUERY_KEYMAP,
+  XCB_QUERY_FONT, XCB_QUERY_TEXT_EXTENTS, XCB_LIST_FONTS,
+  XCB_LIST_FONTS_WITH_INFO, XCB_GET_FONT_PATH, XCB_GET_IMAGE,
+  XCB_LIST_INSTALLED_COLORMAPS, XCB_ALLOC_COLOR, XCB_ALLOC_NAMED_COLOR,
+  XCB_ALLOC_COLOR_CELLS, XCB_ALLOC_COLOR_PLANES, XCB_QUERY_COLORS,
+  XCB_LOOKUP_COLOR, XCB_QUERY_BEST_SIZE, XCB_QUERY_EXTENSION,
+  XCB_LIST_EXTENSIONS, XCB_GET_KEYBOARD_MAPPING,
+  XCB_GET_KEYBOARD_CONTROL, XCB_GET_POINTER_CONTROL,
+  XCB_GET_SCREEN_SAVER, XCB_LIST_HOSTS, XCB_SET_POINTER_MAPPING,
+  XCB_GET_POINTER_MAPPING, XCB_SET_MODIFIER_MAPPING,
+  XCB_GET_MODIFIER_MAPPING
+};
+
+/* NB: Like _gx_connection_timestamp () this uses a monotonic clock so
+ * the simulated latency isn't affected by changes to the wall clock */
+static gint64
+get_time_usec (void)
+{
+#if GLIB_CHECK_VERSION (2, 28, 0)
+  return g_get_monotonic_time ();
+#else
+  struct timespec now;
+
+  clock_gettime (CLOCK_MONOTONIC, &now);
+  return (gint64)now.tv_sec * G_USEC_PER_SEC + now.tv_nsec / 1000;
+#endif
+}
+
+static gboolean
+write_all (int fd, const guint8 *data, gsize length)
+{
+  while (length)
+    {
+      /* NB: We don't want a SIGPIPE if the client has gone */
+      ssize_t written = send (fd, data, length, MSG_NOSIGNAL);
+      if (written < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  return FALSE;
+	}
+      data += written;
+      length -= written;
+    }
+
+  return TRUE;
+}
+
+static gboolean
+read_all (int fd, guint8 *data, gsize length)
+{
+  while (length)
+    {
+      ssize_t n_read = read (fd, data, length);
+      if (n_read < 0 && errno == EINTR)
+	continue;
+      if (n_read <= 0)
+	return FALSE;
+      data += n_read;
+      length -= n_read;
+    }
+
+  return TRUE;
+}
+
+static void
+wakeup (GXFakeServer *server)
+{
+  guint8 byte = 0;
+
+  while (write (server->wakeup_fds[1], &byte, 1) < 0 && errno == EINTR)
+    ;
+}
+
+static void
+queue_packet (GXFakeServer *server,
+	      const guint8 *data,
+	      gsize length,
+	      gboolean injected)
+{
+  FakePacket *packet = g_malloc (sizeof (FakePacket) + length);
+
+  /* NB: Everything is delayed by the same amount so the order is kept */
+  packet->due = get_time_usec () + server->reply_delay;
+  packet->injected = injected;
+  packet->length = length;
+  memcpy (packet->data, data, length);
+  g_queue_push_tail (server->outgoing, packet);
+}
+
+/**
+ * gx_fake_server_send_reply:
+ * @server: A #GXFakeServer
+ * @reply: The reply, whose type, sequence and length fields will be
+ *	   filled in
+ * @length: The length of the reply in bytes, which will be padded to
+ *	    a multiple of 4 and at least 32
+ *
+ * Sends a reply to the request currently being handled.
+ */
+void
+gx_fake_server_send_reply (GXFakeServer *server,
+			   const void *reply,
+			   gsize length)
+{
+  gsize padded_length = MAX ((length + 3) & ~3, 32);
+  guint8 *data = g_malloc0 (padded_length);
+  xcb_generic_reply_t *header = (xcb_generic_reply_t *)data;
+
+  memcpy (data, reply, length);
+  header->response_type = 1; /* Reply */
+  header->sequence = server->sequence;
+  header->length = (padded_length - 32) / 4;
+
+  queue_packet (server, data, padded_length, FALSE);
+  g_free (data);
+
+  server->stats.n_replies++;
+}
+
+/**
+ * gx_fake_server_send_error:
+ * @server: A #GXFakeServer
+ * @error_code: The error code, such as XCB_WINDOW
+ * @resource_id: The bad resource, if any
+ *
+ * Sends an error for the request currently being handled.
+ */
+void
+gx_fake_server_send_error (GXFakeServer *server,
+			   guint8 error_code,
+			   guint32 resource_id)
+{
+  xcb_generic_error_t error;
+
+  memset (&error, 0, sizeof (error));
+  error.response_type = 0;
+  error.error_code = error_code;
+  error.sequence = server->sequence;
+  error.resource_id = resource_id;
+  error.major_code = server->opcode;
+
+  /* NB: full_sequence isn't sent over the wire */
+  queue_packet (server, (guint8 *)&error, 32, FALSE);
+
+  server->stats.n_errors++;
+}
+
+static void
+send_event (GXFakeServer *server, const void *event, gboolean injected)
+{
+  guint8 data[32];
+
+  memcpy (data, event, 32);
+
+  /* All events except KeymapNotify carry the sequence number of the
+   * last request processed */
+  if ((data[0] & GX_EVENT_CODE_MASK) != XCB_KEYMAP_NOTIFY)
+    ((xcb_generic_event_t *)data)->sequence = server->sequence;
+
+  queue_packet (server, data, 32, injected);
+
+  server->stats.n_events++;
+}
+
+/**
+ * gx_fake_server_send_event:
+ * @server: A #GXFakeServer
+ * @event: A 32 byte event
+ *
+ * Sends an event to the client, after anything already sent in
+ * response to the current request.
+ */
+void
+gx_fake_server_send_event (GXFakeServer *server, const void *event)
+{
+  send_event (server, event, FALSE);
+}
+
+static xcb_atom_t
+intern_atom (GXFakeServer *server,
+	     const char *name,
+	     gsize name_len,
+	     gboolean only_if_exists)
+{
+  char *key = g_strndup (name, name_len);
+  xcb_atom_t atom;
+
+  atom = GPOINTER_TO_UINT (g_hash_table_lookup (server->atoms, key));
+  if (atom || only_if_exists)
+    {
+      g_free (key);
+      return atom;
+    }
+
+  /* NB: atom_names is indexed by atom - 1 and owns the names */
+  g_ptr_array_add (server->atom_names, key);
+  atom = server->atom_names->len;
+  g_hash_table_insert (server->atoms, key, GUINT_TO_POINTER (atom));
+
+  return atom;
+}
+
+static void
+handle_intern_atom (GXFakeServer *server,
+		    const guint8 *request,
+		    gsize length,
+		    gpointer user_data)
+{
+  const xcb_intern_atom_request_t *intern =
+    (const xcb_intern_atom_request_t *)request;
+  xcb_intern_atom_reply_t reply;
+
+  if (sizeof (*intern) + intern->name_len > length)
+    {
+      gx_fake_server_send_error (server, XCB_LENGTH, 0);
+      return;
+    }
+
+  memset (&reply, 0, sizeof (reply));
+  reply.atom = intern_atom (server,
+			    (const char *)(intern + 1),
+			    intern->name_len,
+			    intern->only_if_exists);
+  gx_fake_server_send_reply (server, &reply, sizeof (reply));
+}
+
+static void
+handle_get_atom_name (GXFakeServer *server,
+		      const guint8 *request,
+		      gsize length,
+		      gpointer user_data)
+{
+  const xcb_get_atom_name_request_t *get =
+    (const xcb_get_atom_name_request_t *)request;
+  xcb_get_atom_name_reply_t *reply;
+  const char *name;
+  gsize name_len;
+
+  if (get->atom == XCB_ATOM_NONE || get->atom > server->atom_names->len)
+    {
+      gx_fake_server_send_error (server, XCB_ATOM, get->atom);
+      return;
+    }
+
+  name = g_ptr_array_index (server->atom_names, get->atom - 1);
+  name_len = strlen (name);
+
+  reply = g_malloc0 (sizeof (*reply) + name_len);
+  reply->name_len = name_len;
+  memcpy (reply + 1, name, name_len);
+  gx_fake_server_send_reply (server, reply, sizeof (*reply) + name_len);
+  g_free (reply);
+}
+
+static void
+handle_get_input_focus (GXFakeServer *server,
+			const guint8 *request,
+			gsize length,
+			gpointer user_data)
+{
+  xcb_get_input_focus_reply_t reply;
+
+  memset (&reply, 0, sizeof (reply));
+  reply.revert_to = XCB_INPUT_FOCUS_POINTER_ROOT;
+  reply.focus = XCB_INPUT_FOCUS_POINTER_ROOT;
+  gx_fake_server_send_reply (server, &reply, sizeof (reply));
+}
+
+static void
+handle_create_window (GXFakeServer *server,
+		      const guint8 *request,
+		      gsize length,
+		      gpointer user_data)
+{
+  const xcb_create_window_request_t *create =
+    (const xcb_create_window_request_t *)request;
+  FakeWindow *parent;
+  FakeWindow *window;
+
+  parent = g_hash_table_lookup (server->windows,
+				GUINT_TO_POINTER (create->parent));
+  if (!parent)
+    {
+      gx_fake_server_send_error (server, XCB_WINDOW, create->parent);
+      return;
+    }
+
+  window = g_slice_new (FakeWindow);
+  window->parent = create->parent;
+  window->x = create->x;
+  window->y = create->y;
+  window->width = create->width;
+  window->height = create->height;
+  window->border_width = create->border_width;
+  window->depth = create->depth ? create->depth : parent->depth;
+  g_hash_table_insert (server->windows,
+		       GUINT_TO_POINTER (create->wid), window);
+}
+
+static void
+handle_destroy_window (GXFakeServer *server,
+		       const guint8 *request,
+		       gsize length,
+		       gpointer user_data)
+{
+  const xcb_destroy_window_request_t *destroy =
+    (const xcb_destroy_window_request_t *)request;
+
+  /* NB: We don't bother destroying any children */
+  if (destroy->window != FAKE_ROOT_XID)
+    g_hash_table_remove (server->windows, GUINT_TO_POINTER (destroy->window));
+}
+
+static void
+handle_get_geometry (GXFakeServer *server,
+		     const guint8 *request,
+		     gsize length,
+		     gpointer user_data)
+{
+  const xcb_get_geometry_request_t *get =
+    (const xcb_get_geometry_request_t *)request;
+  xcb_get_geometry_reply_t reply;
+  FakeWindow *window;
+
+  window = g_hash_table_lookup (server->windows,
+				GUINT_TO_POINTER (get->drawable));
+  if (!window)
+    {
+      gx_fake_server_send_error (server, XCB_DRAWABLE, get->drawable);
+      return;
+    }
+
+  memset (&reply, 0, sizeof (reply));
+  reply.depth = window->depth;
+  reply.root = FAKE_ROOT_XID;
+  reply.x = window->x;
+  reply.y = window->y;
+  reply.width = window->width;
+  reply.height = window->height;
+  reply.border_width = window->border_width;
+  gx_fake_server_send_reply (server, &reply, sizeof (reply));
+}
+
+static void
+handle_get_property (GXFakeServer *server,
+		     const guint8 *request,
+		     gsize length,
+		     gpointer user_data)
+{
+  xcb_get_property_reply_t reply;
+
+  /* We don't store any properties, so they never exist */
+  memset (&reply, 0, sizeof (reply));
+  reply.type = XCB_ATOM_NONE;
+  gx_fake_server_send_reply (server, &reply, sizeof (reply));
+}
+
+static void
+handle_send_event (GXFakeServer *server,
+		   const guint8 *request,
+		   gsize length,
+		   gpointer user_data)
+{
+  const xcb_send_event_request_t *send =
+    (const xcb_send_event_request_t *)request;
+  guint8 event[32];
+
+  /* NB: There is only one client, which is assumed to have selected
+   * the events it sends to itself */
+  memcpy (event, send->event, 32);
+  event[0] |= 0x80;
+  send_event (server, event, FALSE);
+}
+
+static void
+handle_query_extension (GXFakeServer *server,
+			const guint8 *request,
+			gsize length,
+			gpointer user_data)
+{
+  xcb_query_extension_reply_t reply;
+
+  memset (&reply, 0, sizeof (reply));
+  reply.present = FALSE;
+  gx_fake_server_send_reply (server, &reply, sizeof (reply));
+}
+
+static void
+handle_list_extensions (GXFakeServer *server,
+			const guint8 *request,
+			gsize length,
+			gpointer user_data)
+{
+  xcb_list_extensions_reply_t reply;
+
+  memset (&reply, 0, sizeof (reply));
+  reply.names_len = 0;
+  gx_fake_server_send_reply (server, &reply, sizeof (reply));
+}
+
+static gboolean
+opcode_has_reply (guint8 opcode)
+{
+  int i;
+
+  for (i = 0; i < G_N_ELEMENTS (core_reply_opcodes); i++)
+    if (core_reply_opcodes[i] == opcode)
+      return TRUE;
+
+  return FALSE;
+}
+
+/* Called with the mutex locked */
+static gboolean
+inject_error (GXFakeServer *server)
+{
+  GList *l;
+
+  for (l = server->error_injections->head; l; l = l->next)
+    {
+      FakeErrorInjection *injection = l->data;
+
+      if (injection->opcode && injection->opcode != server->opcode)
+	continue;
+
+      if (injection->counter++ % injection->interval)
+	continue;
+
+      gx_fake_server_send_error (server, injection->error_code, 0);
+
+      if (--injection->remaining == 0)
+	{
+	  g_queue_delete_link (server->error_injections, l);
+	  g_slice_free (FakeErrorInjection, injection);
+	}
+      return TRUE;
+    }
+
+  return FALSE;
+}
+
+/* Called with the mutex locked */
+static void
+handle_request (GXFakeServer *server, const guint8 *request, gsize length)
+{
+  FakeRequestHandler *handler;
+
+  server->sequence++;
+  server->opcode = request[0];
+  server->stats.n_requests++;
+
+  if (server->error_injections->head && inject_error (server))
+    return;
+
+  handler = &server->handlers[server->opcode];
+  if (handler->func)
+    handler->func (server, request, length, handler->user_data);
+  else if (opcode_has_reply (server->opcode))
+    gx_fake_server_send_error (server, XCB_IMPLEMENTATION, 0);
+}
+
+/* Handles all the complete requests in the input buffer. Called with
+ * the mutex locked */
+static gboolean
+handle_input (GXFakeServer *server)
+{
+  GByteArray *input = server->input;
+  gsize offset = 0;
+
+  while (input->len - offset >= 4)
+    {
+      const guint8 *request = input->data + offset;
+      /* NB: The length is in 4 byte units and includes the header */
+      gsize length = *(const guint16 *)(request + 2) * 4;
+
+      /* BIG-REQUESTS is never enabled since we don't report any
+       * extensions */
+      if (length == 0)
+	return FALSE;
+      if (input->len - offset < length)
+	break;
+
+      handle_request (server, request, length);
+      offset += length;
+    }
+
+  g_byte_array_remove_range (input, 0, offset);
+
+  return TRUE;
+}
+
+/* Queues the events of any storms that are due. Returns the time the
+ * next event is due, or 0. Called with the mutex locked */
+static gint64
+run_storms (GXFakeServer *server, gint64 now)
+{
+  gint64 next_due = 0;
+  GList *l = server->storms->head;
+
+  while (l)
+    {
+      FakeStorm *storm = l->data;
+      GList *next = l->next;
+      guint n = 0;
+
+      while (storm->remaining && storm->next_due <= now
+	     && n++ < FAKE_STORM_BATCH)
+	{
+	  send_event (server, storm->event, TRUE);
+	  storm->remaining--;
+	  storm->next_due += storm->interval;
+	}
+
+      if (!storm->remaining)
+	{
+	  g_queue_delete_link (server->storms, l);
+	  g_slice_free (FakeStorm, storm);
+	}
+      else if (!next_due || storm->next_due < next_due)
+	next_due = storm->next_due;
+
+      l = next;
+    }
+
+  return next_due;
+}
+
+/* Writes all the packets that are due. Returns the time the next
+ * packet is due, or 0. */
+static gint64
+write_packets (GXFakeServer *server, gint64 now, gboolean *failed)
+{
+  GByteArray *buffer = g_byte_array_new ();
+  FakePacket *packet;
+  guint n_injected = 0;
+
+  while ((packet = g_queue_peek_head (server->outgoing))
+	 && packet->due <= now)
+    {
+      g_queue_pop_head (server->outgoing);
+      g_byte_array_append (buffer, packet->data, packet->length);
+      if (packet->injected)
+	n_injected++;
+      g_free (packet);
+    }
+
+  /* NB: The times are recorded before writing since the client may
+   * read the events before write () returns */
+  if (n_injected)
+    {
+      gint64 written = get_time_usec ();
+
+      g_mutex_lock (server->mutex);
+      while (n_injected--)
+	g_queue_push_tail (server->event_write_times,
+			   g_memdup (&written, sizeof (written)));
+      g_mutex_unlock (server->mutex);
+    }
+
+  if (buffer->len && !write_all (server->fd, buffer->data, buffer->len))
+    *failed = TRUE;
+  g_byte_array_free (buffer, TRUE);
+
+  packet = g_queue_peek_head (server->outgoing);
+  return packet ? packet->due : 0;
+}
+
+static gboolean
+send_setup (GXFakeServer *server)
+{
+  xcb_setup_request_t request;
+  GByteArray *setup = g_byte_array_new ();
+  xcb_setup_t header;
+  xcb_format_t formats[3];
+  xcb_screen_t screen;
+  xcb_depth_t depth;
+  xcb_visualtype_t visual;
+  gsize auth_length;
+  guint8 *auth;
+  guint8 pad[4] = { 0, 0, 0, 0 };
+  gboolean ret;
+
+  if (!read_all (server->fd, (guint8 *)&request, sizeof (request)))
+    return FALSE;
+
+  /* We share the client's byte order since it's in the same process */
+  if (request.byte_order != (G_BYTE_ORDER == G_LITTLE_ENDIAN ? 'l' : 'B'))
+    return FALSE;
+
+  auth_length = ((request.authorization_protocol_name_len + 3) & ~3)
+		+ ((request.authorization_protocol_data_len + 3) & ~3);
+  auth = g_malloc (auth_length + 1);
+  ret = read_all (server->fd, auth, auth_length);
+  g_free (auth);
+  if (!ret)
+    return FALSE;
+
+  memset (&header, 0, sizeof (header));
+  header.status = 1;
+  header.protocol_major_version = 11;
+  header.protocol_minor_version = 0;
+  header.release_number = 1;
+  header.resource_id_base = FAKE_RESOURCE_ID_BASE;
+  header.resource_id_mask = FAKE_RESOURCE_ID_MASK;
+  header.vendor_len = strlen (FAKE_VENDOR);
+  header.maximum_request_length = 0xffff;
+  header.roots_len = 1;
+  header.pixmap_formats_len = G_N_ELEMENTS (formats);
+  header.image_byte_order = G_BYTE_ORDER == G_LITTLE_ENDIAN
+			    ? XCB_IMAGE_ORDER_LSB_FIRST
+			    : XCB_IMAGE_ORDER_MSB_FIRST;
+  header.bitmap_format_bit_order = header.image_byte_order;
+  header.bitmap_format_scanline_unit = 32;
+  header.bitmap_format_scanline_pad = 32;
+  header.min_keycode = 8;
+  header.max_keycode = 255;
+  g_byte_array_append (setup, (guint8 *)&header, sizeof (header));
+  g_byte_array_append (setup, (guint8 *)FAKE_VENDOR, header.vendor_len);
+  g_byte_array_append (setup, pad, -header.vendor_len & 3);
+
+  memset (formats, 0, sizeof (formats));
+  formats[0].depth = 1;
+  formats[0].bits_per_pixel = 1;
+  formats[0].scanline_pad = 32;
+  formats[1].depth = 24;
+  formats[1].bits_per_pixel = 32;
+  formats[1].scanline_pad = 32;
+  formats[2].depth = 32;
+  formats[2].bits_per_pixel = 32;
+  formats[2].scanline_pad = 32;
+  g_byte_array_append (setup, (guint8 *)formats, sizeof (formats));
+
+  memset (&screen, 0, sizeof (screen));
+  screen.root = FAKE_ROOT_XID;
+  screen.default_colormap = FAKE_COLORMAP_XID;
+  screen.white_pixel = 0xffffff;
+  screen.black_pixel = 0;
+  screen.width_in_pixels = FAKE_SCREEN_WIDTH;
+  screen.height_in_pixels = FAKE_SCREEN_HEIGHT;
+  screen.width_in_millimeters = 270;
+  screen.height_in_millimeters = 203;
+  screen.min_installed_maps = 1;
+  screen.max_installed_maps = 1;
+  screen.root_visual = FAKE_ROOT_VISUAL;
+  screen.backing_stores = XCB_BACKING_STORE_NOT_USEFUL;
+  screen.root_depth = 24;
+  screen.allowed_depths_len = 3;
+  g_byte_array_append (setup, (guint8 *)&screen, sizeof (screen));
+
+  memset (&visual, 0, sizeof (visual));
+  visual._class = XCB_VISUAL_CLASS_TRUE_COLOR;
+  visual.bits_per_rgb_value = 8;
+  visual.colormap_entries = 256;
+  visual.red_mask = 0xff0000;
+  visual.green_mask = 0x00ff00;
+  visual.blue_mask = 0x0000ff;
+
+  memset (&depth, 0, sizeof (depth));
+  depth.depth = 24;
+  depth.visuals_len = 1;
+  g_byte_array_append (setup, (guint8 *)&depth, sizeof (depth));
+  visual.visual_id = FAKE_ROOT_VISUAL;
+  g_byte_array_append (setup, (guint8 *)&visual, sizeof (visual));
+
+  depth.depth = 32;
+  g_byte_array_append (setup, (guint8 *)&depth, sizeof (depth));
+  visual.visual_id = FAKE_ARGB_VISUAL;
+  g_byte_array_append (setup, (guint8 *)&visual, sizeof (visual));
+
+  depth.depth = 1;
+  depth.visuals_len = 0;
+  g_byte_array_append (setup, (guint8 *)&depth, sizeof (depth));
+
+  /* The length of everything after the first 8 bytes, in 4 byte
+   * units */
+  ((xcb_setup_t *)setup->data)->length = (setup->len - 8) / 4;
+
+  ret = write_all (server->fd, setup->data, setup->len);
+  g_byte_array_free (setup, TRUE);
+
+  return ret;
+}
+
+static gpointer
+server_thread (gpointer data)
+{
+  GXFakeServer *server = data;
+  gboolean failed = FALSE;
+
+  if (!send_setup (server))
+    return NULL;
+
+  while (!failed)
+    {
+      struct pollfd fds[2];
+      gint64 now = get_time_usec ();
+      gint64 next_storm;
+      gint64 next_packet;
+      gint64 next_due;
+      int timeout = -1;
+
+      g_mutex_lock (server->mutex);
+      if (server->quit)
+	{
+	  g_mutex_unlock (server->mutex);
+	  break;
+	}
+      next_storm = run_storms (server, now);
+      g_mutex_unlock (server->mutex);
+
+      next_packet = write_packets (server, now, &failed);
+      if (failed)
+	break;
+
+      if (next_storm && next_packet)
+	next_due = MIN (next_storm, next_packet);
+      else
+	next_due = next_storm ? next_storm : next_packet;
+      if (next_due)
+	{
+	  now = get_time_usec ();
+	  timeout = next_due > now ? (next_due - now + 999) / 1000 : 0;
+	}
+
+      fds[0].fd = server->fd;
+      fds[0].events = POLLIN;
+      fds[0].revents = 0;
+      fds[1].fd = server->wakeup_fds[0];
+      fds[1].events = POLLIN;
+      fds[1].revents = 0;
+
+      if (poll (fds, 2, timeout) < 0)
+	{
+	  if (errno == EINTR)
+	    continue;
+	  break;
+	}
+
+      if (fds[1].revents & POLLIN)
+	{
+	  guint8 buffer[64];
+
+	  if (read (server->wakeup_fds[0], buffer, sizeof (buffer)) < 0
+	      && errno != EINTR)
+	    break;
+	}
+
+      if (fds[0].revents & (POLLIN | POLLHUP | POLLERR))
+	{
+	  guint8 buffer[65536];
+	  ssize_t n_read = read (server->fd, buffer, sizeof (buffer));
+
+	  if (n_read < 0 && errno == EINTR)
+	    continue;
+
+	  /* NB: The client has disconnected if we read nothing */
+	  if (n_read <= 0)
+	    break;
+
+	  g_byte_array_append (server->input, buffer, n_read);
+
+	  g_mutex_lock (server->mutex);
+	  failed = !handle_input (server);
+	  g_mutex_unlock (server->mutex);
+	}
+    }
+
+  /* Make sure the client sees we've gone */
+  shutdown (server->fd, SHUT_RDWR);
+
+  return NULL;
+}
+
+static void
+fake_window_free (FakeWindow *window)
+{
+  g_slice_free (FakeWindow, window);
+}
+
+/**
+ * gx_fake_server_new:
+ *
+ * Creates a new fake server. It doesn't start running until a client
+ * connects with gx_fake_server_connect ().
+ */
+GXFakeServer *
+gx_fake_server_new (void)
+{
+  GXFakeServer *server = g_slice_new0 (GXFakeServer);
+  FakeWindow *root;
+  int i;
+
+  server->fd = -1;
+  if (pipe (server->wakeup_fds) < 0)
+    g_error ("Failed to create a pipe for the fake server");
+
+  server->mutex = g_mutex_new ();
+  server->storms = g_queue_new ();
+  server->error_injections = g_queue_new ();
+  server->event_write_times = g_queue_new ();
+
+  server->input = g_byte_array_new ();
+  server->outgoing = g_queue_new ();
+
+  server->atoms = g_hash_table_new (g_str_hash, g_str_equal);
+  server->atom_names = g_ptr_array_new ();
+  for (i = 0; i < G_N_ELEMENTS (predefined_atoms); i++)
+    intern_atom (server, predefined_atoms[i],
+		 strlen (predefined_atoms[i]), FALSE);
+
+  server->windows =
+    g_hash_table_new_full (g_direct_hash, g_direct_equal,
+			   NULL, (GDestroyNotify)fake_window_free);
+  root = g_slice_new0 (FakeWindow);
+  root->width = FAKE_SCREEN_WIDTH;
+  root->height = FAKE_SCREEN_HEIGHT;
+  root->depth = 24;
+  g_hash_table_insert (server->windows,
+		       GUINT_TO_POINTER (FAKE_ROOT_XID), root);
+
+  server->handlers[XCB_CREATE_WINDOW].func = handle_create_window;
+  server->handlers[XCB_DESTROY_WINDOW].func = handle_destroy_window;
+  server->handlers[XCB_GET_GEOMETRY].func = handle_get_geometry;
+  server->handlers[XCB_INTERN_ATOM].func = handle_intern_atom;
+  server->handlers[XCB_GET_ATOM_NAME].func = handle_get_atom_name;
+  server->handlers[XCB_GET_PROPERTY].func = handle_get_property;
+  server->handlers[XCB_SEND_EVENT].func = handle_send_event;
+  server->handlers[XCB_GET_INPUT_FOCUS].func = handle_get_input_focus;
+  server->handlers[XCB_QUERY_EXTENSION].func = handle_query_extension;
+  server->handlers[XCB_LIST_EXTENSIONS].func = handle_list_extensions;
+
+  return server;
+}
+
+/**
+ * gx_fake_server_connect:
+ * @server: A #GXFakeServer
+ *
+ * Starts the server running on a new thread and connects to it. A
+ * server only accepts a single connection.
+ *
+ * Returns: A new #GXConnection to the server
+ */
+GXConnection *
+gx_fake_server_connect (GXFakeServer *server)
+{
+  xcb_connection_t *xcb_connection;
+  int fds[2];
+
+  g_return_val_if_fail (server->thread == NULL, NULL);
+
+  if (socketpair (AF_UNIX, SOCK_STREAM, 0, fds) < 0)
+    g_error ("Failed to create a socketpair for the fake server");
+
+  server->fd = fds[1];
+  server->thread = g_thread_create (server_thread, server, TRUE, NULL);
+
+  /* NB: This blocks until the server thread has sent the setup */
+  xcb_connection = xcb_connect_to_fd (fds[0], NULL);
+
+  /* NB: The display only determines the preferred screen */
+  return g_object_new (GX_TYPE_CONNECTION,
+		       "display", ":0",
+		       "xcb-connection", xcb_connection,
+		       NULL);
+}
+
+/**
+ * gx_fake_server_free:
+ * @server: A #GXFakeServer
+ *
+ * Stops the server and frees it. The client should normally have
+ * disconnected already, otherwise it will see the connection close.
+ */
+void
+gx_fake_server_free (GXFakeServer *server)
+{
+  guint i;
+
+  if (server->thread)
+    {
+      g_mutex_lock (server->mutex);
+      server->quit = TRUE;
+      g_mutex_unlock (server->mutex);
+      wakeup (server);
+
+      /* NB: This also unblocks the server if it's waiting for the
+       * client to read */
+      shutdown (server->fd, SHUT_RDWR);
+      g_thread_join (server->thread);
+    }
+
+  if (server->fd >= 0)
+    close (server->fd);
+  close (server->wakeup_fds[0]);
+  close (server->wakeup_fds[1]);
+
+  g_mutex_free (server->mutex);
+
+  while (!g_queue_is_empty (server->storms))
+    g_slice_free (FakeStorm, g_queue_pop_head (server->storms));
+  g_queue_free (server->storms);
+  while (!g_queue_is_empty (server->error_injections))
+    g_slice_free (FakeErrorInjection,
+		  g_queue_pop_head (server->error_injections));
+  g_queue_free (server->error_injections);
+  while (!g_queue_is_empty (server->event_write_times))
+    g_free (g_queue_pop_head (server->event_write_times));
+  g_queue_free (server->event_write_times);
+
+  g_byte_array_free (server->input, TRUE);
+  while (!g_queue_is_empty (server->outgoing))
+    g_free (g_queue_pop_head (server->outgoing));
+  g_queue_free (server->outgoing);
+
+  g_hash_table_destroy (server->atoms);
+  for (i = 0; i < server->atom_names->len; i++)
+    g_free (g_ptr_array_index (server->atom_names, i));
+  g_ptr_array_free (server->atom_names, TRUE);
+  g_hash_table_destroy (server->windows);
+
+  g_slice_free (GXFakeServer, server);
+}
+
+/**
+ * gx_fake_server_set_request_handler:
+ * @server: A #GXFakeServer
+ * @opcode: A core request opcode
+ * @func: The function to handle the request, or %NULL to get the
+ *	  default behaviour for requests without a built in handler
+ * @user_data: Data to pass to @func
+ *
+ * Replaces the handler for a request. NB: @func is called on the
+ * server's thread.
+ */
+void
+gx_fake_server_set_request_handler (GXFakeServer *server,
+				    guint8 opcode,
+				    GXFakeServerRequestFunc func,
+				    gpointer user_data)
+{
+  g_mutex_lock (server->mutex);
+  server->handlers[opcode].func = func;
+  server->handlers[opcode].user_data = user_data;
+  g_mutex_unlock (server->mutex);
+}
+
+/**
+ * gx_fake_server_set_reply_delay:
+ * @server: A #GXFakeServer
+ * @usecs: The delay in microseconds
+ *
+ * Delays everything the server sends by @usecs to simulate the
+ * latency of a real connection. NB: Requests are still read as soon
+ * as they arrive, so pipelined requests aren't delayed cumulatively.
+ */
+void
+gx_fake_server_set_reply_delay (GXFakeServer *server, guint usecs)
+{
+  g_mutex_lock (server->mutex);
+  server->reply_delay = usecs;
+  g_mutex_unlock (server->mutex);
+}
+
+/**
+ * gx_fake_server_inject_events:
+ * @server: A #GXFakeServer
+ * @event: The event to send
+ * @count: The number of times to send it
+ * @events_per_second: The rate to send the events, or 0 to send them
+ *		       as fast as possible
+ *
+ * Starts a storm of events. Events are sent in between responses to
+ * requests with the sequence number of the last request handled.
+ */
+void
+gx_fake_server_inject_events (GXFakeServer *server,
+			      const xcb_generic_event_t *event,
+			      guint count,
+			      guint events_per_second)
+{
+  FakeStorm *storm;
+
+  if (!count)
+    return;
+
+  storm = g_slice_new (FakeStorm);
+  memcpy (storm->event, event, 32);
+  storm->remaining = count;
+  storm->interval = events_per_second ? G_USEC_PER_SEC / events_per_second : 0;
+  storm->next_due = get_time_usec ();
+
+  g_mutex_lock (server->mutex);
+  g_queue_push_tail (server->storms, storm);
+  g_mutex_unlock (server->mutex);
+
+  wakeup (server);
+}
+
+/**
+ * gx_fake_server_inject_errors:
+ * @server: A #GXFakeServer
+ * @opcode: The opcode of the requests to fail, or 0 for any request
+ * @error_code: The error to send, such as XCB_ALLOC
+ * @count: The number of requests to fail
+ * @interval: Fail one in every @interval matching requests
+ *
+ * Makes the server respond to the following matching requests with an
+ * error instead of handling them.
+ *
+ * NB: Errors for void requests the client sent unchecked (such as the
+ * earlier chunks of a split request, or requests made via XCB
+ * directly) are delivered via the connection's "protocol-error"
+ * signal.
+ */
+void
+gx_fake_server_inject_errors (GXFakeServer *server,
+			      guint8 opcode,
+			      guint8 error_code,
+			      guint count,
+			      guint interval)
+{
+  FakeErrorInjection *injection;
+
+  if (!count)
+    return;
+
+  injection = g_slice_new (FakeErrorInjection);
+  injection->opcode = opcode;
+  injection->error_code = error_code;
+  injection->remaining = count;
+  injection->interval = MAX (interval, 1);
+  injection->counter = 0;
+
+  g_mutex_lock (server->mutex);
+  g_queue_push_tail (server->error_injections, injection);
+  g_mutex_unlock (server->mutex);
+}
+
+/**
+ * gx_fake_server_event_received:
+ * @server: A #GXFakeServer
+ *
+ * Should be called by the client as it handles each event injected by
+ * gx_fake_server_inject_events () to measure the event latency. (See
+ * gx_fake_server_get_stats ())
+ */
+void
+gx_fake_server_event_received (GXFakeServer *server)
+{
+  GXFakeServerStats *stats = &server->stats;
+  gint64 now = get_time_usec ();
+  gint64 *written;
+  gdouble latency;
+
+  g_mutex_lock (server->mutex);
+
+  written = g_queue_pop_head (server->event_write_times);
+  if (written)
+    {
+      latency = (now - *written) / (gdouble)G_USEC_PER_SEC;
+      g_free (written);
+
+      if (!stats->n_events_received || latency < stats->event_latency_min)
+	stats->event_latency_min = latency;
+      if (latency > stats->event_latency_max)
+	stats->event_latency_max = latency;
+      server->event_latency_total += latency;
+      stats->n_events_received++;
+    }
+
+  g_mutex_unlock (server->mutex);
+}
+
+/**
+ * gx_fake_server_get_stats:
+ * @server: A #GXFakeServer
+ * @stats: Location to store the statistics
+ */
+void
+gx_fake_server_get_stats (GXFakeServer *server, GXFakeServerStats *stats)
+{
+  g_mutex_lock (server->mutex);
+
+  *stats = server->stats;
+  if (stats->n_events_received)
+    stats->event_latency_mean =
+      server->event_latency_total / stats->n_events_received;
+
+  g_mutex_unlock (server->mutex);
+}
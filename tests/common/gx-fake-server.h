@@ -0,0 +1,122 @@
+/*
+ * vim: tabstop=8 shiftwidth=2 noexpandtab softtabstop=2 cinoptions=>2,{2,:0,t0,(0,W4
+ *
+ * <license>
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston,
+ * MA  02110-1301, USA.
+ * </license>
+ *
+ */
+
+#ifndef GX_FAKE_SERVER_H
+#define GX_FAKE_SERVER_H
+
+#include <gx.h>
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* A minimal X server that runs on a thread of the test process and
+ * talks to a single client over a socketpair, so the tests and
+ * benchmarks can exercise GXConnection without a real $DISPLAY and
+ * without any noise from the server side.
+ *
+ * It completes the connection setup with a single 1024x768 screen and
+ * replies to a few core requests itself (InternAtom, GetAtomName,
+ * GetInputFocus, GetGeometry, GetProperty, QueryExtension and
+ * ListExtensions). No extensions are reported. SendEvent requests are
+ * echoed straight back to the client. Any other request that expects
+ * a reply gets a BadImplementation error unless a handler has been
+ * set for it, and all other requests are simply accepted.
+ */
+typedef struct _GXFakeServer GXFakeServer;
+
+/* Handlers are called on the server's thread with the whole request,
+ * and respond using gx_fake_server_send_reply (),
+ * gx_fake_server_send_error () or gx_fake_server_send_event (). */
+typedef void (*GXFakeServerRequestFunc) (GXFakeServer *server,
+					 const guint8 *request,
+					 gsize length,
+					 gpointer user_data);
+
+typedef struct {
+  guint	  n_requests;
+  guint	  n_replies;
+  guint	  n_errors;
+  guint	  n_events;
+
+  /* The time (in seconds) from injected events being written until the
+   * client reported them with gx_fake_server_event_received () */
+  guint	  n_events_received;
+  gdouble event_latency_min;
+  gdouble event_latency_max;
+  gdouble event_latency_mean;
+} GXFakeServerStats;
+
+GXFakeServer *
+gx_fake_server_new (void);
+
+GXConnection *
+gx_fake_server_connect (GXFakeServer *server);
+
+void
+gx_fake_server_free (GXFakeServer *server);
+
+void
+gx_fake_server_set_request_handler (GXFakeServer *server,
+				    guint8 opcode,
+				    GXFakeServerRequestFunc func,
+				    gpointer user_data);
+
+void
+gx_fake_server_set_reply_delay (GXFakeServer *server, guint usecs);
+
+void
+gx_fake_server_inject_events (GXFakeServer *server,
+			      const xcb_generic_event_t *event,
+			      guint count,
+			      guint events_per_second);
+
+void
+gx_fake_server_inject_errors (GXFakeServer *server,
+			      guint8 opcode,
+			      guint8 error_code,
+			      guint count,
+			      guint interval);
+
+void
+gx_fake_server_event_received (GXFakeServer *server);
+
+void
+gx_fake_server_get_stats (GXFakeServer *server, GXFakeServerStats *stats);
+
+/* For use by request handlers */
+void
+gx_fake_server_send_reply (GXFakeServer *server,
+			   const void *reply,
+			   gsize length);
+
+void
+gx_fake_server_send_error (GXFakeServer *server,
+			   guint8 error_code,
+			   guint32 resource_id);
+
+void
+gx_fake_server_send_event (GXFakeServer *server, const void *event);
+
+G_END_DECLS
+
+#endif /* GX_FAKE_SERVER_H */
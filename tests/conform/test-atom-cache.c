@@ -0,0 +1,98 @@
+
+#include <gx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-gx-common.h"
+
+static const char *atom_names[] = {
+  "WM_PROTOCOLS",
+  "WM_DELETE_WINDOW",
+  "WM_TAKE_FOCUS",
+  "_NET_WM_NAME",
+  "_NET_WM_PID",
+  "_NET_WM_STATE",
+  "_NET_WM_STATE_FULLSCREEN",
+  "_NET_WM_WINDOW_TYPE",
+  "_NET_WM_WINDOW_TYPE_NORMAL",
+  "UTF8_STRING",
+  "WM_NAME" /* A predefined atom */
+};
+
+void
+test_atom_cache (TestGXSimpleFixture *fixture,
+		 gconstpointer data)
+{
+  GXConnection *connection;
+  xcb_atom_t atoms[G_N_ELEMENTS (atom_names)];
+  xcb_atom_t atom;
+  const char *name;
+  GError *error = NULL;
+  int i;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  if (!gx_connection_lookup_atoms (connection,
+				   atom_names,
+				   G_N_ELEMENTS (atom_names),
+				   FALSE,
+				   atoms,
+				   &error))
+    {
+      g_printerr ("Failed to intern atoms: %s\n", error->message);
+      exit (1);
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (atom_names); i++)
+    {
+      if (atoms[i] == XCB_ATOM_NONE)
+	{
+	  g_printerr ("Failed to intern %s\n", atom_names[i]);
+	  exit (1);
+	}
+
+      /* These should now be answered from the cache */
+      atom = gx_connection_lookup_atom (connection, atom_names[i],
+					TRUE, NULL);
+      name = gx_connection_lookup_atom_name (connection, atoms[i], NULL);
+      if (atom != atoms[i] || !name || strcmp (name, atom_names[i]) != 0)
+	{
+	  g_printerr ("Inconsistent atom cache for %s\n", atom_names[i]);
+	  exit (1);
+	}
+    }
+
+  if (atoms[G_N_ELEMENTS (atom_names) - 1] != XCB_ATOM_WM_NAME)
+    {
+      g_printerr ("Unexpected atom for WM_NAME\n");
+      exit (1);
+    }
+
+  /* Names of atoms that weren't interned via the cache have to be
+   * fetched from the server */
+  name = gx_connection_lookup_atom_name (connection, XCB_ATOM_STRING, NULL);
+  if (!name || strcmp (name, "STRING") != 0)
+    {
+      g_printerr ("Failed to lookup the name of STRING\n");
+      exit (1);
+    }
+
+  atom = gx_connection_lookup_atom (connection,
+				    "_GX_TEST_ATOM_THAT_SHOULD_NOT_EXIST",
+				    TRUE, &error);
+  if (atom != XCB_ATOM_NONE || error)
+    {
+      g_printerr ("only_if_exists created an atom\n");
+      exit (1);
+    }
+
+  g_object_unref (connection);
+}
+
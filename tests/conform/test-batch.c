@@ -0,0 +1,97 @@
+#include <gx.h>
+#include <gx/gx-cookie.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test-gx-common.h"
+
+#define N_REQUESTS 10
+
+/* Checks the queued request counters and that requests are only
+ * flushed at the end of a batch or when an auto-flush threshold is
+ * reached, and that claiming a reply that has already been delivered
+ * doesn't make it look like newer requests were flushed. */
+
+static void
+check_queued (GXConnection *connection, guint expected, const char *what)
+{
+  guint queued = gx_connection_get_queued_requests (connection);
+
+  if (queued != expected)
+    {
+      g_printerr ("Expected %u queued requests %s, not %u\n",
+		  expected, what, queued);
+      exit (1);
+    }
+}
+
+static void
+finish_requests (GXCookie **cookies, int n_cookies)
+{
+  int i;
+
+  for (i = 0; i < n_cookies; i++)
+    {
+      GXConnectionGetInputFocusReply *reply =
+	gx_connection_get_input_focus_reply (cookies[i], NULL);
+      gx_connection_get_input_focus_reply_free (reply);
+    }
+}
+
+void
+test_batch (TestGXSimpleFixture *fixture,
+	    gconstpointer data)
+{
+  GXConnection *connection;
+  GXCookie *cookies[N_REQUESTS];
+  int i;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  g_object_set (connection, "auto-flush-requests", 4, NULL);
+
+  gx_connection_begin_batch (connection);
+  gx_connection_begin_batch (connection);
+  for (i = 0; i < N_REQUESTS; i++)
+    cookies[i] = gx_connection_get_input_focus_async (connection);
+  check_queued (connection, N_REQUESTS, "in a batch");
+  if (gx_connection_get_queued_bytes (connection) < N_REQUESTS * 4)
+    {
+      g_printerr ("Queued byte count is too small\n");
+      exit (1);
+    }
+  gx_connection_end_batch (connection);
+  check_queued (connection, N_REQUESTS, "in the outer batch");
+  gx_connection_end_batch (connection);
+  check_queued (connection, 0, "after the batch");
+  finish_requests (cookies, N_REQUESTS);
+
+  for (i = 0; i < 3; i++)
+    cookies[i] = gx_connection_get_input_focus_async (connection);
+  check_queued (connection, 3, "below the threshold");
+  cookies[3] = gx_connection_get_input_focus_async (connection);
+  check_queued (connection, 0, "at the threshold");
+  finish_requests (cookies, 4);
+
+  cookies[0] = gx_connection_get_input_focus_async (connection);
+  g_object_ref (cookies[0]);
+  gx_connection_flush (connection, FALSE);
+  while (!gx_cookie_get_reply (cookies[0]))
+    g_main_context_iteration (NULL, TRUE);
+  for (i = 1; i < 3; i++)
+    cookies[i] = gx_connection_get_input_focus_async (connection);
+  finish_requests (cookies, 1);
+  check_queued (connection, 2, "after claiming a delivered reply");
+  g_object_unref (cookies[0]);
+  finish_requests (cookies + 1, 2);
+  check_queued (connection, 0, "after waiting for replies");
+
+  g_object_unref (connection);
+}
+
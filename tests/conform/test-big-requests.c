@@ -0,0 +1,49 @@
+#include <gx.h>
+
+#include <xcb/bigreq.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test-gx-common.h"
+
+/* Checks that BIG-REQUESTS is enabled if the server supports it */
+
+void
+test_big_requests (TestGXSimpleFixture *fixture,
+		   gconstpointer data)
+{
+  GXConnection *connection;
+  const xcb_query_extension_reply_t *extension;
+  guint32 max_length;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  max_length = gx_connection_get_maximum_request_length (connection);
+
+  extension =
+    xcb_get_extension_data (gx_connection_get_xcb_connection (connection),
+			    &xcb_big_requests_id);
+  if (extension && extension->present)
+    {
+      if (max_length <= G_MAXUINT16)
+	{
+	  g_printerr ("BIG-REQUESTS wasn't enabled (max length = %u)\n",
+		      max_length);
+	  exit (1);
+	}
+    }
+  else if (max_length == 0)
+    {
+      g_printerr ("Invalid maximum request length\n");
+      exit (1);
+    }
+
+  g_object_unref (connection);
+}
+
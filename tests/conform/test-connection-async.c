@@ -0,0 +1,114 @@
+
+#include <gx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test-gx-common.h"
+
+typedef struct
+{
+  GMainLoop    *loop;
+  GXConnection *connection;
+  GError       *error;
+} ConnectState;
+
+static void
+connected_cb (GObject *source_object,
+	      GAsyncResult *result,
+	      gpointer user_data)
+{
+  ConnectState *state = user_data;
+
+  state->connection = gx_connection_new_finish (result, &state->error);
+  g_main_loop_quit (state->loop);
+}
+
+static GXConnection *
+connect_async (const char *display, GError **error)
+{
+  ConnectState state;
+
+  state.loop = g_main_loop_new (NULL, FALSE);
+  state.connection = NULL;
+  state.error = NULL;
+
+  gx_connection_new_async (display, NULL, connected_cb, &state);
+  g_main_loop_run (state.loop);
+  g_main_loop_unref (state.loop);
+
+  if (state.error)
+    g_propagate_error (error, state.error);
+  return state.connection;
+}
+
+void
+test_connection_async (TestGXSimpleFixture *fixture,
+		       gconstpointer data)
+{
+  GXConnection *connection;
+  GXScreen *screen;
+  GXWindow *root;
+  GXWindow *screen_root;
+  const GList *screens;
+  gdouble setup_time;
+  GError *error = NULL;
+
+  connection = connect_async (NULL, &error);
+  if (!connection)
+    {
+      g_printerr ("Error establishing connection to X server: %s\n",
+		  error->message);
+      exit (1);
+    }
+
+  /* The screen objects should only be created on first access */
+  setup_time = gx_connection_get_setup_time (connection);
+
+  screens = gx_connection_get_screens (connection);
+  if (!screens)
+    {
+      g_printerr ("No screens found\n");
+      exit (1);
+    }
+  if (gx_connection_get_screens (connection) != screens)
+    {
+      g_printerr ("The list of screens should be cached\n");
+      exit (1);
+    }
+
+  if (gx_connection_get_setup_time (connection) < setup_time)
+    {
+      g_printerr ("Unexpected setup time\n");
+      exit (1);
+    }
+
+  screen = gx_connection_get_default_screen (connection);
+  root = gx_connection_get_default_root (connection);
+  screen_root = gx_screen_get_root (screen);
+  if (screen_root != root)
+    {
+      g_printerr ("Default root doesn't match the default screen\n");
+      exit (1);
+    }
+  g_object_unref (screen_root);
+  g_object_unref (root);
+  g_object_unref (screen);
+
+  if (g_test_verbose ())
+    g_print ("connect = %.3fms, setup = %.3fms\n",
+	     gx_connection_get_connect_time (connection) * 1000,
+	     gx_connection_get_setup_time (connection) * 1000);
+
+  g_object_unref (connection);
+
+  /* An invalid display name should be reported via a GError */
+  connection = connect_async ("not a display::", &error);
+  if (connection || !error || error->domain != GX_CONNECTION_ERROR)
+    {
+      g_printerr ("Expected a GX_CONNECTION_ERROR for an invalid display\n");
+      exit (1);
+    }
+  g_clear_error (&error);
+}
+
@@ -0,0 +1,198 @@
+#include <gx.h>
+#include <gx/gx-cookie.h>
+#include <gx/gx-event.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-gx-common.h"
+#include "gx-fake-server.h"
+
+/* Checks the counters, queue high-water marks and latency histogram
+ * reported by gx_connection_get_stats () for requests made via light
+ * cookies, cookie objects and synchronous requests, along with errors
+ * and events, and that the "stats" signal is emitted periodically. */
+
+#define N_LIGHT_REQUESTS 100
+#define N_ASYNC_REQUESTS 50
+#define N_EVENTS 200
+
+static int n_replies = 0;
+static int n_events = 0;
+static int n_stats_signals = 0;
+
+static void
+reply_notify_cb (GXCookie *cookie, const GParamSpec *pspec, gpointer data)
+{
+  gx_connection_get_input_focus_reply_free (
+    gx_connection_get_input_focus_reply (cookie, NULL));
+
+  if (++n_replies == N_ASYNC_REQUESTS)
+    gx_main_quit ();
+}
+
+static void
+event_handler (GXConnection *connection,
+	       GXGenericEvent *event,
+	       gpointer user_data)
+{
+  if (++n_events == N_EVENTS)
+    gx_main_quit ();
+}
+
+static void
+stats_cb (GXConnection *connection,
+	  const GXConnectionStats *stats,
+	  gpointer user_data)
+{
+  n_stats_signals++;
+  gx_main_quit ();
+}
+
+void
+test_connection_stats (TestGXSimpleFixture *fixture,
+		       gconstpointer data)
+{
+  GXFakeServer *server;
+  GXConnection *connection;
+  GXWindow *root;
+  GXWindow *window;
+  GXLightCookie *light_cookies[N_LIGHT_REQUESTS];
+  GXConnectionGetInputFocusReply *reply;
+  GXConnectionStats stats;
+  GXEventCodeSet codes;
+  xcb_expose_event_t expose;
+  guint64 p50, p99;
+  GError *error = NULL;
+  int i;
+
+  server = gx_fake_server_new ();
+  connection = gx_fake_server_connect (server);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Failed to connect to the fake server\n");
+      exit (1);
+    }
+
+  root = gx_connection_get_default_root (connection);
+  window = gx_window_new (connection, root, 0, 0, 1, 1,
+			  GX_EVENT_MASK_EXPOSURE);
+
+  gx_connection_reset_stats (connection);
+
+  for (i = 0; i < N_LIGHT_REQUESTS; i++)
+    light_cookies[i] = gx_connection_get_input_focus_async_light (connection);
+  for (i = 0; i < N_LIGHT_REQUESTS; i++)
+    gx_connection_get_input_focus_reply_free (
+      gx_connection_get_input_focus_reply_light (light_cookies[i], NULL));
+
+  for (i = 0; i < N_ASYNC_REQUESTS; i++)
+    {
+      GXCookie *cookie = gx_connection_get_input_focus_async (connection);
+      g_signal_connect (cookie, "notify::reply",
+			G_CALLBACK (reply_notify_cb), NULL);
+    }
+  gx_connection_flush (connection, FALSE);
+  gx_main ();
+
+  reply = gx_connection_get_input_focus (connection, NULL);
+  gx_connection_get_input_focus_reply_free (reply);
+
+  gx_fake_server_inject_errors (server, XCB_GET_INPUT_FOCUS, XCB_ALLOC, 1, 1);
+  reply = gx_connection_get_input_focus (connection, &error);
+  if (reply || !error)
+    {
+      g_printerr ("An injected error wasn't reported\n");
+      exit (1);
+    }
+  g_clear_error (&error);
+
+  gx_event_code_set_clear (&codes);
+  gx_event_code_set_add (&codes, XCB_EXPOSE);
+  gx_connection_add_event_handler (connection, &codes,
+				   event_handler, NULL, NULL);
+
+  memset (&expose, 0, sizeof (expose));
+  expose.response_type = XCB_EXPOSE;
+  expose.window = gx_drawable_get_xid (GX_DRAWABLE (window));
+  gx_fake_server_inject_events (server, (xcb_generic_event_t *)&expose,
+				N_EVENTS, 0);
+  gx_main ();
+
+  gx_connection_get_stats (connection, &stats);
+
+  if (stats.requests < N_LIGHT_REQUESTS + N_ASYNC_REQUESTS + 2
+      || stats.replies != N_LIGHT_REQUESTS + N_ASYNC_REQUESTS + 1
+      || stats.errors != 1)
+    {
+      g_printerr ("Unexpected request counts: %" G_GUINT64_FORMAT
+		  " requests, %" G_GUINT64_FORMAT " replies, %"
+		  G_GUINT64_FORMAT " errors\n",
+		  stats.requests, stats.replies, stats.errors);
+      exit (1);
+    }
+
+  if (stats.events_by_code[XCB_EXPOSE] != N_EVENTS
+      || stats.events < N_EVENTS)
+    {
+      g_printerr ("Counted %" G_GUINT64_FORMAT " of %d events\n",
+		  stats.events_by_code[XCB_EXPOSE], N_EVENTS);
+      exit (1);
+    }
+
+  if (stats.pending_cookies != 0
+      || stats.pending_cookies_high_water < N_ASYNC_REQUESTS
+      || stats.events_queue_length != 0
+      || stats.events_queue_high_water == 0)
+    {
+      g_printerr ("Unexpected queue depths\n");
+      exit (1);
+    }
+
+  if (stats.latency_count != stats.replies + stats.errors)
+    {
+      g_printerr ("Only %" G_GUINT64_FORMAT " latencies were recorded\n",
+		  stats.latency_count);
+      exit (1);
+    }
+
+  p50 = gx_connection_stats_get_latency_percentile (&stats, 50);
+  p99 = gx_connection_stats_get_latency_percentile (&stats, 99);
+  if (p50 < stats.latency_min || p50 > p99 || p99 > stats.latency_max)
+    {
+      g_printerr ("Inconsistent latency percentiles\n");
+      exit (1);
+    }
+
+  if (g_test_verbose ())
+    g_print ("%" G_GUINT64_FORMAT " requests, %" G_GUINT64_FORMAT
+	     " flushes; latency min %" G_GUINT64_FORMAT "us p50 %"
+	     G_GUINT64_FORMAT "us p99 %" G_GUINT64_FORMAT "us max %"
+	     G_GUINT64_FORMAT "us\n",
+	     stats.requests, stats.flushes, stats.latency_min,
+	     p50, p99, stats.latency_max);
+
+  gx_connection_reset_stats (connection);
+  gx_connection_get_stats (connection, &stats);
+  if (stats.requests || stats.latency_count || stats.events)
+    {
+      g_printerr ("The stats weren't reset\n");
+      exit (1);
+    }
+
+  g_signal_connect (connection, "stats", G_CALLBACK (stats_cb), NULL);
+  g_object_set (connection, "stats-interval", 10, NULL);
+  gx_main ();
+  g_object_set (connection, "stats-interval", 0, NULL);
+  if (n_stats_signals != 1)
+    {
+      g_printerr ("The \"stats\" signal wasn't emitted\n");
+      exit (1);
+    }
+
+  g_object_unref (window);
+  g_object_unref (root);
+  g_object_unref (connection);
+  gx_fake_server_free (server);
+}
@@ -0,0 +1,100 @@
+#include <gx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-gx-common.h"
+#include "gx-fake-server.h"
+
+/* Checks that requests issued via the gx_*_discard () functions reach
+ * the server without any cookies being registered, and that neither
+ * their replies nor their errors are ever delivered. */
+
+#define N_REQUESTS 100
+
+static int n_events = 0;
+
+static void
+event_cb (GXConnection *connection,
+	  GXGenericEvent *event,
+	  gpointer user_data)
+{
+  n_events++;
+}
+
+void
+test_discard_reply (TestGXSimpleFixture *fixture,
+		    gconstpointer data)
+{
+  GXFakeServer *server;
+  GXConnection *connection;
+  GXConnectionGetInputFocusReply *reply;
+  GXConnectionStats stats;
+  GXFakeServerStats server_stats;
+  const char *name = "_GX_DISCARD";
+  guint n_server_errors;
+  int i;
+
+  server = gx_fake_server_new ();
+  connection = gx_fake_server_connect (server);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Failed to connect to the fake server\n");
+      exit (1);
+    }
+
+  g_signal_connect (connection, "event", G_CALLBACK (event_cb), NULL);
+  gx_connection_reset_stats (connection);
+  gx_fake_server_get_stats (server, &server_stats);
+  n_server_errors = server_stats.n_errors;
+
+  /* NB: The first of these gets an error, which should be discarded
+   * too rather than being reported as an event */
+  gx_fake_server_inject_errors (server, XCB_INTERN_ATOM, XCB_ALLOC,
+				1, N_REQUESTS);
+  for (i = 0; i < N_REQUESTS; i++)
+    gx_connection_intern_atom_discard (connection, FALSE,
+				       strlen (name), name);
+
+  /* Since the server replies in order, once we have this reply all
+   * the discarded ones have been received too */
+  reply = gx_connection_get_input_focus (connection, NULL);
+  if (!reply)
+    {
+      g_printerr ("Failed to get a reply after discarding replies\n");
+      exit (1);
+    }
+  gx_connection_get_input_focus_reply_free (reply);
+
+  /* Give the mainloop a chance to dispatch anything that was queued */
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+
+  gx_connection_get_stats (connection, &stats);
+  if (stats.requests != N_REQUESTS + 1
+      || stats.replies != 1
+      || stats.errors != 0
+      || stats.pending_cookies_high_water != 0
+      || stats.response_queue_high_water != 0)
+    {
+      g_printerr ("Discarded requests left client side state behind\n");
+      exit (1);
+    }
+
+  if (n_events != 0)
+    {
+      g_printerr ("A discarded error was delivered as an event\n");
+      exit (1);
+    }
+
+  gx_fake_server_get_stats (server, &server_stats);
+  if (server_stats.n_errors != n_server_errors + 1)
+    {
+      g_printerr ("The injected error wasn't sent\n");
+      exit (1);
+    }
+
+  g_object_unref (connection);
+  gx_fake_server_free (server);
+}
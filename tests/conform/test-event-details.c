@@ -0,0 +1,113 @@
+#include <gx.h>
+#include <gx/gx-event.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-gx-common.h"
+
+#define N_EVENTS 10
+
+/* This sends some synthetic Expose events to a window and checks they
+ * are delivered via detailed "event" signals on both the connection
+ * and the window. Synthetic events have the top bit of their type set,
+ * which must be masked out when looking up the event details. */
+
+static int n_connection_events = 0;
+static int n_window_events = 0;
+
+static void
+connection_event_handler (GXConnection *connection,
+			  GXGenericEvent *event,
+			  gpointer user_data)
+{
+  if ((event->type & GX_EVENT_CODE_MASK) != XCB_EXPOSE)
+    {
+      g_printerr ("Unexpected event type %d for detail %s\n",
+		  event->type, (const char *)user_data);
+      exit (1);
+    }
+
+  if (++n_connection_events == N_EVENTS)
+    gx_main_quit ();
+}
+
+static void
+window_event_handler (GXWindow *window,
+		      GXGenericEvent *event,
+		      gpointer user_data)
+{
+  n_window_events++;
+}
+
+void
+test_event_details (TestGXSimpleFixture *fixture,
+		    gconstpointer data)
+{
+  GXConnection *connection;
+  GXWindow *root;
+  GXWindow *window;
+  GXGenericEvent name_lookup;
+  xcb_expose_event_t expose;
+  const char *name;
+  char *detailed_signal;
+  int i;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  root = gx_connection_get_default_root (connection);
+  window = gx_window_new (connection,
+			  root,
+			  0, 0, 1, 1,
+			  GX_EVENT_MASK_EXPOSURE);
+
+  memset (&name_lookup, 0, sizeof (name_lookup));
+  name_lookup.type = XCB_EXPOSE;
+  name = gx_event_get_name (&name_lookup);
+  detailed_signal = g_strdup_printf ("event::%s", name);
+
+  g_signal_connect (connection,
+		    detailed_signal,
+		    G_CALLBACK (connection_event_handler),
+		    (gpointer)name);
+  g_signal_connect (window,
+		    detailed_signal,
+		    G_CALLBACK (window_event_handler),
+		    NULL);
+  g_free (detailed_signal);
+
+  memset (&expose, 0, sizeof (expose));
+  expose.response_type = XCB_EXPOSE;
+  expose.window = gx_drawable_get_xid (GX_DRAWABLE (window));
+  expose.width = 1;
+  expose.height = 1;
+
+  for (i = 0; i < N_EVENTS; i++)
+    xcb_send_event (gx_connection_get_xcb_connection (connection),
+		    FALSE,
+		    expose.window,
+		    XCB_EVENT_MASK_EXPOSURE,
+		    (const char *)&expose);
+
+  gx_connection_flush (connection, FALSE);
+
+  gx_main ();
+
+  if (n_window_events != N_EVENTS)
+    {
+      g_printerr ("Only %d of %d events were delivered to the window\n",
+		  n_window_events, N_EVENTS);
+      exit (1);
+    }
+
+  g_object_unref (window);
+  g_object_unref (root);
+  g_object_unref (connection);
+}
+
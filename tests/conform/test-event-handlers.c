@@ -0,0 +1,142 @@
+#include <gx.h>
+#include <gx/gx-event.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-gx-common.h"
+
+/* This sends some synthetic Expose events to a window and checks they
+ * are delivered to handlers added directly to the connection and the
+ * window, but only if the handler selected Expose events. It also
+ * checks a handler can remove itself while events are dispatched. */
+
+#define N_EVENTS 10
+
+static int n_connection_events = 0;
+static int n_window_events = 0;
+static int n_key_press_events = 0;
+static int n_once_events = 0;
+static guint once_handler_id;
+
+static void
+connection_event_handler (GXConnection *connection,
+			  GXGenericEvent *event,
+			  gpointer user_data)
+{
+  if ((event->type & GX_EVENT_CODE_MASK) != XCB_EXPOSE)
+    {
+      g_printerr ("Unexpected event type %d\n", event->type);
+      exit (1);
+    }
+
+  if (++n_connection_events == N_EVENTS)
+    gx_main_quit ();
+}
+
+static void
+key_press_event_handler (GXConnection *connection,
+			 GXGenericEvent *event,
+			 gpointer user_data)
+{
+  n_key_press_events++;
+}
+
+static void
+window_event_handler (GXWindow *window,
+		      GXGenericEvent *event,
+		      gpointer user_data)
+{
+  n_window_events++;
+}
+
+static void
+once_event_handler (GXWindow *window,
+		    GXGenericEvent *event,
+		    gpointer user_data)
+{
+  n_once_events++;
+  gx_window_remove_event_handler (window, once_handler_id);
+}
+
+void
+test_event_handlers (TestGXSimpleFixture *fixture,
+		     gconstpointer data)
+{
+  GXConnection *connection;
+  GXWindow *root;
+  GXWindow *window;
+  GXEventCodeSet codes;
+  xcb_expose_event_t expose;
+  int i;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  root = gx_connection_get_default_root (connection);
+  window = gx_window_new (connection,
+			  root,
+			  0, 0, 1, 1,
+			  GX_EVENT_MASK_EXPOSURE);
+
+  gx_event_code_set_clear (&codes);
+  gx_event_code_set_add (&codes, XCB_EXPOSE);
+  gx_connection_add_event_handler (connection, &codes,
+				   connection_event_handler, NULL, NULL);
+
+  gx_event_code_set_clear (&codes);
+  gx_event_code_set_add (&codes, XCB_KEY_PRESS);
+  gx_connection_add_event_handler (connection, &codes,
+				   key_press_event_handler, NULL, NULL);
+
+  gx_window_add_event_handler (window, NULL,
+			       window_event_handler, NULL, NULL);
+  once_handler_id =
+    gx_window_add_event_handler (window, NULL,
+				 once_event_handler, NULL, NULL);
+
+  memset (&expose, 0, sizeof (expose));
+  expose.response_type = XCB_EXPOSE;
+  expose.window = gx_drawable_get_xid (GX_DRAWABLE (window));
+  expose.width = 1;
+  expose.height = 1;
+
+  for (i = 0; i < N_EVENTS; i++)
+    xcb_send_event (gx_connection_get_xcb_connection (connection),
+		    FALSE,
+		    expose.window,
+		    XCB_EVENT_MASK_EXPOSURE,
+		    (const char *)&expose);
+
+  gx_connection_flush (connection, FALSE);
+
+  gx_main ();
+
+  if (n_window_events != N_EVENTS)
+    {
+      g_printerr ("Only %d of %d events were delivered to the window\n",
+		  n_window_events, N_EVENTS);
+      exit (1);
+    }
+  if (n_key_press_events != 0)
+    {
+      g_printerr ("Events were delivered to a handler that didn't "
+		  "select them\n");
+      exit (1);
+    }
+  if (n_once_events != 1)
+    {
+      g_printerr ("A handler that removed itself got %d events\n",
+		  n_once_events);
+      exit (1);
+    }
+
+  g_object_unref (window);
+  g_object_unref (root);
+  g_object_unref (connection);
+}
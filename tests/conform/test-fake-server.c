@@ -0,0 +1,112 @@
+#include <gx.h>
+#include <gx/gx-event.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-gx-common.h"
+#include "gx-fake-server.h"
+
+/* This runs against the in-process fake server, so unlike the other
+ * tests it doesn't need an X server. It checks that a GXConnection
+ * can be set up, that replies and injected errors are delivered and
+ * that a storm of injected events is dispatched in full. */
+
+#define N_EVENTS 5000
+
+static int n_events = 0;
+
+static void
+event_handler (GXConnection *connection,
+	       GXGenericEvent *event,
+	       gpointer user_data)
+{
+  GXFakeServer *server = user_data;
+
+  gx_fake_server_event_received (server);
+
+  if (++n_events == N_EVENTS)
+    gx_main_quit ();
+}
+
+void
+test_fake_server (TestGXSimpleFixture *fixture,
+		  gconstpointer data)
+{
+  GXFakeServer *server;
+  GXConnection *connection;
+  GXWindow *root;
+  GXWindow *window;
+  GXEventCodeSet codes;
+  GXFakeServerStats stats;
+  xcb_expose_event_t expose;
+  xcb_atom_t atom;
+  const char *name;
+  GError *error = NULL;
+
+  server = gx_fake_server_new ();
+  connection = gx_fake_server_connect (server);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Failed to connect to the fake server\n");
+      exit (1);
+    }
+
+  root = gx_connection_get_default_root (connection);
+  window = gx_window_new (connection, root, 0, 0, 1, 1,
+			  GX_EVENT_MASK_EXPOSURE);
+
+  atom = gx_connection_lookup_atom (connection, "_GX_FAKE", FALSE, &error);
+  name = gx_connection_lookup_atom_name (connection, atom, &error);
+  if (atom == XCB_ATOM_NONE || !name || strcmp (name, "_GX_FAKE") != 0)
+    {
+      g_printerr ("Failed to intern an atom with the fake server\n");
+      exit (1);
+    }
+
+  gx_fake_server_inject_errors (server, XCB_INTERN_ATOM, XCB_ALLOC, 1, 1);
+  atom = gx_connection_lookup_atom (connection, "_GX_FAKE_ERROR",
+				    FALSE, &error);
+  if (atom != XCB_ATOM_NONE || !error)
+    {
+      g_printerr ("An injected error wasn't reported\n");
+      exit (1);
+    }
+  g_clear_error (&error);
+
+  gx_event_code_set_clear (&codes);
+  gx_event_code_set_add (&codes, XCB_EXPOSE);
+  gx_connection_add_event_handler (connection, &codes,
+				   event_handler, server, NULL);
+
+  memset (&expose, 0, sizeof (expose));
+  expose.response_type = XCB_EXPOSE;
+  expose.window = gx_drawable_get_xid (GX_DRAWABLE (window));
+  gx_fake_server_inject_events (server, (xcb_generic_event_t *)&expose,
+				N_EVENTS, 0);
+
+  gx_main ();
+
+  gx_fake_server_get_stats (server, &stats);
+  if (stats.n_events_received != N_EVENTS)
+    {
+      g_printerr ("Only %u of %d injected events were received\n",
+		  stats.n_events_received, N_EVENTS);
+      exit (1);
+    }
+
+  if (g_test_verbose ())
+    g_print ("%u requests, %u replies, %u errors, %u events; "
+	     "event latency min %.3fms mean %.3fms max %.3fms\n",
+	     stats.n_requests, stats.n_replies, stats.n_errors,
+	     stats.n_events,
+	     stats.event_latency_min * 1000,
+	     stats.event_latency_mean * 1000,
+	     stats.event_latency_max * 1000);
+
+  g_object_unref (window);
+  g_object_unref (root);
+  g_object_unref (connection);
+  gx_fake_server_free (server);
+}
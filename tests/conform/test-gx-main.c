@@ -49,6 +49,26 @@ main (int argc, char **argv)
   TEST_GX_SIMPLE ("", test_cookie_life_cycle);
   TEST_GX_SIMPLE ("", test_gerrors);
   TEST_GX_SIMPLE ("", test_screen_info);
+  TEST_GX_SIMPLE ("", test_pipelined_replies);
+  TEST_GX_SIMPLE ("", test_event_details);
+  TEST_GX_SIMPLE ("", test_xid_registry);
+  TEST_GX_SIMPLE ("", test_reply_peek);
+  TEST_GX_SIMPLE ("", test_batch);
+  TEST_GX_SIMPLE ("", test_shm_image);
+  TEST_GX_SIMPLE ("", test_big_requests);
+  TEST_GX_SIMPLE ("", test_connection_async);
+  TEST_GX_SIMPLE ("", test_visual_index);
+  TEST_GX_SIMPLE ("", test_atom_cache);
+  TEST_GX_SIMPLE ("", test_xproperty);
+  TEST_GX_SIMPLE ("", test_window_state);
+  TEST_GX_SIMPLE ("", test_window_tree);
+  TEST_GX_SIMPLE ("", test_event_handlers);
+  TEST_GX_SIMPLE ("", test_fake_server);
+  TEST_GX_SIMPLE ("", test_connection_stats);
+  TEST_GX_SIMPLE ("", test_unclaimed_replies);
+  TEST_GX_SIMPLE ("", test_discard_reply);
+  TEST_GX_SIMPLE ("", test_unchecked_errors);
+  TEST_GX_SIMPLE ("", test_unhandled_errors);
 
   g_test_run ();
   return EXIT_SUCCESS;
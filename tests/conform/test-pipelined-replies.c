@@ -0,0 +1,89 @@
+
+#include <gx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "test-gx-common.h"
+
+#define N_REQUESTS 2000
+
+/* This issues a large number of requests before asking for any of the
+ * replies, so the connection has to track lots of outstanding cookies.
+ * Half the replies are collected via gx_window_query_tree_reply and the
+ * other half are delivered through "notify::reply" from the main loop.
+ */
+
+static int n_notified = 0;
+
+static void
+query_tree_reply_handler (GXCookie *self,
+			  const GParamSpec *pspec,
+			  gpointer user_data)
+{
+  GXWindowQueryTreeReply *query_tree;
+
+  query_tree = gx_window_query_tree_reply (self, NULL);
+  gx_window_query_tree_reply_free (query_tree);
+
+  if (++n_notified == N_REQUESTS / 2)
+    gx_main_quit ();
+}
+
+void
+test_pipelined_replies (TestGXSimpleFixture *fixture,
+			gconstpointer data)
+{
+  GXConnection *connection;
+  GXWindow *root;
+  GXCookie *cookies[N_REQUESTS];
+  int i;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  root = gx_connection_get_default_root (connection);
+
+  for (i = 0; i < N_REQUESTS; i++)
+    cookies[i] = gx_window_query_tree_async (root);
+
+  for (i = 0; i < N_REQUESTS; i += 2)
+    g_signal_connect (cookies[i],
+		      "notify::reply",
+		      G_CALLBACK (query_tree_reply_handler),
+		      NULL);
+
+  /* Claim the odd replies directly, newest first, so cookies are
+   * unregistered out of sequence order. */
+  for (i = N_REQUESTS - 1; i > 0; i -= 2)
+    {
+      GXWindowQueryTreeReply *query_tree =
+	gx_window_query_tree_reply (cookies[i], NULL);
+      if (!query_tree)
+	{
+	  g_printerr ("Failed to get query tree reply %d\n", i);
+	  exit (1);
+	}
+      gx_window_query_tree_reply_free (query_tree);
+    }
+
+  gx_connection_flush (connection, FALSE);
+
+  gx_main ();
+
+  if (n_notified != N_REQUESTS / 2)
+    {
+      g_printerr ("Only %d of %d replies were notified\n",
+		  n_notified, N_REQUESTS / 2);
+      exit (1);
+    }
+
+  g_object_unref (root);
+  g_object_unref (connection);
+}
+
@@ -0,0 +1,133 @@
+#include <gx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test-gx-common.h"
+
+#define N_WINDOWS 10
+
+/* Checks that the borrowed list accessors see the expected XIDs, that
+ * iterating a list of XIDs returns the objects already registered with
+ * the connection, and that lists with computed lengths and lists of
+ * variable sized items get accessors too. */
+
+void
+test_reply_peek (TestGXSimpleFixture *fixture,
+		 gconstpointer data)
+{
+  GXConnection *connection;
+  GXWindow *root;
+  GXWindow *parent;
+  GXWindow *windows[N_WINDOWS];
+  GXWindowQueryTreeReply *query_tree;
+  const guint32 *children;
+  int n_children;
+  GXXIDIter iter;
+  GXConnectionGetModifierMappingReply *modifier_mapping;
+  const guint8 *keycodes;
+  int n_keycodes;
+  GXConnectionListExtensionsReply *list_extensions;
+  xcb_str_iterator_t names;
+  GXWindow *child;
+  GError *error = NULL;
+  int i;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  root = gx_connection_get_default_root (connection);
+  parent = gx_window_new (connection, root, 0, 0, 1, 1, 0);
+  for (i = 0; i < N_WINDOWS; i++)
+    windows[i] = gx_window_new (connection, parent, 0, 0, 1, 1, 0);
+
+  query_tree = gx_window_query_tree (parent, &error);
+  if (!query_tree)
+    {
+      g_printerr ("QueryTree failed: %s\n", error->message);
+      exit (1);
+    }
+
+  children = gx_window_query_tree_peek_children (query_tree, &n_children);
+  if (n_children != N_WINDOWS)
+    {
+      g_printerr ("Expected %d children, got %d\n", N_WINDOWS, n_children);
+      exit (1);
+    }
+
+  /* Children are returned in bottom-to-top stacking order, which is
+   * the order we created them in */
+  for (i = 0; i < n_children; i++)
+    if (children[i] != gx_drawable_get_xid (GX_DRAWABLE (windows[i])))
+      {
+	g_printerr ("Unexpected child xid 0x%08x\n", children[i]);
+	exit (1);
+      }
+
+  gx_window_query_tree_children_iter_init (&iter, query_tree);
+  for (i = 0; (child = gx_xid_iter_next (&iter)); i++)
+    {
+      if (child != windows[i])
+	{
+	  g_printerr ("Iterator didn't return the registered window\n");
+	  exit (1);
+	}
+      g_object_unref (child);
+    }
+  if (i != N_WINDOWS)
+    {
+      g_printerr ("Iterator returned %d children\n", i);
+      exit (1);
+    }
+
+  gx_window_query_tree_reply_free (query_tree);
+
+  /* The length of the keycodes list is keycodes_per_modifier * 8 */
+  modifier_mapping = gx_connection_get_modifier_mapping (connection, &error);
+  if (!modifier_mapping)
+    {
+      g_printerr ("GetModifierMapping failed: %s\n", error->message);
+      exit (1);
+    }
+  keycodes = gx_connection_get_modifier_mapping_peek_keycodes (modifier_mapping,
+							       &n_keycodes);
+  if (!keycodes
+      || n_keycodes != modifier_mapping->x11_reply->keycodes_per_modifier * 8)
+    {
+      g_printerr ("Unexpected number of modifier keycodes %d\n", n_keycodes);
+      exit (1);
+    }
+  gx_connection_get_modifier_mapping_reply_free (modifier_mapping);
+
+  /* The names are a list of STRs, which vary in size */
+  list_extensions = gx_connection_list_extensions (connection, &error);
+  if (!list_extensions)
+    {
+      g_printerr ("ListExtensions failed: %s\n", error->message);
+      exit (1);
+    }
+  names = gx_connection_list_extensions_names_iterator (list_extensions);
+  if (names.rem != list_extensions->x11_reply->names_len)
+    {
+      g_printerr ("Unexpected number of extension names %d\n", names.rem);
+      exit (1);
+    }
+  for (; names.rem; xcb_str_next (&names))
+    if (xcb_str_name_length (names.data) == 0)
+      {
+	g_printerr ("Empty extension name\n");
+	exit (1);
+      }
+  gx_connection_list_extensions_reply_free (list_extensions);
+
+  for (i = 0; i < N_WINDOWS; i++)
+    g_object_unref (windows[i]);
+  g_object_unref (parent);
+  g_object_unref (root);
+  g_object_unref (connection);
+}
+
@@ -7,6 +7,77 @@
 
 #include "test-gx-common.h"
 
+/* Checks the depth and visual iterators agree with each other */
+static void
+print_depths (GXScreen *screen)
+{
+  GXDepthIter depth_iter;
+  GXVisualIter visual_iter;
+  const xcb_depth_t *depth;
+  const xcb_visualtype_t *visual;
+  guint8 visual_depth;
+  int n_depths = 0;
+  int n_visuals = 0;
+  gboolean found_root_visual = FALSE;
+
+  g_print ("depths:    ");
+  gx_screen_depth_iter_init (screen, &depth_iter);
+  while ((depth = gx_depth_iter_next (&depth_iter)))
+    {
+      int n_depth_visuals = 0;
+
+      g_print ("%s%d", n_depths ? ", " : "", depth->depth);
+
+      gx_depth_visual_iter_init (depth, &visual_iter);
+      while ((visual = gx_visual_iter_next (&visual_iter, &visual_depth)))
+	{
+	  if (visual_depth != depth->depth)
+	    {
+	      g_printerr ("Visual reported with the wrong depth\n");
+	      exit (1);
+	    }
+	  n_depth_visuals++;
+	}
+      if (n_depth_visuals != depth->visuals_len)
+	{
+	  g_printerr ("Failed to iterate the visuals of depth %d\n",
+		      depth->depth);
+	  exit (1);
+	}
+
+      n_visuals += n_depth_visuals;
+      n_depths++;
+    }
+  g_print ("\n");
+
+  if (n_depths != gx_screen_get_allowed_depths_len (screen))
+    {
+      g_printerr ("Failed to iterate all the depths\n");
+      exit (1);
+    }
+
+  gx_screen_visual_iter_init (screen, &visual_iter);
+  while ((visual = gx_visual_iter_next (&visual_iter, &visual_depth)))
+    {
+      if (visual->visual_id == gx_screen_get_root_visual_id (screen))
+	{
+	  if (visual_depth != gx_screen_get_root_depth (screen))
+	    {
+	      g_printerr ("The root visual has the wrong depth\n");
+	      exit (1);
+	    }
+	  found_root_visual = TRUE;
+	}
+      n_visuals--;
+    }
+
+  if (n_visuals != 0 || !found_root_visual)
+    {
+      g_printerr ("Failed to iterate all the visuals\n");
+      exit (1);
+    }
+}
+
 static void
 print_screen_info (GXScreen *screen)
 {
@@ -20,10 +91,11 @@ print_screen_info (GXScreen *screen)
 	   gx_screen_get_width_in_millimeters (screen),
 	   gx_screen_get_height_in_millimeters (screen));
   /* TODO resolution: */
-  /* TODO depths: */
+  print_depths (screen);
   root = gx_screen_get_root (screen);
   g_print ("root window id:    0x%x\n",
 	   gx_drawable_get_xid (GX_DRAWABLE (root)));
+  g_object_unref (root);
   g_print ("depth of root window:    %d planes\n",
 	   gx_screen_get_root_depth (screen));
   g_print ("preallocated pixels:    black %ld, white %ld\n",
@@ -58,8 +130,9 @@ test_screen_info (TestGXSimpleFixture *fixture,
 {
   GXConnection *connection;
   GXScreen     *default_screen;
-  GList	       *screens;
-  GList	       *tmp;
+  const GList  *screens;
+  const GList  *tmp;
+  guint		n_screens;
 
   connection = gx_connection_new (NULL);
 
@@ -78,8 +151,16 @@ test_screen_info (TestGXSimpleFixture *fixture,
   g_print ("default screen number: %d\n",
 	   gx_screen_get_number (default_screen));
 
+  g_object_unref (default_screen);
+
   screens = gx_connection_get_screens (connection);
-  g_print ("number of screens: %d\n", g_list_length (screens));
+  n_screens = g_list_length ((GList *)screens);
+  g_print ("number of screens: %u\n", n_screens);
+  if (n_screens != gx_connection_get_n_screens (connection))
+    {
+      g_printerr ("Inconsistent number of screens\n");
+      exit (1);
+    }
 
   g_print ("\n");
 
@@ -88,10 +169,7 @@ test_screen_info (TestGXSimpleFixture *fixture,
       GXScreen *screen = tmp->data;
 
       print_screen_info (screen);
-
-      g_object_unref (screen);
     }
-  g_list_free (screens);
 
   g_print ("OK\n");
 
@@ -0,0 +1,119 @@
+#include <gx.h>
+#include <gx/gx-pixmap.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-gx-common.h"
+
+/* Big enough that the unshared upload is split into several PutImage
+ * requests (unless BIG-REQUESTS is available) */
+#define IMAGE_WIDTH 512
+#define IMAGE_HEIGHT 512
+
+/* Uploads an image to a pixmap and reads it back, via MIT-SHM (if
+ * available) and via PutImage/GetImage, checking the data survives the
+ * round trip. */
+
+static void
+check_round_trip (GXConnection *connection,
+		  GXPixmap *pixmap,
+		  GXGContext *gcontext,
+		  GXShmImage *image,
+		  const char *what)
+{
+  guint stride = gx_shm_image_get_stride (image);
+  guint16 height = gx_shm_image_get_height (image);
+  guint8 *data = gx_shm_image_get_data (image);
+  guint8 *expected;
+  GError *error = NULL;
+  guint i;
+
+  for (i = 0; i < stride * height; i++)
+    data[i] = i % 251;
+  expected = g_memdup (data, stride * height);
+
+  gx_drawable_put_shm_image (GX_DRAWABLE (pixmap), gcontext, image, 0, 0);
+  if (!gx_shm_image_wait (image, &error))
+    {
+      g_printerr ("Failed to upload %s image: %s\n", what, error->message);
+      exit (1);
+    }
+  memset (data, 0, stride * height);
+
+  if (!gx_drawable_get_shm_image (GX_DRAWABLE (pixmap), image, 0, 0, &error))
+    {
+      g_printerr ("Failed to read back %s image: %s\n", what, error->message);
+      exit (1);
+    }
+
+  /* NB: we only compare the bytes of each pixel that are significant
+   * for 24bit depths stored in 32bit pixels */
+  for (i = 0; i < stride * height; i++)
+    {
+      if (gx_shm_image_get_depth (image) == 24 && i % 4 == 3)
+	continue;
+      if (data[i] != expected[i])
+	{
+	  g_printerr ("Mismatch in %s image data at byte %u\n", what, i);
+	  exit (1);
+	}
+    }
+
+  g_free (expected);
+}
+
+void
+test_shm_image (TestGXSimpleFixture *fixture,
+		gconstpointer data)
+{
+  GXConnection *connection;
+  GXWindow *root;
+  GXScreen *screen;
+  guint8 depth;
+  GXPixmap *pixmap;
+  GXGContext *gcontext;
+  GXShmImage *image;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  root = gx_connection_get_default_root (connection);
+  screen = gx_connection_get_default_screen (connection);
+  depth = gx_screen_get_root_depth (screen);
+
+  pixmap = gx_pixmap_new (connection, GX_DRAWABLE (root),
+			  IMAGE_WIDTH, IMAGE_HEIGHT, depth);
+  gcontext = gx_gcontext_new (connection, GX_DRAWABLE (pixmap), NULL);
+
+  image = gx_shm_image_new (connection, IMAGE_WIDTH, IMAGE_HEIGHT, depth);
+  check_round_trip (connection, pixmap, gcontext, image, "shared");
+  g_object_unref (image);
+
+  /* This should be able to reuse the segment from the pool */
+  image = gx_shm_image_new (connection, IMAGE_WIDTH, IMAGE_HEIGHT, depth);
+  check_round_trip (connection, pixmap, gcontext, image, "reused shared");
+  g_object_unref (image);
+
+  image = gx_shm_image_new_unshared (connection,
+				     IMAGE_WIDTH, IMAGE_HEIGHT, depth);
+  if (gx_shm_image_is_shared (image))
+    {
+      g_printerr ("Unshared image claims to be shared\n");
+      exit (1);
+    }
+  check_round_trip (connection, pixmap, gcontext, image, "unshared");
+  g_object_unref (image);
+
+  g_object_unref (gcontext);
+  g_object_unref (pixmap);
+  g_object_unref (screen);
+  g_object_unref (root);
+  g_object_unref (connection);
+}
+
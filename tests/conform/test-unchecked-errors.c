@@ -0,0 +1,105 @@
+#include <gx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test-gx-common.h"
+#include "gx-fake-server.h"
+
+/* Checks that errors for void requests that weren't checked, which XCB
+ * returns as events, are delivered via the "protocol-error" signal
+ * instead of being mistaken for events. */
+
+#define N_REQUESTS 10
+
+static int n_errors = 0;
+static int n_events = 0;
+
+static void
+protocol_error_cb (GXConnection *connection,
+		   GXGenericProtocolError *error,
+		   gpointer user_data)
+{
+  if (error->error_code != XCB_ALLOC
+      || error->major_code != XCB_NO_OPERATION)
+    {
+      g_printerr ("Unexpected error %d for request %d\n",
+		  error->error_code, error->major_code);
+      exit (1);
+    }
+  n_errors++;
+}
+
+static void
+event_cb (GXConnection *connection,
+	  GXGenericEvent *event,
+	  gpointer user_data)
+{
+  n_events++;
+}
+
+void
+test_unchecked_errors (TestGXSimpleFixture *fixture,
+		       gconstpointer data)
+{
+  GXFakeServer *server;
+  GXConnection *connection;
+  GXConnectionGetInputFocusReply *reply;
+  GXConnectionStats stats;
+  int i;
+
+  server = gx_fake_server_new ();
+  connection = gx_fake_server_connect (server);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Failed to connect to the fake server\n");
+      exit (1);
+    }
+
+  g_signal_connect (connection, "protocol-error",
+		    G_CALLBACK (protocol_error_cb), NULL);
+  g_signal_connect (connection, "event", G_CALLBACK (event_cb), NULL);
+  gx_connection_reset_stats (connection);
+
+  /* Every other request fails */
+  gx_fake_server_inject_errors (server, 0, XCB_ALLOC, N_REQUESTS / 2, 2);
+  for (i = 0; i < N_REQUESTS; i++)
+    xcb_no_operation (gx_connection_get_xcb_connection (connection));
+
+  /* Since the server replies in order, once we have this reply all the
+   * errors have been received too */
+  reply = gx_connection_get_input_focus (connection, NULL);
+  if (!reply)
+    {
+      g_printerr ("Failed to get a reply after the failed requests\n");
+      exit (1);
+    }
+  gx_connection_get_input_focus_reply_free (reply);
+
+  while (n_errors < N_REQUESTS / 2)
+    g_main_context_iteration (NULL, TRUE);
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+
+  if (n_errors != N_REQUESTS / 2)
+    {
+      g_printerr ("Expected %d errors, got %d\n", N_REQUESTS / 2, n_errors);
+      exit (1);
+    }
+
+  if (n_events != 0)
+    {
+      g_printerr ("An error was delivered as an event\n");
+      exit (1);
+    }
+
+  gx_connection_get_stats (connection, &stats);
+  if (stats.errors != N_REQUESTS / 2 || stats.events != 0)
+    {
+      g_printerr ("Unchecked errors weren't counted as errors\n");
+      exit (1);
+    }
+
+  g_object_unref (connection);
+  gx_fake_server_free (server);
+}
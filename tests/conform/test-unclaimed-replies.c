@@ -0,0 +1,158 @@
+#include <gx.h>
+#include <gx/gx-cookie.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test-gx-common.h"
+#include "gx-fake-server.h"
+
+/* Checks that cookies whose replies are never claimed don't live for
+ * the lifetime of the connection: cookies passed to gx_cookie_forget ()
+ * are freed as soon as their reply has been delivered, and otherwise
+ * unclaimed replies are reaped once there are more than
+ * "max-unclaimed-replies" of them or they are older than
+ * "unclaimed-reply-ttl". */
+
+#define N_COOKIES 50
+#define MAX_UNCLAIMED 10
+
+static int n_finalized = 0;
+static int n_delivered = 0;
+static int n_expected = 0;
+
+static void
+cookie_finalize_notify (gpointer data, GObject *where_the_object_was)
+{
+  n_finalized++;
+}
+
+static void
+reply_notify_cb (GXCookie *cookie, const GParamSpec *pspec, gpointer data)
+{
+  if (++n_delivered == n_expected)
+    gx_main_quit ();
+}
+
+static GXCookie *
+issue_request (GXConnection *connection)
+{
+  GXCookie *cookie = gx_connection_get_input_focus_async (connection);
+
+  g_object_weak_ref (G_OBJECT (cookie), cookie_finalize_notify, NULL);
+  g_signal_connect (cookie, "notify::reply",
+		    G_CALLBACK (reply_notify_cb), NULL);
+
+  return cookie;
+}
+
+static void
+wait_for_replies (GXConnection *connection, int n_replies)
+{
+  n_delivered = 0;
+  n_expected = n_replies;
+  gx_connection_flush (connection, FALSE);
+  gx_main ();
+}
+
+static gboolean
+quit_cb (gpointer data)
+{
+  gx_main_quit ();
+  return FALSE;
+}
+
+void
+test_unclaimed_replies (TestGXSimpleFixture *fixture,
+			gconstpointer data)
+{
+  GXFakeServer *server;
+  GXConnection *connection;
+  GXCookie *cookie;
+  GXCookie *held_cookie = NULL;
+  GXConnectionGetInputFocusReply *reply;
+  GXConnectionStats stats;
+  GError *error = NULL;
+  int i;
+
+  server = gx_fake_server_new ();
+  connection = gx_fake_server_connect (server);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Failed to connect to the fake server\n");
+      exit (1);
+    }
+
+  /* Forgotten before the reply arrives */
+  cookie = issue_request (connection);
+  gx_cookie_forget (cookie);
+  wait_for_replies (connection, 1);
+  if (n_finalized != 1)
+    {
+      g_printerr ("A forgotten cookie wasn't freed once delivered\n");
+      exit (1);
+    }
+
+  /* Forgotten after the reply arrived */
+  cookie = issue_request (connection);
+  wait_for_replies (connection, 1);
+  gx_cookie_forget (cookie);
+  if (n_finalized != 2)
+    {
+      g_printerr ("A forgotten cookie wasn't freed immediately\n");
+      exit (1);
+    }
+
+  n_finalized = 0;
+  gx_connection_reset_stats (connection);
+  g_object_set (connection, "max-unclaimed-replies", MAX_UNCLAIMED, NULL);
+
+  for (i = 0; i < N_COOKIES; i++)
+    {
+      cookie = issue_request (connection);
+      if (i == 0)
+	held_cookie = g_object_ref (cookie);
+    }
+  wait_for_replies (connection, N_COOKIES);
+
+  gx_connection_get_stats (connection, &stats);
+  if (stats.zombie_cookies != MAX_UNCLAIMED
+      || stats.reaped_cookies != N_COOKIES - MAX_UNCLAIMED
+      || n_finalized != N_COOKIES - MAX_UNCLAIMED - 1)
+    {
+      g_printerr ("Expected %d unclaimed replies to be reaped, "
+		  "but %" G_GUINT64_FORMAT " were (%d freed)\n",
+		  N_COOKIES - MAX_UNCLAIMED, stats.reaped_cookies,
+		  n_finalized);
+      exit (1);
+    }
+
+  /* The connection no longer owns a reaped cookie, but since we held
+   * our own reference its reply can still be claimed */
+  reply = gx_connection_get_input_focus_reply (held_cookie, &error);
+  if (!reply)
+    {
+      g_printerr ("Failed to claim the reply of a held cookie\n");
+      exit (1);
+    }
+  gx_connection_get_input_focus_reply_free (reply);
+  g_object_unref (held_cookie);
+
+  g_object_set (connection,
+		"max-unclaimed-replies", 0,
+		"unclaimed-reply-ttl", 20,
+		NULL);
+  g_timeout_add (200, quit_cb, NULL);
+  gx_main ();
+
+  gx_connection_get_stats (connection, &stats);
+  if (stats.zombie_cookies != 0 || n_finalized != N_COOKIES)
+    {
+      g_printerr ("%u unclaimed replies outlived their TTL\n",
+		  stats.zombie_cookies);
+      exit (1);
+    }
+
+  g_object_unref (connection);
+  gx_fake_server_free (server);
+}
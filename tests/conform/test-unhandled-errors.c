@@ -0,0 +1,86 @@
+#include <gx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test-gx-common.h"
+#include "gx-fake-server.h"
+
+/* Checks that errors for void requests that weren't checked are
+ * quietly dropped if nothing is connected to the "protocol-error"
+ * signal. NB: g_test_init () makes warnings fatal, so this would abort
+ * if the connection logged a warning for them. */
+
+#define N_REQUESTS 10
+
+static int n_events = 0;
+
+static void
+event_cb (GXConnection *connection,
+	  GXGenericEvent *event,
+	  gpointer user_data)
+{
+  n_events++;
+}
+
+void
+test_unhandled_errors (TestGXSimpleFixture *fixture,
+		       gconstpointer data)
+{
+  GXFakeServer *server;
+  GXConnection *connection;
+  GXConnectionGetInputFocusReply *reply;
+  GXConnectionStats stats;
+  int i;
+
+  server = gx_fake_server_new ();
+  connection = gx_fake_server_connect (server);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Failed to connect to the fake server\n");
+      exit (1);
+    }
+
+  g_signal_connect (connection, "event", G_CALLBACK (event_cb), NULL);
+  gx_connection_reset_stats (connection);
+
+  /* Every other request fails */
+  gx_fake_server_inject_errors (server, 0, XCB_ALLOC, N_REQUESTS / 2, 2);
+  for (i = 0; i < N_REQUESTS; i++)
+    xcb_no_operation (gx_connection_get_xcb_connection (connection));
+
+  /* Since the server replies in order, once we have this reply all the
+   * errors have been received too */
+  reply = gx_connection_get_input_focus (connection, NULL);
+  if (!reply)
+    {
+      g_printerr ("Failed to get a reply after the failed requests\n");
+      exit (1);
+    }
+  gx_connection_get_input_focus_reply_free (reply);
+
+  do
+    {
+      g_main_context_iteration (NULL, TRUE);
+      gx_connection_get_stats (connection, &stats);
+    }
+  while (stats.errors < N_REQUESTS / 2);
+  while (g_main_context_iteration (NULL, FALSE))
+    ;
+
+  if (stats.errors != N_REQUESTS / 2)
+    {
+      g_printerr ("Expected %d errors, got %" G_GUINT64_FORMAT "\n",
+		  N_REQUESTS / 2, stats.errors);
+      exit (1);
+    }
+
+  if (n_events != 0)
+    {
+      g_printerr ("An unhandled error was delivered as an event\n");
+      exit (1);
+    }
+
+  g_object_unref (connection);
+  gx_fake_server_free (server);
+}
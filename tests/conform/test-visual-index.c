@@ -0,0 +1,118 @@
+
+#include <gx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test-gx-common.h"
+
+/* Checks the visual index of each screen agrees with the visuals
+ * reported by the visual iterator */
+
+static void
+check_screen_visuals (GXScreen *screen)
+{
+  GXVisualIter iter;
+  const xcb_visualtype_t *visual;
+  const GXVisualInfo *visuals;
+  const GXVisualInfo *info;
+  guint n_visuals;
+  guint8 depth;
+  guint i;
+
+  visuals = gx_screen_get_visuals (screen, &n_visuals);
+
+  for (i = 1; i < n_visuals; i++)
+    if (visuals[i - 1].visual_id >= visuals[i].visual_id)
+      {
+	g_printerr ("The visual index isn't sorted\n");
+	exit (1);
+      }
+
+  gx_screen_visual_iter_init (screen, &iter);
+  while ((visual = gx_visual_iter_next (&iter, &depth)))
+    {
+      info = gx_screen_lookup_visual (screen, visual->visual_id);
+      if (!info
+	  || info->depth != depth
+	  || info->visual_class != visual->_class
+	  || info->red_mask != visual->red_mask
+	  || info->green_mask != visual->green_mask
+	  || info->blue_mask != visual->blue_mask)
+	{
+	  g_printerr ("Failed to lookup visual 0x%x\n", visual->visual_id);
+	  exit (1);
+	}
+      n_visuals--;
+    }
+
+  if (n_visuals != 0)
+    {
+      g_printerr ("Visual index and iterator disagree\n");
+      exit (1);
+    }
+
+  if (gx_screen_lookup_visual (screen, 0) != NULL)
+    {
+      g_printerr ("Found a visual with an ID of 0\n");
+      exit (1);
+    }
+
+  info = gx_screen_get_root_visual (screen);
+  if (!info
+      || info->visual_id != gx_screen_get_root_visual_id (screen)
+      || info->depth != gx_screen_get_root_depth (screen))
+    {
+      g_printerr ("Failed to find the root visual\n");
+      exit (1);
+    }
+
+  info = gx_screen_get_true_color_visual (screen);
+  if (info
+      && (info->visual_class != XCB_VISUAL_CLASS_TRUE_COLOR
+	  || info->depth != gx_screen_get_root_depth (screen)))
+    {
+      g_printerr ("Invalid TrueColor visual\n");
+      exit (1);
+    }
+
+  info = gx_screen_get_argb_visual (screen);
+  if (info && info->depth != 32)
+    {
+      g_printerr ("Invalid ARGB visual\n");
+      exit (1);
+    }
+
+  if (g_test_verbose ())
+    {
+      gx_screen_get_visuals (screen, &n_visuals);
+      g_print ("screen %u: %u visuals, ARGB visual = 0x%x\n",
+	       gx_screen_get_number (screen), n_visuals,
+	       info ? info->visual_id : 0);
+    }
+}
+
+void
+test_visual_index (TestGXSimpleFixture *fixture,
+		   gconstpointer data)
+{
+  GXConnection *connection;
+  guint i;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  for (i = 0; i < gx_connection_get_n_screens (connection); i++)
+    {
+      GXScreen *screen = gx_connection_get_screen (connection, i);
+      check_screen_visuals (screen);
+      g_object_unref (screen);
+    }
+
+  g_object_unref (connection);
+}
+
@@ -0,0 +1,123 @@
+#include <gx.h>
+#include <gx/gx-event.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test-gx-common.h"
+
+/* This mirrors the state of a window and checks it follows a configure,
+ * a map and a property change without any further round trips. The
+ * property change is sent last so its PropertyNotify tells us all the
+ * other events have been handled. */
+
+static void
+window_event_handler (GXWindow *window,
+		      GXGenericEvent *event,
+		      gpointer user_data)
+{
+  if ((event->type & GX_EVENT_CODE_MASK) == XCB_PROPERTY_NOTIFY)
+    gx_main_quit ();
+}
+
+void
+test_window_state (TestGXSimpleFixture *fixture,
+		   gconstpointer data)
+{
+  GXConnection *connection;
+  xcb_connection_t *xcb_connection;
+  GXWindow *root;
+  GXWindow *windows[2];
+  const GXWindowState *state;
+  xcb_window_t xid;
+  guint32 values[2];
+  GError *error = NULL;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+  xcb_connection = gx_connection_get_xcb_connection (connection);
+
+  root = gx_connection_get_default_root (connection);
+  windows[0] = gx_window_new (connection, root, 0, 0, 1, 1, 0);
+  windows[1] = gx_window_new (connection, root, 10, 10, 5, 5, 0);
+
+  if (gx_window_get_state (windows[0]) != NULL)
+    {
+      g_printerr ("The window's state shouldn't be mirrored yet\n");
+      exit (1);
+    }
+
+  if (!gx_window_enable_state_mirrors (windows, 2, &error))
+    {
+      g_printerr ("Failed to mirror window state: %s\n", error->message);
+      exit (1);
+    }
+
+  state = gx_window_get_state (windows[1]);
+  if (state->stale
+      || state->x != 10 || state->y != 10
+      || state->width != 5 || state->height != 5
+      || state->mapped
+      || state->destroyed
+      || !(state->your_event_mask & XCB_EVENT_MASK_STRUCTURE_NOTIFY)
+      || !(state->your_event_mask & XCB_EVENT_MASK_PROPERTY_CHANGE))
+    {
+      g_printerr ("Unexpected initial window state\n");
+      exit (1);
+    }
+
+  state = gx_window_get_state (windows[0]);
+  xid = gx_drawable_get_xid (GX_DRAWABLE (windows[0]));
+
+  values[0] = 20;
+  values[1] = 30;
+  xcb_configure_window (xcb_connection, xid,
+			XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT,
+			values);
+  xcb_map_window (xcb_connection, xid);
+  xcb_change_property (xcb_connection, XCB_PROP_MODE_REPLACE, xid,
+		       XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, 4, "test");
+
+  g_signal_connect (windows[0], "event",
+		    G_CALLBACK (window_event_handler), NULL);
+
+  gx_connection_flush (connection, FALSE);
+
+  gx_main ();
+
+  if (state->width != 20 || state->height != 30
+      || !state->mapped
+      || state->property_serial != 1)
+    {
+      g_printerr ("The window's state wasn't updated from its events\n");
+      exit (1);
+    }
+
+  gx_window_invalidate_state (windows[0]);
+  if (!state->stale)
+    {
+      g_printerr ("The window's state wasn't invalidated\n");
+      exit (1);
+    }
+  if (!gx_window_refresh_state (windows[0], &error) || state->stale)
+    {
+      g_printerr ("Failed to refresh the window's state\n");
+      exit (1);
+    }
+
+  gx_window_disable_state_mirror (windows[0]);
+  if (gx_window_get_state (windows[0]) != NULL)
+    {
+      g_printerr ("The window's state is still mirrored\n");
+      exit (1);
+    }
+
+  g_object_unref (windows[0]);
+  g_object_unref (windows[1]);
+  g_object_unref (root);
+  g_object_unref (connection);
+}
@@ -0,0 +1,113 @@
+#include <gx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test-gx-common.h"
+
+/* This builds a small tree of windows and checks that a snapshot of the
+ * tree has every window in breadth first order with the children of
+ * each node stored together. */
+
+#define N_CHILDREN	3
+#define N_GRANDCHILDREN 2
+
+void
+test_window_tree (TestGXSimpleFixture *fixture,
+		  gconstpointer data)
+{
+  GXConnection *connection;
+  GXWindow *root;
+  GXWindow *top;
+  GXWindow *children[N_CHILDREN];
+  GXWindow *grandchildren[N_CHILDREN * N_GRANDCHILDREN];
+  GXWindowTree *tree;
+  GError *error = NULL;
+  guint i;
+  int j;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  root = gx_connection_get_default_root (connection);
+  top = gx_window_new (connection, root, 0, 0, 100, 100, 0);
+  for (j = 0; j < N_CHILDREN; j++)
+    {
+      int k;
+
+      children[j] = gx_window_new (connection, top, j, 0, 10 + j, 10, 0);
+      for (k = 0; k < N_GRANDCHILDREN; k++)
+	grandchildren[j * N_GRANDCHILDREN + k] =
+	  gx_window_new (connection, children[j], 0, k, 1, 1, 0);
+    }
+
+  tree = gx_window_snapshot_tree (top,
+				  GX_WINDOW_SNAPSHOT_GEOMETRY
+				  | GX_WINDOW_SNAPSHOT_ATTRIBUTES,
+				  &error);
+  if (!tree)
+    {
+      g_printerr ("Failed to snapshot the window tree: %s\n",
+		  error->message);
+      exit (1);
+    }
+
+  if (tree->n_nodes != 1 + N_CHILDREN + N_CHILDREN * N_GRANDCHILDREN
+      || tree->nodes[0].window != gx_drawable_get_xid (GX_DRAWABLE (top))
+      || tree->nodes[0].parent != -1
+      || tree->nodes[0].n_children != N_CHILDREN
+      || tree->nodes[0].state.width != 100)
+    {
+      g_printerr ("Unexpected top of the window tree\n");
+      exit (1);
+    }
+
+  for (i = 0; i < tree->n_nodes; i++)
+    {
+      GXWindowTreeNode *node = &tree->nodes[i];
+      guint k;
+
+      if (node->state.stale || node->state.destroyed)
+	{
+	  g_printerr ("Failed to query window 0x%x\n", node->window);
+	  exit (1);
+	}
+
+      for (k = 0; k < node->n_children; k++)
+	if (tree->nodes[node->first_child + k].parent != (gint)i)
+	  {
+	    g_printerr ("Bad parent index for node %u\n",
+			node->first_child + k);
+	    exit (1);
+	  }
+    }
+
+  /* Siblings are listed bottom-most first, which is their creation
+   * order */
+  for (j = 0; j < N_CHILDREN; j++)
+    {
+      GXWindowTreeNode *node = &tree->nodes[1 + j];
+
+      if (node->window != gx_drawable_get_xid (GX_DRAWABLE (children[j]))
+	  || node->state.width != 10 + j
+	  || node->n_children != N_GRANDCHILDREN)
+	{
+	  g_printerr ("Unexpected child node %d\n", j);
+	  exit (1);
+	}
+    }
+
+  gx_window_tree_free (tree);
+
+  for (j = 0; j < N_CHILDREN * N_GRANDCHILDREN; j++)
+    g_object_unref (grandchildren[j]);
+  for (j = 0; j < N_CHILDREN; j++)
+    g_object_unref (children[j]);
+  g_object_unref (top);
+  g_object_unref (root);
+  g_object_unref (connection);
+}
@@ -0,0 +1,98 @@
+#include <gx.h>
+#include <gx/gx-pixmap.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "test-gx-common.h"
+
+#define N_WINDOWS 1000
+
+/* Checks that windows and pixmaps can be found from their XIDs via the
+ * connection they were created on (and only that connection), and that
+ * they are forgotten when finalized. */
+
+static void
+check_lookup (GXConnection *connection,
+	      guint32 xid,
+	      gpointer expected,
+	      const char *what)
+{
+  GXWindow *window = gx_window_find_from_xid (connection, xid);
+
+  if (window != expected)
+    {
+      g_printerr ("Unexpected lookup result for %s (xid = 0x%08x)\n",
+		  what, xid);
+      exit (1);
+    }
+  if (window)
+    g_object_unref (window);
+}
+
+void
+test_xid_registry (TestGXSimpleFixture *fixture,
+		   gconstpointer data)
+{
+  GXConnection *connection;
+  GXConnection *connection2;
+  GXScreen *screen;
+  GXWindow *root;
+  GXWindow *windows[N_WINDOWS];
+  GXPixmap *pixmap;
+  GXPixmap *found_pixmap;
+  guint32 xid;
+  int i;
+
+  connection = gx_connection_new (NULL);
+  connection2 = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection)
+      || gx_connection_has_error (connection2))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+
+  /* The root window is a foreign XID */
+  root = gx_connection_get_default_root (connection);
+  check_lookup (connection, gx_drawable_get_xid (GX_DRAWABLE (root)),
+		root, "root");
+
+  for (i = 0; i < N_WINDOWS; i++)
+    windows[i] = gx_window_new (connection, root, 0, 0, 1, 1, 0);
+
+  for (i = 0; i < N_WINDOWS; i++)
+    {
+      xid = gx_drawable_get_xid (GX_DRAWABLE (windows[i]));
+      check_lookup (connection, xid, windows[i], "window");
+      check_lookup (connection2, xid, NULL, "other connection's window");
+    }
+
+  screen = gx_connection_get_default_screen (connection);
+  pixmap = gx_pixmap_new (connection, GX_DRAWABLE (root), 1, 1,
+			  gx_screen_get_root_depth (screen));
+  g_object_unref (screen);
+  xid = gx_drawable_get_xid (GX_DRAWABLE (pixmap));
+  found_pixmap = gx_pixmap_find_from_xid (connection, xid);
+  if (found_pixmap != pixmap)
+    {
+      g_printerr ("Failed to find pixmap from its xid\n");
+      exit (1);
+    }
+  g_object_unref (found_pixmap);
+  /* A pixmap isn't a window... */
+  check_lookup (connection, xid, NULL, "pixmap");
+
+  for (i = 0; i < N_WINDOWS; i++)
+    {
+      xid = gx_drawable_get_xid (GX_DRAWABLE (windows[i]));
+      g_object_unref (windows[i]);
+      check_lookup (connection, xid, NULL, "destroyed window");
+    }
+
+  g_object_unref (pixmap);
+  g_object_unref (root);
+  g_object_unref (connection2);
+  g_object_unref (connection);
+}
+
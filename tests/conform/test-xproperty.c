@@ -0,0 +1,128 @@
+
+#include <gx.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "test-gx-common.h"
+
+/* Large enough to need several pipelined GetProperty requests */
+#define PROPERTY_LENGTH (1024 * 1024 + 3)
+#define APPEND_LENGTH	(32 * 1024)
+
+void
+test_xproperty (TestGXSimpleFixture *fixture,
+		gconstpointer data)
+{
+  GXConnection *connection;
+  xcb_connection_t *xcb_connection;
+  GXWindow *root;
+  GXWindow *window;
+  xcb_atom_t property;
+  xcb_atom_t type;
+  guint8 format;
+  guint8 *value;
+  guint8 *buffer;
+  GOutputStream *stream;
+  GMemoryOutputStream *memory_stream;
+  gsize bytes_written;
+  gssize length;
+  GError *error = NULL;
+  int i;
+
+  connection = gx_connection_new (NULL);
+  if (gx_connection_has_error (connection))
+    {
+      g_printerr ("Error establishing connection to X server");
+      exit (1);
+    }
+  xcb_connection = gx_connection_get_xcb_connection (connection);
+
+  root = gx_connection_get_default_root (connection);
+  window = gx_window_new (connection, root, 0, 0, 1, 1, 0);
+
+  property = gx_connection_lookup_atom (connection, "_GX_TEST_PROPERTY",
+					FALSE, NULL);
+
+  value = g_malloc (PROPERTY_LENGTH);
+  for (i = 0; i < PROPERTY_LENGTH; i++)
+    value[i] = i * 7;
+
+  for (i = 0; i < PROPERTY_LENGTH; i += APPEND_LENGTH)
+    xcb_change_property (xcb_connection,
+			 XCB_PROP_MODE_APPEND,
+			 gx_drawable_get_xid (GX_DRAWABLE (window)),
+			 property,
+			 XCB_ATOM_STRING,
+			 8,
+			 MIN (APPEND_LENGTH, PROPERTY_LENGTH - i),
+			 value + i);
+
+  /* Read the whole property into a buffer */
+  buffer = g_malloc (PROPERTY_LENGTH);
+  length = gx_window_get_xproperty_data (window, property,
+					 XCB_GET_PROPERTY_TYPE_ANY, FALSE,
+					 buffer, PROPERTY_LENGTH,
+					 &type, &format, &error);
+  if (length != PROPERTY_LENGTH
+      || type != XCB_ATOM_STRING
+      || format != 8
+      || memcmp (buffer, value, PROPERTY_LENGTH) != 0)
+    {
+      g_printerr ("Failed to read the property into a buffer\n");
+      exit (1);
+    }
+
+  /* Only the first few bytes */
+  memset (buffer, 0, PROPERTY_LENGTH);
+  length = gx_window_get_xproperty_data (window, property,
+					 XCB_ATOM_STRING, FALSE,
+					 buffer, 5,
+					 &type, &format, &error);
+  if (length != PROPERTY_LENGTH
+      || memcmp (buffer, value, 5) != 0
+      || buffer[5] != 0)
+    {
+      g_printerr ("Failed to read the start of the property\n");
+      exit (1);
+    }
+
+  /* Stream the property and delete it */
+  stream = g_memory_output_stream_new (NULL, 0, g_realloc, g_free);
+  if (!gx_window_get_xproperty_to_stream (window, property,
+					  XCB_ATOM_STRING, TRUE,
+					  stream, NULL,
+					  &type, &format, &bytes_written,
+					  &error))
+    {
+      g_printerr ("Failed to stream the property: %s\n", error->message);
+      exit (1);
+    }
+  memory_stream = G_MEMORY_OUTPUT_STREAM (stream);
+  if (bytes_written != PROPERTY_LENGTH
+      || memcmp (g_memory_output_stream_get_data (memory_stream),
+		 value, PROPERTY_LENGTH) != 0)
+    {
+      g_printerr ("Failed to stream the property\n");
+      exit (1);
+    }
+  g_object_unref (stream);
+
+  length = gx_window_get_xproperty_data (window, property,
+					 XCB_GET_PROPERTY_TYPE_ANY, FALSE,
+					 buffer, PROPERTY_LENGTH,
+					 &type, &format, &error);
+  if (length != 0 || type != XCB_ATOM_NONE)
+    {
+      g_printerr ("The property wasn't deleted\n");
+      exit (1);
+    }
+
+  g_free (buffer);
+  g_free (value);
+  g_object_unref (window);
+  g_object_unref (root);
+  g_object_unref (connection);
+}
+
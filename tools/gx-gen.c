@@ -38,6 +38,14 @@ typedef enum {
   GXGEN_OBJECT_TYPE_GCONTEXT
 } GXGenObjectType;
 
+/* The variants of the gx_*_async* () request functions
+ * (See output_async_request ()) */
+typedef enum {
+  GXGEN_ASYNC_COOKIE,
+  GXGEN_ASYNC_LIGHT,
+  GXGEN_ASYNC_DISCARD
+} GXGenAsyncVariant;
+
 typedef struct _GXGenObject {
   GXGenObjectType  type;
   const char	  *name_cc;
@@ -809,8 +817,9 @@ output_extension_init (GXGenOutputContext *output_context)
   /* XXX: Is it a bad idea to implicitly call gx_init, or should it
    * _always_ be the users responsability to have called it? */
   _C ("\tgx_init (argc, argv);\n");
-  _C ("\tgx_event_details_add_extension (_gx_%s_event_details);\n",
-      extension->header);
+  _C ("\tgx_event_details_add_extension (&xcb_%s_id,\n"
+      "\t\t\t\t\t_gx_%s_event_details);\n",
+      extension->header, extension->header);
 
   _C ("}\n");
 
@@ -1178,6 +1187,49 @@ output_enums (GXGenOutputContext *output_context)
   output_context->typedefs_part = NULL;
 }
 
+static gboolean
+is_fixed_size_definition (XGenDefinition *definition)
+{
+  GList *tmp;
+
+  if (definition->type == XGEN_TYPEDEF)
+    return is_fixed_size_definition (XGEN_TYPEDEF_DEF (definition)->reference);
+
+  if (definition->type != XGEN_STRUCT
+      && definition->type != XGEN_UNION)
+    return TRUE;
+
+  for (tmp = XGEN_STRUCT_DEF (definition)->fields;
+       tmp != NULL;
+       tmp = tmp->next)
+    {
+      XGenFieldDefinition *field = tmp->data;
+
+      if (field->length && field->length->type != XGEN_VALUE)
+	return FALSE;
+      if (!is_fixed_size_definition (field->definition))
+	return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Lists whose length is only known once the reply has been received;
+ * this is any list whose length isn't a constant. */
+static gboolean
+is_variable_length_list (XGenFieldDefinition *field)
+{
+  return field->length != NULL && field->length->type != XGEN_VALUE;
+}
+
+/* NB: lists of windows and pixmaps are returned as objects */
+static gboolean
+is_object_list (XGenFieldDefinition *field)
+{
+  return strcmp (field->definition->name, "WINDOW") == 0
+    || strcmp (field->definition->name, "PIXMAP") == 0;
+}
+
 static void
 output_reply_typedef (GXGenOutputContext *output_context)
 {
@@ -1197,18 +1249,26 @@ output_reply_typedef (GXGenOutputContext *output_context)
        tmp != NULL; tmp = tmp->next)
     {
       XGenFieldDefinition *field = tmp->data;
+      char *field_type;
+
       if (strcmp (field->name, "pad") == 0)
-	output_pad_field (output_context, field, pad++);
-      else
 	{
-	  /* Dont print trailing list members */
-	  if (!(tmp->next == NULL && field->length != NULL))
-	    {
-	      _TD ("\t%s %s;\n",
-		   gxgen_definition_to_gx_type (field->definition, FALSE),
-		   field->name);
-	    }
+	  output_pad_field (output_context, field, pad++);
+	  continue;
 	}
+
+      /* The offsets of any fields following a variable length list
+       * depend on the reply data, so like XCB we stop here and the
+       * lists are accessed via the gx_*_peek_<field> functions */
+      if (is_variable_length_list (field))
+	break;
+
+      field_type = gxgen_definition_to_gx_type (field->definition, FALSE);
+      if (field->length)
+	_TD ("\t%s %s[%lu];\n", field_type, field->name, field->length->value);
+      else
+	_TD ("\t%s %s;\n", field_type, field->name);
+      g_free (field_type);
     }
   _TD ("\n} %sX11Reply;\n\n", gx_type);
 
@@ -1218,28 +1278,39 @@ output_reply_typedef (GXGenOutputContext *output_context)
   _TD ("\n} %sReply;\n\n", gx_type);
 }
 
+/* NB: We leave it to the XCB accessors to evaluate list length
+ * expressions and to find the start of lists that follow other
+ * variable length fields. */
 static void
-output_reply_list_get (GXGenOutputContext *output_context)
+output_xcb_list_accessor (GXGenOutputContext *output_context,
+			  XGenFieldDefinition *field,
+			  const char *accessor)
 {
   const XGenRequest *request = output_context->out_request;
   GXGenDefinition *gxgen_def =
     xgen_definition_get_private (XGEN_DEF (request));
   char *gx_name = gxgen_namespace_to_gx_name (gxgen_def->namespace);
-  char *gx_type = gxgen_namespace_to_gx_type (gxgen_def->namespace);
-  XGenFieldDefinition *field;
+  char *xcb_name = gxgen_namespace_to_xcb_name (gxgen_def->namespace);
 
-  if (!request->reply)
-    return;
+  _C ("%s_%s%s ((%s_reply_t *)%s_reply->x11_reply)",
+      xcb_name, field->name, accessor, xcb_name, gx_name);
 
-  field = (g_list_last (request->reply->fields))->data;
-  if (field->length == NULL)
-    return;
+  g_free (gx_name);
+  g_free (xcb_name);
+}
 
-  /* FIXME - shouldn't be restricted to FIELDREF length types */
-  if (field->length->type != XGEN_FIELDREF)
-    return;
+static void
+output_reply_list_get (GXGenOutputContext *output_context,
+		       XGenFieldDefinition *field)
+{
+  const XGenRequest *request = output_context->out_request;
+  GXGenDefinition *gxgen_def =
+    xgen_definition_get_private (XGEN_DEF (request));
+  char *gx_name = gxgen_namespace_to_gx_name (gxgen_def->namespace);
+  char *gx_type = gxgen_namespace_to_gx_type (gxgen_def->namespace);
+  char *item_type = gxgen_definition_to_gx_type (field->definition, FALSE);
 
-  if (is_special_xid_definition (field->definition))
+  if (is_object_list (field))
     _CH ("GList *\n");
   else
     _CH ("GArray *\n");
@@ -1253,12 +1324,14 @@ output_reply_list_get (GXGenOutputContext *output_context)
   _H (";\n");
   _C ("\n{\n");
 
-  _C ("  %s *p = (%s *)(%s_reply->x11_reply + 1);\n",
-      gxgen_definition_to_gx_type (field->definition, FALSE),
-      gxgen_definition_to_gx_type (field->definition, FALSE),
-      gx_name);
+  _C ("  %s *p = (%s *)", item_type, item_type);
+  output_xcb_list_accessor (output_context, field, "");
+  _C (";\n");
+  _C ("  int len = ");
+  output_xcb_list_accessor (output_context, field, "_length");
+  _C (";\n");
 
-  if (is_special_xid_definition (field->definition))
+  if (is_object_list (field))
     _C ("  GList *tmp = NULL;\n");
   else
     _C ("  GArray *tmp;\n");
@@ -1271,24 +1344,20 @@ output_reply_list_get (GXGenOutputContext *output_context)
       "    return NULL;\n",
       gx_name);
 
-  if (is_special_xid_definition (field->definition))
-    _C ("  int i;\n");
-  else
-    _C ("  tmp = g_array_new (TRUE, FALSE, sizeof(%s));\n",
-        gxgen_definition_to_gx_type (field->definition, FALSE));
-
-  if (is_special_xid_definition (field->definition))
+  if (is_object_list (field))
     {
-      _C ("  for (i = 0; i< %s_reply->x11_reply->%s; i++)\n"
-	  "    {\n",
-	  gx_name,
-	  field->length->field);
+      const char *object_name =
+	strcmp (field->definition->name, "WINDOW") == 0 ? "window" : "pixmap";
 
-      _C ("      /* FIXME - mutex */\n");
+      _C ("  int i;\n");
+      _C ("  for (i = 0; i < len; i++)\n"
+	  "    {\n");
 
-      _C ("      %s item = gx_%s_find_from_xid (p[i]);\n",
+      _C ("      %s item = gx_%s_find_from_xid (%s_reply->connection,\n"
+	  "						p[i]);\n",
 	  gxgen_definition_to_gx_type (field->definition, TRUE),
-	  gxgen_def->object->name_lc);
+	  object_name,
+	  gx_name);
 
       _C (
        "      if (!item)\n"
@@ -1297,48 +1366,102 @@ output_reply_list_get (GXGenOutputContext *output_context)
        "			     \"xid\", p[i],\n"
        "			     \"wrap\", TRUE,\n"
        "			     NULL);\n",
-       gxgen_def->object->name_lc, gx_name);
+       object_name, gx_name);
       _C ("      tmp = g_list_prepend (tmp, item);\n");
       _C ("    }\n");
+      _C ("  tmp = g_list_reverse (tmp);\n");
     }
   else
     {
-      _C ("  tmp = g_array_append_vals (tmp, p, %s_reply->x11_reply->%s);\n",
-	  gx_name, field->length->field);
+      _C ("  tmp = g_array_new (TRUE, FALSE, sizeof(%s));\n", item_type);
+      _C ("  tmp = g_array_append_vals (tmp, p, len);\n");
     }
 
-  if (is_special_xid_definition (field->definition))
-    _C ("  tmp = g_list_reverse (tmp);");
-
   _C ("  return tmp;\n");
 
   _C ("}\n");
 
+  g_free (gx_name);
+  g_free (gx_type);
+  g_free (item_type);
 }
 
+/**
+ * output_reply_list_peek:
+ *
+ * This function outputs a gx_*_peek_<field> () accessor for list
+ * fields, which returns a pointer directly into the reply buffer
+ * (and the number of elements) instead of copying the list.
+ *
+ * For lists of windows or pixmaps it also outputs a
+ * gx_*_<field>_iter_init () function to initialize a GXXIDIter, so
+ * objects are only looked up or wrapped as they are iterated.
+ */
 static void
-output_reply_list_free (GXGenOutputContext *output_context)
+output_reply_list_peek (GXGenOutputContext *output_context,
+			XGenFieldDefinition *field)
 {
   const XGenRequest *request = output_context->out_request;
   GXGenDefinition *gxgen_def =
     xgen_definition_get_private (XGEN_DEF (request));
   char *gx_name = gxgen_namespace_to_gx_name (gxgen_def->namespace);
-  XGenFieldDefinition *field;
+  char *gx_type = gxgen_namespace_to_gx_type (gxgen_def->namespace);
+  char *item_type = gxgen_definition_to_gx_type (field->definition, FALSE);
 
-  if (!request->reply)
-    return;
+  _CH ("\nconst %s *\n", item_type);
+  _CH ("%s_peek_%s (%sReply *%s_reply, int *n_%s)",
+       gx_name, field->name, gx_type, gx_name, field->name);
+  _H (";\n");
+  _C ("\n{\n");
+  _C ("  if (n_%s)\n"
+      "    *n_%s = ",
+      field->name, field->name);
+  output_xcb_list_accessor (output_context, field, "_length");
+  _C (";\n");
+  _C ("  return (const %s *)", item_type);
+  output_xcb_list_accessor (output_context, field, "");
+  _C (";\n");
+  _C ("}\n");
 
-  field = (g_list_last (request->reply->fields))->data;
-  if (field->length == NULL)
-    return;
+  if (is_object_list (field))
+    {
+      _CH ("\nvoid\n");
+      _CH ("%s_%s_iter_init (GXXIDIter *iter, %sReply *%s_reply)",
+	   gx_name, field->name, gx_type, gx_name);
+      _H (";\n");
+      _C ("\n{\n");
+      _C ("  _gx_xid_iter_init (iter,\n"
+	  "\t\t     %s_reply->connection,\n"
+	  "\t\t     %s,\n"
+	  "\t\t     (const guint32 *)",
+	  gx_name,
+	  strcmp (field->definition->name, "WINDOW") == 0
+	    ? "GX_TYPE_WINDOW" : "GX_TYPE_PIXMAP");
+      output_xcb_list_accessor (output_context, field, "");
+      _C (",\n"
+	  "\t\t     ");
+      output_xcb_list_accessor (output_context, field, "_length");
+      _C (");\n");
+      _C ("}\n");
+    }
 
-  /* FIXME - shouldn't be restricted to FIELDREF length types */
-  if (field->length->type != XGEN_FIELDREF)
-    return;
+  g_free (gx_name);
+  g_free (gx_type);
+  g_free (item_type);
+}
+
+static void
+output_reply_list_free (GXGenOutputContext *output_context,
+			XGenFieldDefinition *field)
+{
+  const XGenRequest *request = output_context->out_request;
+  GXGenDefinition *gxgen_def =
+    xgen_definition_get_private (XGEN_DEF (request));
+  char *gx_name = gxgen_namespace_to_gx_name (gxgen_def->namespace);
 
   _CH ("\nvoid\n");
   _CH ("%s_free_%s (", gx_name, field->name);
-  if (is_special_xid_definition (field->definition))
+  if (is_object_list (field))
     _CH ("GList *%s)", field->name);
   else
     _CH ("GArray *%s)", field->name);
@@ -1346,16 +1469,90 @@ output_reply_list_free (GXGenOutputContext *output_context)
   _H (";\n");
   _C ("\n{\n");
 
-  if (is_special_xid_definition (field->definition))
+  if (is_object_list (field))
     {
       _C ("\n"
-	  "\tg_list_foreach (%s, (GFunc)g_object_unref, NULL);\n",
-	  field->name);
+	  "\tg_list_foreach (%s, (GFunc)g_object_unref, NULL);\n"
+	  "\tg_list_free (%s);\n",
+	  field->name, field->name);
     }
   else
     _C ("\tg_array_free (%s, TRUE);\n", field->name);
 
   _C ("}\n");
+
+  g_free (gx_name);
+}
+
+/**
+ * output_reply_list_iterator:
+ *
+ * Items of variable size (such as STRs) can't be indexed, so for lists
+ * of these we output a gx_*_<field>_iterator () function that returns
+ * the XCB iterator for the list instead, which is advanced with the
+ * corresponding xcb_*_next () function. As with the peek accessors,
+ * the items point directly into the reply buffer.
+ */
+static void
+output_reply_list_iterator (GXGenOutputContext *output_context,
+			    XGenFieldDefinition *field)
+{
+  const XGenRequest *request = output_context->out_request;
+  GXGenDefinition *gxgen_def =
+    xgen_definition_get_private (XGEN_DEF (request));
+  GXGenDefinition *item_def = xgen_definition_get_private (field->definition);
+  char *gx_name = gxgen_namespace_to_gx_name (gxgen_def->namespace);
+  char *gx_type = gxgen_namespace_to_gx_type (gxgen_def->namespace);
+  char *item_xcb_type = gxgen_namespace_to_xcb_type (item_def->namespace);
+
+  _CH ("\n%s_iterator_t\n", item_xcb_type);
+  _CH ("%s_%s_iterator (%sReply *%s_reply)",
+       gx_name, field->name, gx_type, gx_name);
+  _H (";\n");
+  _C ("\n{\n");
+  _C ("  return ");
+  output_xcb_list_accessor (output_context, field, "_iterator");
+  _C (";\n");
+  _C ("}\n");
+
+  g_free (gx_name);
+  g_free (gx_type);
+  g_free (item_xcb_type);
+}
+
+/**
+ * output_reply_lists:
+ *
+ * Outputs getter, peek and free functions for every variable length
+ * list in a reply, including lists that follow other variable length
+ * fields, or an iterator function for lists of variable sized items.
+ */
+static void
+output_reply_lists (GXGenOutputContext *output_context)
+{
+  const XGenRequest *request = output_context->out_request;
+  GList *tmp;
+
+  if (!request->reply)
+    return;
+
+  for (tmp = request->reply->fields; tmp != NULL; tmp = tmp->next)
+    {
+      XGenFieldDefinition *field = tmp->data;
+
+      if (!is_variable_length_list (field))
+	continue;
+
+      if (!is_fixed_size_definition (field->definition))
+	{
+	  output_reply_list_iterator (output_context, field);
+	  continue;
+	}
+
+      output_reply_list_get (output_context, field);
+      output_reply_list_free (output_context, field);
+      output_reply_list_peek (output_context, field);
+    }
 }
 
 static void
@@ -1377,8 +1574,9 @@ output_reply_free (GXGenOutputContext *output_context)
   _H (";\n");
   _C ("\n{\n");
 
-  _C ("  free (%s_reply->x11_reply);\n", gx_name);
-  _C ("  g_slice_free (%sReply, %s_reply);\n", gx_type, gx_name);
+  /* NB: The reply struct is embedded in the same allocation as the
+   * x11 reply. See _gx_reply_new () */
+  _C ("  _gx_reply_free (%s_reply);\n", gx_name);
 
   _C ("}\n");
 }
@@ -1418,16 +1616,447 @@ output_reply_variable_declarations (GXGenOutputContext *output_context)
   _C ("\txcb_generic_error_t *xcb_error;\n");
 
   if (request->reply)
-    _C ("\t%sReply *reply = g_slice_new (%sReply);\n", gx_type, gx_type);
+    {
+      _C ("\t%sX11Reply *x11_reply;\n", gx_type);
+      _C ("\t%sReply *reply;\n", gx_type);
+    }
+}
+
+/**
+ * output_reply_new:
+ *
+ * This function outputs the code to create a GX reply struct from
+ * the x11_reply variable. (The reply struct is embedded in the same
+ * allocation as the x11 reply so we only need one allocation per reply)
+ */
+static void
+output_reply_new (GXGenOutputContext *output_context)
+{
+  const XGenRequest *request = output_context->out_request;
+  GXGenDefinition *gxgen_def =
+    xgen_definition_get_private (XGEN_DEF (request));
+  char *gx_type = gxgen_namespace_to_gx_type (gxgen_def->namespace);
+
+  _C ("\treply = (%sReply *)\n"
+      "\t\t_gx_reply_new (connection, (GXGenericReply *)x11_reply);\n",
+      gx_type);
+}
+
+/* Outputs a call to let the connection know about a request we just
+ * queued with XCB, along with an estimate of its size in bytes (for the
+ * gx_connection_begin/end_batch () auto-flush thresholds). We only
+ * count list data when its length is given by another request field. */
+static void
+output_request_queued (GXGenOutputContext *output_context)
+{
+  const XGenRequest *request = output_context->out_request;
+  GXGenDefinition *gxgen_def =
+    xgen_definition_get_private (XGEN_DEF (request));
+  char *xcb_name = gxgen_namespace_to_xcb_name (gxgen_def->namespace);
+  GList *tmp;
+
+  _C ("\t_gx_connection_request_queued (connection,\n"
+      "\t\t\t\t       sizeof (%s_request_t)", xcb_name);
+
+  for (tmp = request->fields; tmp != NULL; tmp = tmp->next)
+    {
+      XGenFieldDefinition *field = tmp->data;
+      GList *tmp2;
+      char *item_type;
+
+      if (!field->length || field->length->type != XGEN_FIELDREF)
+	continue;
+
+      for (tmp2 = request->fields; tmp2 != NULL; tmp2 = tmp2->next)
+	{
+	  XGenFieldDefinition *length_field = tmp2->data;
+	  if (strcmp (length_field->name, field->length->field) == 0)
+	    break;
+	}
+      if (!tmp2)
+	continue;
+
+      item_type = gxgen_definition_to_gx_type (field->definition, FALSE);
+      _C ("\n\t\t\t\t       + %s * sizeof (%s)",
+	  field->length->field, item_type);
+      g_free (item_type);
+    }
+  _C (");\n");
+
+  g_free (xcb_name);
+}
+
+/* Core drawing requests whose list of primitives can be split across
+ * several protocol requests without changing the result. For
+ * PolyLine, consecutive chunks overlap by one point so the line stays
+ * connected. */
+static const struct {
+  const char *name;
+  guint	      overlap;
+} split_requests[] = {
+  { "PolyPoint", 0 },
+  { "PolyLine", 1 },
+  { "PolySegment", 0 },
+  { "PolyRectangle", 0 },
+  { "PolyArc", 0 },
+  { "PolyFillRectangle", 0 },
+  { "PolyFillArc", 0 },
+  { NULL, 0 }
+};
+
+static XGenFieldDefinition *
+lookup_request_field (const XGenRequest *request, const char *name)
+{
+  GList *tmp;
+
+  for (tmp = request->fields; tmp != NULL; tmp = tmp->next)
+    {
+      XGenFieldDefinition *field = tmp->data;
+      if (strcmp (field->name, name) == 0)
+	return field;
+    }
+  return NULL;
+}
+
+/* Outputs the argument list for a call to the xcb request function.
+ * @replacements is a NULL terminated list of field name, expression
+ * pairs, giving expressions to pass instead of the named fields. */
+static void
+output_xcb_request_args (GXGenOutputContext *output_context,
+			 const char **replacements)
+{
+  const XGenRequest *request = output_context->out_request;
+  GList *tmp;
+  int i;
+
+  _C ("gx_connection_get_xcb_connection (connection)");
+
+  for (tmp = request->fields; tmp != NULL; tmp = tmp->next)
+    {
+      XGenFieldDefinition *field = tmp->data;
+
+      if (strcmp (field->name, "opcode") == 0
+	  || strcmp (field->name, "pad") == 0
+	  || strcmp (field->name, "length") == 0)
+	continue;
+
+      _C (",\n\t\t\t\t");
+
+      for (i = 0; replacements[i]; i += 2)
+	if (strcmp (field->name, replacements[i]) == 0)
+	  break;
+
+      if (replacements[i])
+	_C ("%s", replacements[i + 1]);
+      else if (field->definition->type == XGEN_VALUEPARAM)
+	_C ("value_mask, value_list");
+      else
+	output_field_xcb_reference (output_context, field);
+    }
+}
+
+/* Outputs code to give up on a request that is too large to send and
+ * can't be split, returning @failed_value (or nothing if NULL). Sync
+ * functions (@sync is TRUE) also report a BadLength error. */
+static void
+output_request_split_reject (GXGenOutputContext *output_context,
+			     gboolean sync,
+			     const char *failed_value)
+{
+  const XGenDefinition *def = XGEN_DEF (output_context->out_request);
+  GXGenDefinition *gxgen_def = xgen_definition_get_private (def);
+
+  if (sync)
+    _C ("\t\t\t_gx_connection_set_request_too_large_error (error);\n");
+  if (gxgen_def->object->type != GXGEN_OBJECT_TYPE_CONNECTION)
+    _C ("\t\t\tg_object_unref (connection);\n");
+  if (failed_value)
+    _C ("\t\t\treturn %s;\n", failed_value);
+  else
+    _C ("\t\t\treturn;\n");
+}
+
+/**
+ * output_request_split:
+ * @sync: Whether this is for a synchronous function with a GError
+ * @failed_value: What the request function returns if the request
+ *		  can't be sent, or NULL for void functions
+ *
+ * For drawing requests that may be too large for the server's maximum
+ * request length (even with BIG-REQUESTS) this outputs code to send
+ * all but the last chunk of the request's list as separate requests,
+ * leaving the list and length arguments describing the final chunk
+ * which is then sent as normal (so the returned cookie corresponds to
+ * the last request).
+ *
+ * The earlier chunks are sent unchecked, so any errors they cause are
+ * delivered via the connection's "protocol-error" signal. Only the
+ * final chunk's error is reported by the function or its cookie.
+ *
+ * A request that can't be split small enough (an XYPixmap image or a
+ * single row of an image being too long) isn't sent. Sync functions
+ * report a BadLength error and async functions return a NULL cookie.
+ */
+static void
+output_request_split (GXGenOutputContext *output_context,
+		      gboolean sync,
+		      const char *failed_value)
+{
+  const XGenRequest *request = output_context->out_request;
+  const XGenDefinition *def = XGEN_DEF (request);
+  GXGenDefinition *gxgen_def = xgen_definition_get_private (def);
+  char *xcb_name;
+  XGenFieldDefinition *list_field = NULL;
+  XGenFieldDefinition *mode_field;
+  const char *len_name;
+  const char *list_replacements[] = { NULL, "max_items", NULL };
+  char *item_type;
+  GList *tmp;
+  int i;
+
+  if (strcmp (def->extension->header, "xproto") != 0)
+    return;
+
+  xcb_name = gxgen_namespace_to_xcb_name (gxgen_def->namespace);
+
+  if (strcmp (def->name, "PutImage") == 0)
+    {
+      const char *replacements[] = {
+	"height", "rows",
+	"data_len", "rows * stride",
+	NULL
+      };
+
+      /* NB: Only ZPixmap and XYBitmap images are stored row by row;
+       * XYPixmap images are stored a plane at a time so we can't split
+       * those by rows. */
+      _C ("\tif (data_len > _gx_connection_get_max_request_items (connection,\n"
+	  "\t\t\t\t\tsizeof (%s_request_t), 1))\n"
+	  "\t  {\n"
+	  "\t\tguint32 stride = height ? data_len / height : data_len;\n"
+	  "\t\tguint32 rows =\n"
+	  "\t\t  _gx_connection_get_max_request_items (connection,\n"
+	  "\t\t\t\t\tsizeof (%s_request_t), stride);\n"
+	  "\n"
+	  "\t\tif (format == XCB_IMAGE_FORMAT_XY_PIXMAP || rows == 0)\n"
+	  "\t\t  {\n",
+	  xcb_name, xcb_name);
+      output_request_split_reject (output_context, sync, failed_value);
+      _C ("\t\t  }\n"
+	  "\n"
+	  "\t\twhile (height > rows)\n"
+	  "\t\t  {\n"
+	  "\t\t\t%s (",
+	  xcb_name);
+      output_xcb_request_args (output_context, replacements);
+      _C (");\n"
+	  "\t\t\t_gx_connection_request_queued (connection,\n"
+	  "\t\t\t\tsizeof (%s_request_t) + rows * stride);\n"
+	  "\t\t\tdata += rows * stride;\n"
+	  "\t\t\tdata_len -= rows * stride;\n"
+	  "\t\t\theight -= rows;\n"
+	  "\t\t\tdst_y += rows;\n"
+	  "\t\t  }\n"
+	  "\t  }\n\n",
+	  xcb_name);
+      g_free (xcb_name);
+      return;
+    }
+
+  for (i = 0; split_requests[i].name; i++)
+    if (strcmp (def->name, split_requests[i].name) == 0)
+      break;
+  if (!split_requests[i].name)
+    {
+      g_free (xcb_name);
+      return;
+    }
+
+  for (tmp = request->fields; tmp != NULL; tmp = tmp->next)
+    {
+      XGenFieldDefinition *field = tmp->data;
+      if (field->length && field->length->type == XGEN_FIELDREF
+	  && lookup_request_field (request, field->length->field))
+	list_field = field;
+    }
+  if (!list_field)
+    {
+      g_free (xcb_name);
+      return;
+    }
+
+  len_name = list_field->length->field;
+  item_type = gxgen_definition_to_gx_type (list_field->definition, FALSE);
+  mode_field = lookup_request_field (request, "coordinate_mode");
+
+  _C ("\tif (%s > _gx_connection_get_max_request_items (connection,\n"
+      "\t\t\t\tsizeof (%s_request_t), sizeof (%s)))\n"
+      "\t  {\n"
+      "\t\tguint32 max_items =\n"
+      "\t\t  _gx_connection_get_max_request_items (connection,\n"
+      "\t\t\t\tsizeof (%s_request_t), sizeof (%s));\n"
+      "\n",
+      len_name, xcb_name, item_type, xcb_name, item_type);
+
+  /* Each chunk has to make progress past the items it shares with the
+   * next chunk */
+  _C ("\t\tif (max_items <= %u)\n"
+      "\t\t  {\n",
+      split_requests[i].overlap);
+  output_request_split_reject (output_context, sync, failed_value);
+  _C ("\t\t  }\n"
+      "\n");
+
+  /* Each chunk of a CoordModePrevious list would need its first point
+   * to be relative to the origin, so we convert the whole list. */
+  if (mode_field)
+    _C ("\t\tif (%s == XCB_COORD_MODE_PREVIOUS)\n"
+	"\t\t  {\n"
+	"\t\t\tabsolute_points = _gx_points_to_absolute (\n"
+	"\t\t\t\t(const xcb_point_t *)%s, %s);\n"
+	"\t\t\t%s = (const %s *)absolute_points;\n"
+	"\t\t\t%s = XCB_COORD_MODE_ORIGIN;\n"
+	"\t\t  }\n",
+	mode_field->name,
+	list_field->name, len_name,
+	list_field->name, item_type,
+	mode_field->name);
+
+  _C ("\t\twhile (%s > max_items)\n"
+      "\t\t  {\n"
+      "\t\t\t%s (",
+      len_name, xcb_name);
+  list_replacements[0] = len_name;
+  output_xcb_request_args (output_context, list_replacements);
+  _C (");\n"
+      "\t\t\t_gx_connection_request_queued (connection,\n"
+      "\t\t\t\tsizeof (%s_request_t) + max_items * sizeof (%s));\n"
+      "\t\t\t%s += max_items - %u;\n"
+      "\t\t\t%s -= max_items - %u;\n"
+      "\t\t  }\n"
+      "\t  }\n\n",
+      xcb_name, item_type,
+      list_field->name, split_requests[i].overlap,
+      len_name, split_requests[i].overlap);
+
+  g_free (item_type);
+  g_free (xcb_name);
+}
+
+/* Outputs any variable declarations needed by output_request_split () */
+static void
+output_request_split_declarations (GXGenOutputContext *output_context)
+{
+  const XGenRequest *request = output_context->out_request;
+  const XGenDefinition *def = XGEN_DEF (request);
+
+  if (strcmp (def->extension->header, "xproto") != 0)
+    return;
+
+  if (strcmp (def->name, "PolyPoint") == 0
+      || strcmp (def->name, "PolyLine") == 0)
+    _C ("\txcb_point_t *absolute_points = NULL;\n");
+}
+
+/* Outputs any cleanup needed after output_request_split () */
+static void
+output_request_split_cleanup (GXGenOutputContext *output_context)
+{
+  const XGenRequest *request = output_context->out_request;
+  const XGenDefinition *def = XGEN_DEF (request);
+
+  if (strcmp (def->extension->header, "xproto") != 0)
+    return;
+
+  if (strcmp (def->name, "PolyPoint") == 0
+      || strcmp (def->name, "PolyLine") == 0)
+    _C ("\tg_free (absolute_points);\n");
 }
 
 /**
  * output_async_request:
+ * @variant: Which variant of the function to output
+ *
+ * This function outputs the code for all gx_*_async () functions that
+ * return a GXCookie object, the gx_*_async_light () functions that
+ * return a GXLightCookie instead, or the gx_*_discard () functions.
+ *
+ * The gx_*_discard () functions are for requests that are only made
+ * for their side effects. They don't allocate any cookie and instead
+ * tell XCB to throw away the reply (and any error) as soon as it
+ * arrives with xcb_discard_reply (), so there is no client-side
+ * bookkeeping at all. They are only output for requests with a reply.
+ */
+/* InternAtom and GetAtomName are special cased so their replies are
+ * added to the connection's atom cache. */
+typedef enum
+{
+  GXGEN_ATOM_HOOK_SAVE_REQUEST,
+  GXGEN_ATOM_HOOK_COOKIE_REPLY,
+  GXGEN_ATOM_HOOK_SYNC_REPLY
+} GXGenAtomHook;
+
+/**
+ * output_atom_cache_hook:
+ * @hook: Where the hook is being output
  *
- * This function outputs the code for all gx_*_async () functions
+ * For the *_async () functions this outputs code to save the request
+ * argument with the cookie, since the reply only includes one half of
+ * the name/atom pair. For the *_reply () and sync functions it outputs
+ * code to cache the pair once the reply has been created.
+ *
+ * NB: The *_async_light () functions aren't hooked to keep them cheap;
+ * gx_connection_lookup_atoms () caches their replies itself.
  */
+static void
+output_atom_cache_hook (GXGenOutputContext *output_context,
+			GXGenAtomHook hook)
+{
+  const XGenDefinition *def = XGEN_DEF (output_context->out_request);
+  GXGenDefinition *gxgen_def = xgen_definition_get_private (def);
+  char *gx_name;
+  const char *cookie = hook == GXGEN_ATOM_HOOK_SYNC_REPLY ? "NULL" : "cookie";
+
+  if (strcmp (def->extension->header, "xproto") != 0)
+    return;
+
+  gx_name = gxgen_namespace_to_gx_name (gxgen_def->namespace);
+
+  if (strcmp (def->name, "InternAtom") == 0)
+    {
+      if (hook == GXGEN_ATOM_HOOK_SAVE_REQUEST)
+	_C ("\t_gx_connection_save_atom_request (cookie, name, name_len,\n"
+	    "\t\t\t\t\t  XCB_ATOM_NONE);\n");
+      else if (hook == GXGEN_ATOM_HOOK_COOKIE_REPLY)
+	_C ("\t_gx_connection_cache_atom (connection, cookie, NULL, -1,\n"
+	    "\t\t\t\t   reply->x11_reply->atom);\n");
+      else
+	_C ("\t_gx_connection_cache_atom (connection, NULL, name, name_len,\n"
+	    "\t\t\t\t   reply->x11_reply->atom);\n");
+    }
+  else if (strcmp (def->name, "GetAtomName") == 0)
+    {
+      if (hook == GXGEN_ATOM_HOOK_SAVE_REQUEST)
+	_C ("\t_gx_connection_save_atom_request (cookie, NULL, 0, atom);\n");
+      else
+	_C ("\t  {\n"
+	    "\t\tint name_len;\n"
+	    "\t\tconst char *name =\n"
+	    "\t\t\t%s_peek_name (reply, &name_len);\n"
+	    "\t\t_gx_connection_cache_atom (connection, %s, name, name_len,\n"
+	    "\t\t\t\t\t   %s);\n"
+	    "\t  }\n",
+	    gx_name,
+	    cookie,
+	    hook == GXGEN_ATOM_HOOK_SYNC_REPLY ? "atom" : "XCB_ATOM_NONE");
+    }
+
+  g_free (gx_name);
+}
+
 void
-output_async_request (GXGenOutputContext *output_context)
+output_async_request (GXGenOutputContext *output_context,
+		      GXGenAsyncVariant variant)
 {
   const XGenRequest *request = output_context->out_request;
   const XGenDefinition *def = XGEN_DEF (request);
@@ -1442,8 +2071,18 @@ output_async_request (GXGenOutputContext *output_context)
   GXGenNamespace *cookie_namespace;
   char *cookie_gx_define;
   gboolean has_mask_value_items = FALSE;
+  gboolean light = variant == GXGEN_ASYNC_LIGHT;
+
+  g_assert (variant != GXGEN_ASYNC_DISCARD || request->reply);
 
-  _CH ("\nGXCookie *\n%s_async (%s", gx_name, obj->first_arg);
+  if (variant == GXGEN_ASYNC_DISCARD)
+    _CH ("\nvoid\n%s_discard (%s", gx_name, obj->first_arg);
+  else
+    _CH ("\n%s *\n%s_async%s (%s",
+	 light ? "GXLightCookie" : "GXCookie",
+	 gx_name,
+	 light ? "_light" : "",
+	 obj->first_arg);
 
   for (tmp = request->fields; tmp != NULL; tmp = tmp->next)
     {
@@ -1501,13 +2140,19 @@ output_async_request (GXGenOutputContext *output_context)
   else
     _C ("\t%s_cookie_t xcb_cookie;\n", xcb_type);
 
-  _C ("\tGXCookie *cookie;\n\n");
+  if (variant != GXGEN_ASYNC_DISCARD)
+    _C ("\t%s *cookie;\n", light ? "GXLightCookie" : "GXCookie");
+  output_request_split_declarations (output_context);
+  _C ("\n");
 
   if (has_mask_value_items)
     output_mask_value_variable_declarations (output_context);
 
   _C ("\n");
 
+  output_request_split (output_context, FALSE,
+			variant == GXGEN_ASYNC_DISCARD ? NULL : "NULL");
+
   if (request->reply)
     {
       _C ("\txcb_cookie =\n"
@@ -1548,23 +2193,49 @@ output_async_request (GXGenOutputContext *output_context)
     }
   _C (");\n\n");
 
+  output_request_queued (output_context);
+  output_request_split_cleanup (output_context);
+  _C ("\n");
+
+  if (variant == GXGEN_ASYNC_DISCARD)
+    {
+      _C ("\txcb_discard_reply (gx_connection_get_xcb_connection (connection),\n"
+	  "\t\t\t   xcb_cookie.sequence);\n");
+
+      if (obj->type != GXGEN_OBJECT_TYPE_CONNECTION)
+	_C ("\tg_object_unref (connection);\n");
+
+      _C ("}\n");
+      return;
+    }
+
   cookie_namespace =
     gxgen_namespace_new (NULL, def, "%sCookie", def->name);
   cookie_gx_define = gxgen_namespace_to_gx_define (cookie_namespace);
 
-  out (output_context,
-       "cookie-typedefs",
-       "\t%s,\n", cookie_gx_define);
+  if (!light)
+    out (output_context,
+	 "cookie-typedefs",
+	 "\t%s,\n", cookie_gx_define);
 
-  _C ("\tcookie = gx_cookie_new (connection, %s, xcb_cookie.sequence);\n",
-      cookie_gx_define);
+  if (light)
+    _C ("\tcookie = _gx_connection_new_light_cookie (connection, %s,\n"
+	"\t\t\t\t\t\t  xcb_cookie.sequence);\n",
+	cookie_gx_define);
+  else
+    _C ("\tcookie = gx_cookie_new (connection, %s, xcb_cookie.sequence);\n",
+	cookie_gx_define);
 
   g_free (cookie_gx_define);
 
   if (obj->type != GXGEN_OBJECT_TYPE_CONNECTION)
     _C ("\tg_object_unref (connection);\n");
 
-  _C ("\tgx_connection_register_cookie (connection, cookie);\n");
+  if (!light)
+    {
+      output_atom_cache_hook (output_context, GXGEN_ATOM_HOOK_SAVE_REQUEST);
+      _C ("\tgx_connection_register_cookie (connection, cookie);\n");
+    }
 
   _C ("\treturn cookie;\n");
 
@@ -1607,16 +2278,13 @@ output_reply (GXGenOutputContext *output_context)
 
   _C ("\n");
 
-  if (request->reply)
-    _C ("\treply->connection = connection;\n\n");
-
   if (request->reply)
     {
-      _C ("\treply->x11_reply = (%sX11Reply *)\n"
-	  "\t\tgx_cookie_get_reply (cookie);\n",
+      _C ("\tx11_reply = (%sX11Reply *)\n"
+	  "\t\t_gx_cookie_steal_reply (cookie);\n",
 	  gx_type);
 
-      _C ("\tif (!reply->x11_reply)\n"
+      _C ("\tif (!x11_reply)\n"
 	  "\t  {\n");
     }
 
@@ -1625,7 +2293,8 @@ output_reply (GXGenOutputContext *output_context)
    */
   /* FIXME - we need a mechanism for translating X errors into a glib
    * error domain, code and message. */
-  _C ("\txcb_error = gx_cookie_get_error (cookie);\n");
+  _C ("\txcb_error = _gx_cookie_steal_error (cookie);\n\n");
+
   /* FIXME create a func for outputing this... */
   _C ("\tif (xcb_error)\n"
       "\t  {\n"
@@ -1633,26 +2302,34 @@ output_reply (GXGenOutputContext *output_context)
       "\t\t\tGX_PROTOCOL_ERROR,\n"
       "\t\t\tgx_protocol_error_from_xcb_error (xcb_error),\n"
       "\t\t\t\"Protocol Error\");\n"
+      "\t\tfree (xcb_error);\n"
+      "\t\tgx_connection_unregister_cookie (connection, cookie);\n"
       "\t\treturn %s;\n"
       "\t  }\n",
       request->reply != NULL ? "NULL" : "FALSE");
-  /* FIXME - free reply */
-  /* FIXME - check we don't skip any other function cleanup */
 
   _C ("\txcb_cookie.sequence = gx_cookie_get_sequence (cookie);\n");
 
   /* If the cookie has no associated reply or error, then we ask
-   * XCB for a reply/error
+   * XCB for a reply/error. Newer requests may have been queued since
+   * this one so we can't assume XCB writes them all out while waiting.
    */
+  _C ("\t_gx_connection_flush_for_reply (connection);\n");
   if (request->reply)
     {
-      _C ("\treply->x11_reply = (%sX11Reply *)\n"
+      _C ("\tx11_reply = (%sX11Reply *)\n"
 	  "\t\t%s_reply (\n"
 	  "\t\t\tgx_connection_get_xcb_connection (connection),\n"
 	  "\t\t\txcb_cookie,\n"
 	  "\t\t\t&xcb_error);\n",
 	  gx_type,
 	  xcb_name);
+      /* NB: We can only get here if the connection hasn't already
+       * read the reply. For void requests we can't tell, so they are
+       * only counted when the connection reads them. */
+      _C ("\t_gx_connection_response_received (connection,\n"
+	  "\t\t\t_gx_cookie_get_issue_time (cookie),\n"
+	  "\t\t\txcb_error != NULL);\n");
     }
   else
     {
@@ -1668,13 +2345,19 @@ output_reply (GXGenOutputContext *output_context)
       "\t\t\tGX_PROTOCOL_ERROR,\n"
       "\t\t\tgx_protocol_error_from_xcb_error (xcb_error),\n"
       "\t\t\t\"Protocol Error\");\n"
+      "\t\tfree (xcb_error);\n"
+      "\t\tgx_connection_unregister_cookie (connection, cookie);\n"
       "\t\treturn %s;\n"
       "\t  }\n",
       request->reply != NULL ? "NULL" : "FALSE");
 
 
   if (request->reply)
-    _C ("\n\t  }\n");
+    {
+      _C ("\n\t  }\n");
+      output_reply_new (output_context);
+      output_atom_cache_hook (output_context, GXGEN_ATOM_HOOK_COOKIE_REPLY);
+    }
 
   _C ("\tgx_connection_unregister_cookie (connection, cookie);\n");
 
@@ -1686,6 +2369,121 @@ output_reply (GXGenOutputContext *output_context)
   _C ("}\n");
 }
 
+/**
+ * output_reply_light:
+ *
+ * This function outputs the code for the gx_*_reply_light () functions
+ * that are used to claim the reply for a GXLightCookie.
+ *
+ * Unless a GXCookie object was requested for the light cookie, nothing
+ * polls for the reply from the mainloop so we simply leave it queued in
+ * XCB until it's claimed here.
+ */
+void
+output_reply_light (GXGenOutputContext *output_context)
+{
+  const XGenRequest *request = output_context->out_request;
+  GXGenDefinition *gxgen_def =
+    xgen_definition_get_private (XGEN_DEF (request));
+  char *gx_name = gxgen_namespace_to_gx_name (gxgen_def->namespace);
+  char *gx_type = gxgen_namespace_to_gx_type (gxgen_def->namespace);
+  char *xcb_name = gxgen_namespace_to_xcb_name (gxgen_def->namespace);
+  char *xcb_type = gxgen_namespace_to_xcb_type (gxgen_def->namespace);
+  const char *failed = request->reply ? "NULL" : "FALSE";
+  char *result_type;
+
+  if (request->reply)
+    result_type = g_strdup_printf ("%sReply *", gx_type);
+  else
+    result_type = g_strdup ("gboolean");
+
+  _CH ("\n%s\n", result_type);
+
+  _CH ("%s_reply_light (GXLightCookie *light_cookie, GError **error)\n",
+       gx_name);
+
+  _H (";\n");
+  _C ("\n{\n");
+
+  _C ("\tGXConnection *connection = light_cookie->connection;\n");
+
+  if (!request->reply)
+    _C ("\txcb_void_cookie_t xcb_cookie;\n");
+  else
+    {
+      _C ("\t%s_cookie_t xcb_cookie;\n", xcb_type);
+      _C ("\t%sX11Reply *x11_reply;\n", gx_type);
+      _C ("\t%sReply *reply;\n", gx_type);
+    }
+  _C ("\txcb_generic_error_t *xcb_error = NULL;\n");
+  _C ("\tgint64 issue_time;\n");
+  _C ("\n");
+
+  _C ("\tg_return_val_if_fail (error == NULL || *error == NULL, %s);\n",
+      failed);
+  _C ("\n");
+
+  /* If a GXCookie object was requested then the reply may have already
+   * been delivered to it by the connection. */
+  _C ("\tif (light_cookie->object)\n"
+      "\t  {\n"
+      "\t\t%s result = %s_reply (light_cookie->object, error);\n"
+      "\t\t_gx_connection_free_light_cookie (light_cookie, TRUE);\n"
+      "\t\treturn result;\n"
+      "\t  }\n\n",
+      result_type,
+      gx_name);
+
+  _C ("\txcb_cookie.sequence = light_cookie->sequence;\n");
+  _C ("\tissue_time = light_cookie->issue_time;\n");
+  /* NB: We claim the reply from XCB straight away */
+  _C ("\t_gx_connection_free_light_cookie (light_cookie, TRUE);\n\n");
+  _C ("\t_gx_connection_flush_for_reply (connection);\n");
+
+  if (request->reply)
+    {
+      _C ("\tx11_reply = (%sX11Reply *)\n"
+	  "\t\t%s_reply (\n"
+	  "\t\t\tgx_connection_get_xcb_connection (connection),\n"
+	  "\t\t\txcb_cookie,\n"
+	  "\t\t\t&xcb_error);\n",
+	  gx_type,
+	  xcb_name);
+    }
+  else
+    {
+      _C ("\txcb_error = \n"
+	  "\t\txcb_request_check (\n"
+	  "\t\t\tgx_connection_get_xcb_connection (connection),\n"
+	  "\t\t\txcb_cookie);\n");
+    }
+  _C ("\t_gx_connection_response_received (connection, issue_time,\n"
+      "\t\t\t\t\t  xcb_error != NULL);\n\n");
+
+  _C ("\tif (xcb_error)\n"
+      "\t  {\n"
+      "\t\tg_set_error (error,\n"
+      "\t\t\tGX_PROTOCOL_ERROR,\n"
+      "\t\t\tgx_protocol_error_from_xcb_error (xcb_error),\n"
+      "\t\t\t\"Protocol Error\");\n"
+      "\t\tfree (xcb_error);\n"
+      "\t\treturn %s;\n"
+      "\t  }\n\n",
+      failed);
+
+  if (request->reply)
+    {
+      output_reply_new (output_context);
+      _C ("\treturn reply;\n");
+    }
+  else
+    _C ("\treturn TRUE;\n");
+
+  _C ("}\n");
+
+  g_free (result_type);
+}
+
 void
 output_sync_request (GXGenOutputContext *output_context)
 {
@@ -1758,7 +2556,9 @@ output_sync_request (GXGenOutputContext *output_context)
   else
     _C ("\t%s_cookie_t cookie;\n",
 	xcb_type);
+  _C ("\tgint64 issue_time;\n");
   output_reply_variable_declarations (output_context);
+  output_request_split_declarations (output_context);
 
   /* If the request has a XGEN_VALUEPARAM field, then we will need
    * to translate an array of GXMaskValueItems from the user.
@@ -1772,9 +2572,10 @@ output_sync_request (GXGenOutputContext *output_context)
   else
     _C ("\tg_return_val_if_fail (error == NULL || *error == NULL, NULL);\n");
 
-  if (request->reply)
-    _C ("\treply->connection = connection;\n\n");
+  output_request_split (output_context, TRUE,
+			request->reply != NULL ? "NULL" : "FALSE");
 
+  _C ("\tissue_time = _gx_connection_timestamp ();\n");
   if (request->reply)
     {
       _C ("\tcookie =\n"
@@ -1814,9 +2615,12 @@ output_sync_request (GXGenOutputContext *output_context)
     }
   _C (");\n\n");
 
+  output_request_queued (output_context);
+  output_request_split_cleanup (output_context);
+
   if (request->reply)
     {
-      _C ("\treply->x11_reply = (%sX11Reply *)\n"
+      _C ("\tx11_reply = (%sX11Reply *)\n"
 	  "\t\t%s_reply (\n"
 	  "\t\t\tgx_connection_get_xcb_connection (connection),\n"
 	  "\t\t\tcookie,\n"
@@ -1832,6 +2636,12 @@ output_sync_request (GXGenOutputContext *output_context)
 	  "\t\t\tcookie);\n");
     }
 
+  /* NB: This is the newest request, so XCB has to write out everything
+   * queued before it can wait for the reply/error */
+  _C ("\t_gx_connection_requests_flushed (connection);\n");
+  _C ("\t_gx_connection_response_received (connection, issue_time,\n"
+      "\t\t\t\t\t  xcb_error != NULL);\n\n");
+
   /* FIXME create a func for outputing this... */
   _C ("\tif (xcb_error)\n"
       "\t  {\n"
@@ -1839,10 +2649,17 @@ output_sync_request (GXGenOutputContext *output_context)
       "\t\t\tGX_PROTOCOL_ERROR,\n"
       "\t\t\tgx_protocol_error_from_xcb_error (xcb_error),\n"
       "\t\t\t\"Protocol Error\");\n"
+      "\t\tfree (xcb_error);\n"
       "\t\treturn %s;\n"
       "\t  }\n",
       request->reply != NULL ? "NULL" : "FALSE");
 
+  if (request->reply)
+    {
+      output_reply_new (output_context);
+      output_atom_cache_hook (output_context, GXGEN_ATOM_HOOK_SYNC_REPLY);
+    }
+
   if (obj->type != GXGEN_OBJECT_TYPE_CONNECTION)
     _C ("\tg_object_unref (connection);\n");
 
@@ -1893,16 +2710,21 @@ output_requests (GXGenOutputContext *output_context)
        */
       output_reply_typedef (output_context);
 
-      /* Some replys include a list of data. If this is such a request
-       * then we output a getter function for trailing list fields */
-      output_reply_list_get (output_context);
-      output_reply_list_free (output_context);
+      /* Some replys include lists of data. If this is such a request
+       * then we output accessor functions for each list */
+      output_reply_lists (output_context);
 
       output_reply_free (output_context);
 
-      output_async_request (output_context);
+      output_async_request (output_context, GXGEN_ASYNC_COOKIE);
       output_reply (output_context);
 
+      output_async_request (output_context, GXGEN_ASYNC_LIGHT);
+      output_reply_light (output_context);
+
+      if (request->reply)
+	output_async_request (output_context, GXGEN_ASYNC_DISCARD);
+
       output_sync_request (output_context);
 
       g_free (output_context->c_part);
@@ -2022,6 +2844,7 @@ output_event_extras (GXGenOutputContext *output_context)
   GList		      *tmp;
   GXGenNamespace      *typedef_namespace;
   char		      *typedef_name;
+  int		       max_event_code = 0;
 
   if (!extension->events)
     return;
@@ -2048,6 +2871,8 @@ output_event_extras (GXGenOutputContext *output_context)
   _C ("#include <gx/generated-code/extensions/gx-%s.h>\n",
       extension->header);
   _C ("\n");
+  /* NB: The details are indexed by event code so that looking up the
+   * details of an event is a direct array index. See gx-event.c */
   _C ("GXEventDetails _gx_%s_event_details[] = {\n", extension->header);
 
   for (tmp = extension->events; tmp != NULL; tmp = tmp->next)
@@ -2068,7 +2893,11 @@ output_event_extras (GXGenOutputContext *output_context)
       gxgen_namespace_free (namespace);
 
       _H ("\t%s = %d,\n", event_code_define, event->number);
-      _C ("\t{%d, \"%s\", ", event->number, event_code_define);
+      _C ("\t[%d] = {%d, \"%s\", ",
+	  event->number, event->number, event_code_define);
+
+      if (event->number > max_event_code)
+	max_event_code = event->number;
 
       for (tmp2 = event->fields; tmp2 != NULL; tmp2 = tmp2->next)
 	{
@@ -2087,7 +2916,7 @@ output_event_extras (GXGenOutputContext *output_context)
 	_C ("0},\n");
     }
 
-  _C ("\t{0}");
+  _C ("\t[%d] = {-1}\n", max_event_code + 1);
   _C ("};\n");
 
   _H ("} GX%sEventCode\n", typedef_name);